@@ -0,0 +1,490 @@
+// Microbenchmarks for the computational kernels in Calculator.cpp
+//
+// Build:  g++ -std=c++17 -pthread -O2 Benchmark.cpp CalculatorEngine.cpp -o calculator_bench
+// Run:    ./calculator_bench [--filter text] [--min-time seconds] [--json file]
+//
+// Every benchmark reports ns per operation, elements per second, cycles per
+// element and heap allocations per operation. What counts as an element is
+// given per benchmark (values, matrix multiply-adds, digits...). Keep the
+// --json output of each release and compare it to spot regressions.
+
+#include "CalculatorEngine.h"
+
+#include <atomic>
+#include <functional>
+#include <new>
+#include <random>
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+#define BENCHMARK_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCHMARK_HAS_TSC 1
+#endif
+
+// Allocation counting: every operator new in the process goes through here
+std::atomic<uint64_t> allocationCount(0);
+std::atomic<uint64_t> allocationBytes(0);
+
+void *operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+// Out of line so the compiler never sees new paired with free
+CALC_NOINLINE void operator delete(void *p) noexcept { std::free(p); }
+CALC_NOINLINE void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+// Keeps the compiler from discarding a result it can see is unused. MSVC has
+// no inline asm on x64, so there the address escapes through a volatile store
+#if defined(_MSC_VER) && !defined(__clang__)
+const void *volatile keepSink;
+#endif
+
+template <typename T>
+void keep(const T &value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    keepSink = &value;
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "g"(&value) : "memory");
+#endif
+}
+
+// Time-stamp counter ticks; these are reference cycles at the nominal clock,
+// not core cycles, so they stay comparable across runs on one machine
+uint64_t cycleCount()
+{
+#ifdef BENCHMARK_HAS_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+struct Benchmark
+{
+    std::string name;
+    double elements; // Elements processed by one operation
+    std::function<void()> run;
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    double elements;
+    double nsPerOp;
+    double cyclesPerElement;
+    double allocationsPerOp;
+    double bytesPerOp;
+};
+
+// Grows the batch until it takes a tenth of minTime, then takes the median
+// of five batches of about minTime / 5 each
+BenchmarkResult measure(const Benchmark &bench, double minTime)
+{
+    typedef std::chrono::steady_clock Clock;
+    bench.run();
+
+    uint64_t iterations = 1;
+    while (true)
+    {
+        Clock::time_point start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++)
+            bench.run();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (seconds >= minTime / 10 || iterations >= (1ULL << 40))
+        {
+            iterations = std::max<uint64_t>(1, static_cast<uint64_t>(iterations * (minTime / 5) / std::max(seconds, 1e-9)));
+            break;
+        }
+        iterations *= 2;
+    }
+
+    const int SAMPLES = 5;
+    std::vector<std::pair<double, double>> samples; // ns per op, cycles per op
+    uint64_t allocations = allocationCount.load(), bytes = allocationBytes.load();
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        uint64_t cycles = cycleCount();
+        Clock::time_point start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++)
+            bench.run();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        cycles = cycleCount() - cycles;
+        samples.emplace_back(seconds * 1e9 / iterations, static_cast<double>(cycles) / iterations);
+    }
+    double ops = static_cast<double>(iterations) * SAMPLES;
+    allocations = allocationCount.load() - allocations;
+    bytes = allocationBytes.load() - bytes;
+
+    std::sort(samples.begin(), samples.end());
+    BenchmarkResult result;
+    result.name = bench.name;
+    result.elements = bench.elements;
+    result.nsPerOp = samples[SAMPLES / 2].first;
+    result.cyclesPerElement = samples[SAMPLES / 2].second / bench.elements;
+    result.allocationsPerOp = allocations / ops;
+    result.bytesPerOp = bytes / ops;
+    return result;
+}
+
+std::vector<double> randomDoubles(size_t n, double lo, double hi, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> dist(lo, hi);
+    std::vector<double> values(n);
+    for (double &v : values)
+        v = dist(rng);
+    return values;
+}
+
+std::vector<uint64_t> randomIntegers(size_t n, uint64_t mask, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<uint64_t> values(n);
+    for (uint64_t &v : values)
+        v = (rng() & mask) | 1;
+    return values;
+}
+
+Matrix randomMatrix(size_t rows, size_t cols, uint64_t seed)
+{
+    std::vector<double> values = randomDoubles(rows * cols, -1, 1, seed);
+    Matrix m(rows, cols);
+    std::copy(values.begin(), values.end(), m.data());
+    return m;
+}
+
+// Inputs are built once up front and shared with the benchmark bodies
+std::vector<Benchmark> buildBenchmarks()
+{
+    std::vector<Benchmark> list;
+    const size_t BATCH = 4096;
+
+    // Expressions
+    const std::string EXPRESSION = "(3+5)*2^3-10/4+1.5*(2-0.25)";
+    list.push_back({"expression/parse_evaluate", 1, [=]() { keep(evaluateExpression(EXPRESSION)); }});
+    std::shared_ptr<CompiledExpression> compiled = std::make_shared<CompiledExpression>(EXPRESSION);
+    std::shared_ptr<std::vector<double>> literals = std::make_shared<std::vector<double>>(compiled->literalValues<double>());
+    list.push_back({"expression/compiled_evaluate", 1, [=]() { keep(compiled->evaluate(*literals)); }});
+    std::shared_ptr<std::vector<DoubleDouble>> ddLiterals =
+        std::make_shared<std::vector<DoubleDouble>>(compiled->literalValues<DoubleDouble>());
+    list.push_back({"expression/double_double", 1, [=]() { keep(compiled->evaluate(*ddLiterals)); }});
+    std::shared_ptr<std::vector<BigFloat>> bigLiterals = std::make_shared<std::vector<BigFloat>>(compiled->literalValues<BigFloat>());
+    list.push_back({"expression/multiprecision_256", 1, [=]() { keep(compiled->evaluate(*bigLiterals)); }});
+    std::shared_ptr<std::vector<Interval>> intervalLiterals =
+        std::make_shared<std::vector<Interval>>(compiled->literalValues<Interval>());
+    list.push_back({"expression/interval", 1, [=]() { keep(compiled->evaluate(*intervalLiterals)); }});
+
+    // Gradient of a 1000-variable expression; elements are variables
+    const size_t VARIABLES = 1000;
+    std::string sum;
+    for (size_t i = 0; i < VARIABLES; i++)
+        sum += (i ? "+" : "") + std::to_string(i % 7 + 1) + "*p" + std::to_string(i) + "^2/(1+p" +
+               std::to_string((i + 1) % VARIABLES) + ")";
+    std::shared_ptr<CompiledExpression> gradientExpr = std::make_shared<CompiledExpression>(sum);
+    std::shared_ptr<std::vector<double>> gradientLiterals =
+        std::make_shared<std::vector<double>>(gradientExpr->literalValues<double>());
+    std::shared_ptr<std::vector<double>> point = std::make_shared<std::vector<double>>(randomDoubles(VARIABLES, 0.5, 2, 1));
+    std::shared_ptr<std::vector<double>> gradient = std::make_shared<std::vector<double>>();
+    list.push_back({"expression/gradient_reverse_1000", double(VARIABLES),
+                    [=]() { keep(gradientExpr->gradient(*gradientLiterals, *point, *gradient)); }});
+
+    // Primes and gcd; elements are values tested or pairs reduced
+    std::shared_ptr<std::vector<uint64_t>> small = std::make_shared<std::vector<uint64_t>>(randomIntegers(BATCH, 0xffffffffULL, 2));
+    std::shared_ptr<std::vector<uint64_t>> large = std::make_shared<std::vector<uint64_t>>(randomIntegers(BATCH, ~0ULL, 3));
+    std::shared_ptr<std::vector<uint8_t>> flags = std::make_shared<std::vector<uint8_t>>(BATCH);
+    list.push_back({"prime/is_prime_u32", double(BATCH), [=]()
+                    {
+                        for (size_t i = 0; i < BATCH; i++)
+                            (*flags)[i] = isPrime((*small)[i]);
+                        keep(*flags);
+                    }});
+    list.push_back({"prime/is_prime_u64", double(BATCH), [=]()
+                    {
+                        for (size_t i = 0; i < BATCH; i++)
+                            (*flags)[i] = isPrime((*large)[i]);
+                        keep(*flags);
+                    }});
+    list.push_back({"prime/factorize_u64", 64, [=]()
+                    {
+                        for (size_t i = 0; i < 64; i++)
+                            keep(primeFactorization((*large)[i]));
+                    }});
+    list.push_back({"prime/sieve_count_1e7", 1e7, []() { keep(PrimeSieve::countPrimes(0, 10000000, 1)); }});
+    list.push_back({"gcd/int", double(BATCH / 2), [=]()
+                    {
+                        int total = 0;
+                        for (size_t i = 0; i < BATCH; i += 2)
+                            total += gcd(static_cast<int>((*small)[i] >> 1), static_cast<int>((*small)[i + 1] >> 1));
+                        keep(total);
+                    }});
+    list.push_back({"gcd/u64", double(BATCH / 2), [=]()
+                    {
+                        uint64_t total = 0;
+                        for (size_t i = 0; i < BATCH; i += 2)
+                            total += gcd64((*large)[i], (*large)[i + 1]);
+                        keep(total);
+                    }});
+    std::shared_ptr<BigInt> bigA = std::make_shared<BigInt>(bigFactorial(450) + BigInt::fromInt64(1));
+    std::shared_ptr<BigInt> bigB = std::make_shared<BigInt>(bigFactorial(449) * BigInt::fromInt64(3) + BigInt::fromInt64(7));
+    list.push_back({"gcd/bigint_1000_digits", 1, [=]() { keep(BigInt::gcd(*bigA, *bigB)); }});
+    list.push_back({"bigint/factorial_2000", 1, []() { keep(bigFactorial(2000)); }});
+
+    // Statistics; elements are values
+    for (size_t n : {size_t(1000), size_t(1000000)})
+    {
+        std::shared_ptr<std::vector<double>> data = std::make_shared<std::vector<double>>(randomDoubles(n, 0, 100, n));
+        list.push_back({"statistics/compute_" + std::to_string(n), double(n), [=]() { keep(computeStatistics(*data)); }});
+        std::shared_ptr<Arena> arena = std::make_shared<Arena>();
+        list.push_back({"statistics/arena_" + std::to_string(n), double(n), [=]()
+                        {
+                            arena->reset();
+                            keep(computeStatistics(*data, arena.get()));
+                        }});
+    }
+
+    // Register accumulation; elements are values
+    {
+        const size_t n = 1000000;
+        std::shared_ptr<std::vector<double>> column = std::make_shared<std::vector<double>>(randomDoubles(n, -1, 1, 7));
+        std::shared_ptr<std::vector<double>> sums = std::make_shared<std::vector<double>>(n);
+        std::shared_ptr<std::vector<double>> errors = std::make_shared<std::vector<double>>(n);
+        list.push_back({"accumulate/plain_1000000", double(n), [=]()
+                        {
+                            double total = 0;
+                            for (double v : *column)
+                                total += v;
+                            keep(total);
+                        }});
+        list.push_back({"accumulate/compensated_1000000", double(n), [=]()
+                        {
+                            CompensatedSum total;
+                            accumulate(total, column->data(), n);
+                            keep(total.value());
+                        }});
+        list.push_back({"accumulate/elements_1000000", double(n), [=]()
+                        {
+                            accumulateElements(sums->data(), errors->data(), column->data(), n);
+                            keep(*sums);
+                        }});
+    }
+
+    // Matrices; elements are multiply-adds for products, entries otherwise
+    for (size_t n : {size_t(64), size_t(256)})
+    {
+        std::shared_ptr<Matrix> a = std::make_shared<Matrix>(randomMatrix(n, n, 10 + n));
+        std::shared_ptr<Matrix> b = std::make_shared<Matrix>(randomMatrix(n, n, 20 + n));
+        list.push_back({"matrix/multiply_" + std::to_string(n), double(n * n * n), [=]() { keep(matrixProduct(*a, *b)); }});
+    }
+    std::shared_ptr<Matrix> big = std::make_shared<Matrix>(randomMatrix(1024, 1024, 5));
+    std::shared_ptr<Matrix> other = std::make_shared<Matrix>(randomMatrix(1024, 1024, 6));
+    std::shared_ptr<Matrix> target = std::make_shared<Matrix>(1024, 1024);
+    list.push_back({"matrix/transpose_1024", 1024.0 * 1024, [=]() { keep(transposed(*big)); }});
+    list.push_back({"matrix/add_scaled_1024", 1024.0 * 1024, [=]()
+                    {
+                        *target = *big + 2.0 * *other;
+                        keep(*target);
+                    }});
+
+    // Number bases; elements are values or digits
+    std::shared_ptr<std::vector<int64_t>> signedValues = std::make_shared<std::vector<int64_t>>(BATCH);
+    for (size_t i = 0; i < BATCH; i++)
+        (*signedValues)[i] = static_cast<int64_t>((*large)[i]) >> (i % 40);
+    std::shared_ptr<std::string> text = std::make_shared<std::string>();
+    for (int base : {2, 10, 16})
+        list.push_back({"radix/format_base" + std::to_string(base), double(BATCH), [=]()
+                        {
+                            text->clear();
+                            RadixConverter::formatBatch(signedValues->data(), BATCH, base, ' ', *text);
+                            keep(*text);
+                        }});
+    std::shared_ptr<std::string> decimalText = std::make_shared<std::string>();
+    RadixConverter::formatBatch(signedValues->data(), BATCH, 10, ' ', *decimalText);
+    std::shared_ptr<std::vector<int64_t>> parsed = std::make_shared<std::vector<int64_t>>();
+    list.push_back({"radix/parse_base10", double(BATCH), [=]()
+                    {
+                        parsed->clear();
+                        keep(RadixConverter::parseBatch(decimalText->data(), decimalText->size(), 10, *parsed));
+                    }});
+    std::shared_ptr<BigInt> bigValue = std::make_shared<BigInt>(bigFactorial(3250));
+    list.push_back({"radix/bigint_to_base16_10k_digits", double(bigValue->digitCount()),
+                    [=]() { keep(RadixConverter::toString(*bigValue, 16)); }});
+
+    // Signal and vector kernels; elements are samples
+    std::shared_ptr<std::vector<FftPlan::Complex>> signal = std::make_shared<std::vector<FftPlan::Complex>>(BATCH);
+    std::shared_ptr<std::vector<FftPlan::Complex>> spectrum = std::make_shared<std::vector<FftPlan::Complex>>(BATCH);
+    std::vector<double> noise = randomDoubles(2 * BATCH, -1, 1, 7);
+    for (size_t i = 0; i < BATCH; i++)
+        (*signal)[i] = FftPlan::Complex(noise[2 * i], noise[2 * i + 1]);
+    std::shared_ptr<const FftPlan> plan = FftPlan::get(BATCH);
+    list.push_back({"fft/complex_4096", double(BATCH), [=]()
+                    {
+                        plan->forward(signal->data(), spectrum->data(), 1);
+                        keep(*spectrum);
+                    }});
+    std::shared_ptr<std::vector<double>> inputs = std::make_shared<std::vector<double>>(randomDoubles(BATCH, 0.01, 100, 8));
+    std::shared_ptr<std::vector<double>> outputs = std::make_shared<std::vector<double>>(BATCH);
+    const std::pair<const char *, VectorMath::Function> FUNCTIONS[] = {
+        {"sin", VectorMath::SIN}, {"exp", VectorMath::EXP}, {"ln", VectorMath::LN}};
+    for (const std::pair<const char *, VectorMath::Function> &f : FUNCTIONS)
+    {
+        VectorMath::Function function = f.second;
+        list.push_back({std::string("vector/") + f.first + "_4096", double(BATCH), [=]()
+                        {
+                            VectorMath::apply(function, inputs->data(), outputs->data(), BATCH);
+                            keep(*outputs);
+                        }});
+    }
+    std::shared_ptr<ComplexArray> complexValues = std::make_shared<ComplexArray>();
+    complexValues->re = randomDoubles(BATCH, -10, 10, 9);
+    complexValues->im = randomDoubles(BATCH, -10, 10, 10);
+    list.push_back({"complex/magnitude_4096", double(BATCH), [=]()
+                    {
+                        ComplexBatch::magnitude(*complexValues, outputs->data());
+                        keep(*outputs);
+                    }});
+    std::shared_ptr<IntervalArray> intervals = std::make_shared<IntervalArray>();
+    intervals->lo = randomDoubles(BATCH, -2, 1, 11);
+    intervals->hi = intervals->lo;
+    for (double &hi : intervals->hi)
+        hi += 0.5;
+    std::shared_ptr<IntervalArray> intervalOut = std::make_shared<IntervalArray>();
+    list.push_back({"interval/multiply_4096", double(BATCH), [=]()
+                    {
+                        IntervalBatch::multiply(*intervals, *intervals, *intervalOut);
+                        keep(*intervalOut);
+                    }});
+    list.push_back({"units/convert_4096", double(BATCH), [=]()
+                    {
+                        convertUnitArray(inputs->data(), outputs->data(), BATCH, unitIndex("°C"), unitIndex("K"));
+                        keep(*outputs);
+                    }});
+
+    // Number formatting into a reused buffer, as the result files are written;
+    // printf is the baseline it replaced
+    std::shared_ptr<std::string> formattedText = std::make_shared<std::string>();
+    list.push_back({"format/shortest_4096", double(BATCH), [=]()
+                    {
+                        formattedText->clear();
+                        for (double v : *inputs)
+                        {
+                            appendNumber(*formattedText, v);
+                            *formattedText += '\n';
+                        }
+                        keep(*formattedText);
+                    }});
+    list.push_back({"format/fixed6_4096", double(BATCH), [=]()
+                    {
+                        formattedText->clear();
+                        for (double v : *inputs)
+                        {
+                            appendNumber(*formattedText, v, {NumberStyle::FIXED, 6});
+                            *formattedText += '\n';
+                        }
+                        keep(*formattedText);
+                    }});
+    list.push_back({"format/printf_4096", double(BATCH), [=]()
+                    {
+                        formattedText->clear();
+                        char buf[32];
+                        for (double v : *inputs)
+                            formattedText->append(buf, std::snprintf(buf, sizeof(buf), "%.17g\n", v));
+                        keep(*formattedText);
+                    }});
+
+    // Polynomial roots; elements are equations
+    for (unsigned degree : {2u, 4u})
+    {
+        std::shared_ptr<PolynomialBatch> batch = std::make_shared<PolynomialBatch>(degree, BATCH);
+        for (unsigned k = 0; k <= degree; k++)
+            batch->coeff[k] = randomDoubles(BATCH, -5, 5, 30 + k);
+        list.push_back({"polynomial/degree" + std::to_string(degree) + "_4096", double(BATCH), [=]()
+                        {
+                            PolynomialSolver::solve(*batch, 1);
+                            keep(batch->re);
+                        }});
+    }
+    return list;
+}
+
+std::string jsonEscape(const std::string &text)
+{
+    std::string out;
+    for (char ch : text)
+    {
+        if (ch == '"' || ch == '\\')
+            out += '\\';
+        out += ch;
+    }
+    return out;
+}
+
+void writeJson(const std::vector<BenchmarkResult> &results, const std::string &filename)
+{
+    std::ofstream file(filename);
+    file << "{\n  \"compiler\": \"" << jsonEscape(__VERSION__) << "\",\n";
+    file << "  \"timestamp\": " << std::time(nullptr) << ",\n";
+    file << "  \"benchmarks\": [\n";
+    char buf[512];
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult &r = results[i];
+        std::string cycles = "null";
+#ifdef BENCHMARK_HAS_TSC
+        std::snprintf(buf, sizeof(buf), "%.4g", r.cyclesPerElement);
+        cycles = buf;
+#endif
+        std::snprintf(buf, sizeof(buf),
+                      "    {\"name\": \"%s\", \"ns_per_op\": %.6g, \"elements_per_op\": %.6g, \"elements_per_second\": %.6g, "
+                      "\"cycles_per_element\": %s, \"allocations_per_op\": %.4g, \"bytes_per_op\": %.6g}%s\n",
+                      jsonEscape(r.name).c_str(), r.nsPerOp, r.elements, r.elements * 1e9 / r.nsPerOp, cycles.c_str(),
+                      r.allocationsPerOp, r.bytesPerOp, i + 1 < results.size() ? "," : "");
+        file << buf;
+    }
+    file << "  ]\n}\n";
+}
+
+int main(int argc, char **argv)
+{
+    std::string filter, jsonFile;
+    double minTime = 0.5;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc)
+            filter = argv[++i];
+        else if (arg == "--min-time" && i + 1 < argc)
+            minTime = std::atof(argv[++i]);
+        else if (arg == "--json" && i + 1 < argc)
+            jsonFile = argv[++i];
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [--filter text] [--min-time seconds] [--json file]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!(minTime > 0))
+        minTime = 0.5;
+
+    std::printf("%-36s %12s %14s %10s %10s %12s\n", "benchmark", "ns/op", "elements/s", "cyc/elem", "allocs/op", "bytes/op");
+    std::vector<BenchmarkResult> results;
+    for (const Benchmark &bench : buildBenchmarks())
+    {
+        if (bench.name.find(filter) == std::string::npos)
+            continue;
+        BenchmarkResult r = measure(bench, minTime);
+        results.push_back(r);
+        std::printf("%-36s %12.1f %14.4g %10.3g %10.3g %12.4g\n", r.name.c_str(), r.nsPerOp, r.elements * 1e9 / r.nsPerOp,
+                    r.cyclesPerElement, r.allocationsPerOp, r.bytesPerOp);
+        std::fflush(stdout);
+    }
+    if (!jsonFile.empty())
+        writeJson(results, jsonFile);
+    return 0;
+}
@@ -1,18 +1,32 @@
+#include <filesystem>
 #include <iostream>
-#include <cmath>
 #include <iomanip>
-#include <limits>
-#include <vector>
-#include <string>
-#include <algorithm>
-#include <complex>
-#include <sstream>
-#include <fstream>
-#include <stack>
-#include <cctype>
-#include <map>
-#include <ctime>
-#include <chrono>
+
+#include "CalculatorEngine.h"
+#include "CalculatorServer.h"
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/ioctl.h>
+#endif
+
+#ifdef CALC_INSTRUMENT
+#include <new>
+#include <optional>
+
+// Every heap allocation is charged to the operations running on its thread
+void *operator new(std::size_t size)
+{
+    instrument::recordAllocation(size);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+// Out of line so the compiler never sees new paired with free
+CALC_NOINLINE void operator delete(void *p) noexcept { std::free(p); }
+CALC_NOINLINE void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+#endif
 
 // Color Themes
 enum ColorTheme
@@ -71,6 +85,19 @@ ThemeColors monochromeTheme = {
 
 ThemeColors *theme = &darkTheme;
 
+void setTheme(ColorTheme choice)
+{
+    currentTheme = choice;
+    theme = choice == LIGHT ? &lightTheme : choice == MONOCHROME ? &monochromeTheme : &darkTheme;
+}
+
+// How results are shown on screen (option 61); files always use the shortest
+// form that reads back exactly
+NumberFormat displayFormat = {NumberStyle::FIXED, 6};
+
+// Temporaries of the current menu command; reset before each command
+Arena commandArena;
+
 // Memory and History
 std::vector<double> history;
 std::vector<std::string> historyLabels;
@@ -84,7 +111,28 @@ void clearInput()
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 }
 
-double getValidNumber(const std::string &prompt)
+// Pieces of text built in commandArena, for strings made once per item of
+// an input loop such as prompts
+inline void appendPart(std::pmr::string &text, std::string_view part)
+{
+    text += part;
+}
+
+inline void appendPart(std::pmr::string &text, long long value)
+{
+    char buffer[24];
+    text.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+}
+
+template <typename... Parts>
+std::pmr::string arenaText(const Parts &...parts)
+{
+    std::pmr::string text(&commandArena);
+    (appendPart(text, parts), ...);
+    return text;
+}
+
+double getValidNumber(std::string_view prompt)
 {
     double num;
     while (true)
@@ -94,7 +142,28 @@ double getValidNumber(const std::string &prompt)
         {
             return num;
         }
-        std::cout << theme->error << "Invalid input! Please enter a valid number." << theme->reset << std::endl;
+        std::cout << theme->error << "Invalid input! Please enter a valid number." << theme->reset << "\n";
+        clearInput();
+    }
+}
+
+// Reads a full-range unsigned 64-bit integer (doubles lose precision above 2^53)
+uint64_t getValidUnsigned(const std::string &prompt)
+{
+    std::string token;
+    while (true)
+    {
+        std::cout << prompt;
+        if (std::cin >> token && !token.empty() && std::isdigit(static_cast<unsigned char>(token[0])))
+        {
+            errno = 0;
+            char *end;
+            unsigned long long value = std::strtoull(token.c_str(), &end, 10);
+            if (*end == '\0' && errno != ERANGE)
+                return value;
+        }
+        std::cout << theme->error << "Invalid input! Please enter an integer between 0 and 18446744073709551615."
+                  << theme->reset << "\n";
         clearInput();
     }
 }
@@ -110,7 +179,7 @@ int getValidChoice(int min, int max)
             return choice;
         }
         std::cout << theme->error << "Invalid choice! Please enter a number between "
-                  << min << " and " << max << "." << theme->reset << std::endl;
+                  << min << " and " << max << "." << theme->reset << "\n";
         clearInput();
     }
 }
@@ -131,20 +200,20 @@ void displayHistory()
 {
     if (history.empty())
     {
-        std::cout << theme->warning << "\nNo history available yet." << theme->reset << std::endl;
+        std::cout << theme->warning << "\nNo history available yet." << theme->reset << "\n";
         return;
     }
 
-    std::cout << theme->primary << "\n╔══════════════════ CALCULATION HISTORY ══════════════════╗" << theme->reset << std::endl;
+    std::cout << theme->primary << "\n╔══════════════════ CALCULATION HISTORY ══════════════════╗" << theme->reset << "\n";
     int start = std::max(0, (int)history.size() - 10);
     for (int i = start; i < history.size(); i++)
     {
         std::cout << theme->secondary << "[" << i << "] " << theme->reset;
         if (!historyLabels[i].empty())
             std::cout << historyLabels[i] << " = ";
-        std::cout << theme->success << history[i] << theme->reset << std::endl;
+        std::cout << theme->success << formatted(history[i], displayFormat) << theme->reset << "\n";
     }
-    std::cout << theme->primary << "╚═══════════════════════════════════════════════════════════╝" << theme->reset << std::endl;
+    std::cout << theme->primary << "╚═══════════════════════════════════════════════════════════╝" << theme->reset << "\n";
 }
 
 double getFromHistory()
@@ -159,11 +228,11 @@ double getFromHistory()
 
     if (index >= 0 && index < history.size())
     {
-        std::cout << theme->success << "Using value: " << history[index] << theme->reset << std::endl;
+        std::cout << theme->success << "Using value: " << formatted(history[index], displayFormat) << theme->reset << "\n";
         return history[index];
     }
 
-    std::cout << theme->error << "Invalid index!" << theme->reset << std::endl;
+    std::cout << theme->error << "Invalid index!" << theme->reset << "\n";
     return 0;
 }
 
@@ -171,162 +240,600 @@ double getFromHistory()
 void memoryStore(double value)
 {
     memory = value;
-    std::cout << theme->success << "Value " << value << " stored in memory." << theme->reset << std::endl;
+    std::cout << theme->success << "Value " << formatted(value, displayFormat) << " stored in memory." << theme->reset << "\n";
 }
 
 void memoryRecall()
 {
-    std::cout << theme->success << "Memory: " << memory << theme->reset << std::endl;
+    std::cout << theme->success << "Memory: " << formatted(memory, displayFormat) << theme->reset << "\n";
 }
 
 void memoryClear()
 {
     memory = 0;
-    std::cout << theme->success << "Memory cleared." << theme->reset << std::endl;
+    std::cout << theme->success << "Memory cleared." << theme->reset << "\n";
 }
 
 void memoryAdd(double value)
 {
     memory += value;
-    std::cout << theme->success << "Added to memory. New value: " << memory << theme->reset << std::endl;
+    std::cout << theme->success << "Added to memory. New value: " << formatted(memory, displayFormat) << theme->reset << "\n";
 }
 
 void memorySubtract(double value)
 {
     memory -= value;
-    std::cout << theme->success << "Subtracted from memory. New value: " << memory << theme->reset << std::endl;
+    std::cout << theme->success << "Subtracted from memory. New value: " << formatted(memory, displayFormat) << theme->reset << "\n";
 }
 
-// Expression Parser
-int getPrecedence(char op)
+// Memory registers
+// Named registers next to the single memory above. A scalar register is a
+// compensated running total and a vector register holds one per element, so
+// M+ of a whole data column stays accurate however many values go in. Names
+// are identifiers, and a name is either a scalar or a vector register.
+struct VectorRegister
 {
-    if (op == '+' || op == '-')
-        return 1;
-    if (op == '*' || op == '/')
-        return 2;
-    if (op == '^')
-        return 3;
-    return 0;
+    std::vector<double> sums;
+    std::vector<double> errors;
+};
+std::map<std::string, CompensatedSum> scalarRegisters;
+std::map<std::string, VectorRegister> vectorRegisters;
+
+// Vector registers show their first few elements
+const size_t REGISTER_PREVIEW = 4;
+
+std::string getRegisterName()
+{
+    std::string name;
+    while (true)
+    {
+        std::cout << theme->warning << "Register name: " << theme->reset;
+        if (std::cin >> name && (std::isalpha(static_cast<unsigned char>(name[0])) || name[0] == '_') &&
+            std::all_of(name.begin(), name.end(), [](char c)
+                        { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; }))
+            return name;
+        std::cout << theme->error << "Invalid name! Use letters, digits and '_', starting with a letter."
+                  << theme->reset << "\n";
+        clearInput();
+    }
 }
 
-double applyOperation(double a, double b, char op)
+void printRegister(const std::string &name)
 {
-    switch (op)
+    std::map<std::string, CompensatedSum>::const_iterator scalar = scalarRegisters.find(name);
+    if (scalar != scalarRegisters.end())
     {
-    case '+':
-        return a + b;
-    case '-':
-        return a - b;
-    case '*':
-        return a * b;
-    case '/':
-        if (b == 0)
-            throw std::runtime_error("Division by zero");
-        return a / b;
-    case '^':
-        return std::pow(a, b);
-    default:
-        return 0;
+        std::cout << "  " << name << " = " << formatted(scalar->second.value(), displayFormat) << "\n";
+        return;
     }
+    const VectorRegister &vector = vectorRegisters.at(name);
+    size_t n = vector.sums.size();
+    std::cout << "  " << name << " [" << n << "] =";
+    for (size_t i = 0; i < std::min(n, REGISTER_PREVIEW); i++)
+        std::cout << " " << formatted(vector.sums[i] + vector.errors[i], displayFormat);
+    std::cout << (n > REGISTER_PREVIEW ? " ..." : "") << "\n";
+}
+
+bool isVectorRegister(const std::string &name)
+{
+    if (vectorRegisters.count(name) == 0)
+        return false;
+    std::cout << theme->error << "Error: Register " << name << " holds a vector!" << theme->reset << "\n";
+    return true;
+}
+
+void registerStore(const std::string &name, double value)
+{
+    if (isVectorRegister(name))
+        return;
+    scalarRegisters[name] = CompensatedSum{value, 0.0};
+    std::cout << theme->success << "Value " << formatted(value, displayFormat) << " stored in register " << name << "."
+              << theme->reset << "\n";
+}
+
+void registerAdd(const std::string &name, double value)
+{
+    if (isVectorRegister(name))
+        return;
+    scalarRegisters[name].add(value);
+    std::cout << theme->success;
+    printRegister(name);
+    std::cout << theme->reset;
+}
+
+void registerClear(const std::string &name)
+{
+    if (scalarRegisters.erase(name) + vectorRegisters.erase(name) == 0)
+        std::cout << theme->warning << "No register named " << name << "." << theme->reset << "\n";
+    else
+        std::cout << theme->success << "Register " << name << " cleared." << theme->reset << "\n";
 }
 
-double evaluateExpression(const std::string &expr)
+void listRegisters()
 {
-    std::stack<double> values;
-    std::stack<char> ops;
+    std::cout << theme->primary << "\n=== Registers ===" << theme->reset << "\n";
+    std::cout << "  Memory = " << formatted(memory, displayFormat) << "\n";
+    std::vector<std::string> names;
+    for (const auto &entry : scalarRegisters)
+        names.push_back(entry.first);
+    for (const auto &entry : vectorRegisters)
+        names.push_back(entry.first);
+    std::sort(names.begin(), names.end());
+    for (const std::string &name : names)
+        printRegister(name);
+}
 
-    for (int i = 0; i < expr.length(); i++)
+// Bulk M+ or M- of one column of a text or .cmat file: its total into a
+// scalar register, or element by element into a vector register
+void accumulateFileColumn(double sign)
+{
+    clearInput();
+    std::string filename;
+    std::cout << theme->warning << "Enter file name (text columns or .cmat): " << theme->reset;
+    std::getline(std::cin, filename);
+    try
     {
-        if (isspace(expr[i]))
-            continue;
+        Matrix data = loadMatrixFromFile(filename);
+        if (data.size() == 0)
+            throw std::runtime_error("No numbers in file");
+        size_t column = 0;
+        if (data.cols() > 1)
+        {
+            std::cout << "The file has " << data.cols() << " columns.\n";
+            column = static_cast<size_t>(getValidChoice(1, static_cast<int>(data.cols())) - 1);
+        }
+        std::cout << "1. Scalar Register (total of the column)\n";
+        std::cout << "2. Vector Register (element by element)\n";
+        bool elementwise = getValidChoice(1, 2) == 2;
+        std::string name = getRegisterName();
+
+        // Columns of a row-major matrix are strided; the kernels want them contiguous
+        size_t n = data.rows();
+        const double *values = data.data();
+        std::pmr::vector<double> gathered(&commandArena);
+        if (data.cols() > 1)
+        {
+            gathered.resize(n);
+            for (size_t i = 0; i < n; i++)
+                gathered[i] = data(i, column);
+            values = gathered.data();
+        }
 
-        if (isdigit(expr[i]) || expr[i] == '.')
+        if (!elementwise)
+        {
+            if (isVectorRegister(name))
+                return;
+            accumulate(scalarRegisters[name], values, n, sign);
+        }
+        else
         {
-            std::string numStr;
-            while (i < expr.length() && (isdigit(expr[i]) || expr[i] == '.'))
+            if (scalarRegisters.count(name))
+                throw std::runtime_error("Register " + name + " holds a scalar");
+            VectorRegister &vector = vectorRegisters[name];
+            if (vector.sums.empty())
             {
-                numStr += expr[i++];
+                vector.sums.assign(n, 0.0);
+                vector.errors.assign(n, 0.0);
             }
-            i--;
-            values.push(std::stod(numStr));
+            else if (vector.sums.size() != n)
+                throw std::runtime_error("Register " + name + " holds " + std::to_string(vector.sums.size()) +
+                                         " values, the column has " + std::to_string(n));
+            accumulateElements(vector.sums.data(), vector.errors.data(), values, n, sign);
+        }
+        std::cout << theme->success << n << " values " << (sign > 0 ? "added" : "subtracted") << "\n";
+        printRegister(name);
+        std::cout << theme->reset;
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << theme->error << "Error: " << e.what() << theme->reset << "\n";
+    }
+}
+
+// Number type used by the expression calculator
+enum ExpressionPrecision
+{
+    PRECISION_DOUBLE,
+    PRECISION_DOUBLE_DOUBLE,
+    PRECISION_MULTI,
+    PRECISION_INTERVAL
+};
+ExpressionPrecision expressionPrecision = PRECISION_DOUBLE;
+
+std::string expressionPrecisionName()
+{
+    switch (expressionPrecision)
+    {
+    case PRECISION_DOUBLE_DOUBLE:
+        return "double-double (~32 digits)";
+    case PRECISION_MULTI:
+        return "multiprecision (" + std::to_string(BigFloat::defaultPrecision) + " bits, ~" +
+               std::to_string(static_cast<int>((BigFloat::defaultPrecision - 1) * 0.30102999566398119521)) + " digits)";
+    case PRECISION_INTERVAL:
+        return "interval (guaranteed double bounds)";
+    default:
+        return "double";
+    }
+}
+
+void expressionCalculator()
+{
+    std::cout << theme->primary << "\n╔══════════ EXPRESSION CALCULATOR ══════════╗" << theme->reset << "\n";
+    std::cout << "Supports: +, -, *, /, ^, ( )\n";
+    std::cout << "Example: 3+5*2, (10+5)/3, 2^3+4\n";
+    std::cout << "Precision: " << expressionPrecisionName() << "\n";
+    std::cout << theme->primary << "╚════════════════════════════════════════════╝" << theme->reset << "\n";
+
+    clearInput();
+    std::string expr;
+    std::cout << theme->warning << "Enter expression: " << theme->reset;
+    std::getline(std::cin, expr);
+
+    try
+    {
+        CompiledExpression compiled(expr);
+        double result;
+        if (expressionPrecision == PRECISION_DOUBLE)
+        {
+            result = compiled.evaluate<double>();
+            std::cout << theme->success << "\nResult: " << theme->bold << formatted(result, displayFormat) << theme->reset << "\n";
         }
-        else if (expr[i] == '(')
+        else if (expressionPrecision == PRECISION_INTERVAL)
         {
-            ops.push(expr[i]);
+            // The exact value lies in the enclosure; check the double evaluation against it
+            Interval value = compiled.evaluate<Interval>();
+            double native = compiled.evaluate<double>();
+            result = value.midpoint();
+            std::ios_base::fmtflags flags = std::cout.flags();
+            std::streamsize precision = std::cout.precision();
+            std::cout << theme->success << "\nResult: " << theme->bold << value.toString() << theme->reset << "\n";
+            std::cout << std::scientific << std::setprecision(3) << "Width: " << value.width() << "\n";
+            std::cout << std::defaultfloat << std::setprecision(17) << "Double evaluation: " << native
+                      << (value.contains(native) ? "  (inside)" : "  (outside)") << "\n";
+            std::cout.flags(flags);
+            std::cout.precision(precision);
         }
-        else if (expr[i] == ')')
+        else
         {
-            while (!ops.empty() && ops.top() != '(')
+            // Show the double evaluation and its error against the wider result
+            double native = compiled.evaluate<double>();
+            std::string digits;
+            double error = NAN;
+            if (expressionPrecision == PRECISION_DOUBLE_DOUBLE)
+            {
+                DoubleDouble value = compiled.evaluate<DoubleDouble>();
+                digits = value.toString();
+                result = value.toDouble();
+                error = (DoubleDouble(native) - value).toDouble();
+            }
+            else
             {
-                double b = values.top();
-                values.pop();
-                double a = values.top();
-                values.pop();
-                char op = ops.top();
-                ops.pop();
-                values.push(applyOperation(a, b, op));
+                BigFloat value = compiled.evaluate<BigFloat>();
+                digits = value.toString();
+                result = value.toDouble();
+                if (std::isfinite(native))
+                    error = (BigFloat(native) - value).toDouble();
             }
-            if (!ops.empty())
-                ops.pop(); // Remove '('
+            std::ios_base::fmtflags flags = std::cout.flags();
+            std::streamsize precision = std::cout.precision();
+            std::cout << theme->success << "\nResult: " << theme->bold << digits << theme->reset << "\n";
+            std::cout << std::defaultfloat << std::setprecision(17) << "Double evaluation: " << native
+                      << std::scientific << std::setprecision(3) << "  (error " << error << ")" << "\n";
+            std::cout.flags(flags);
+            std::cout.precision(precision);
         }
-        else if (expr[i] == '+' || expr[i] == '-' || expr[i] == '*' || expr[i] == '/' || expr[i] == '^')
+        addToHistory(result, expr);
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << theme->error << "Error: " << e.what() << theme->reset << "\n";
+    }
+}
+
+// Checks a file of expressions, one per line with an optional "= value",
+// against interval enclosures. Lines of the same shape are evaluated
+// together, one vectorized batch kernel per operator
+void intervalCheckFromFile()
+{
+    clearInput();
+    std::string filename, text;
+    std::cout << theme->warning << "Enter file name (one expression per line, optionally '= value'): " << theme->reset;
+    std::getline(std::cin, filename);
+    if (!readFileContents(filename, text))
+    {
+        std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
+        return;
+    }
+
+    struct ShapeGroup
+    {
+        CompiledExpression program;
+        std::vector<size_t> lines;
+        std::vector<IntervalArray> columns;
+    };
+    std::vector<ShapeGroup> groups;
+    std::map<std::string, size_t> groupOf;
+    std::vector<std::string> errors; // Empty for lines that parsed
+    std::vector<double> checked;     // The claimed value, or the double evaluation
+
+    std::istringstream lines(text);
+    std::string line;
+    Arena lineArena; // Holds each line's compiled form; groups keep heap copies
+    while (std::getline(lines, line))
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        size_t index = errors.size();
+        errors.emplace_back();
+        checked.push_back(NAN);
+        lineArena.reset();
+        try
         {
-            // Handle negative numbers
-            if (expr[i] == '-' && (i == 0 || expr[i - 1] == '(' || expr[i - 1] == '+' ||
-                                   expr[i - 1] == '-' || expr[i - 1] == '*' || expr[i - 1] == '/' || expr[i - 1] == '^'))
+            size_t equals = line.find('=');
+            CompiledExpression compiled(std::string_view(line).substr(0, equals), &lineArena);
+            if (!compiled.variableNames().empty())
+                throw std::runtime_error("Variables are not supported here");
+            std::vector<Interval> literals = compiled.literalValues<Interval>();
+            if (equals != std::string::npos)
+            {
+                checked[index] = std::stod(line.substr(equals + 1));
+            }
+            else
             {
-                values.push(0);
+                try
+                {
+                    checked[index] = compiled.evaluate<double>();
+                }
+                catch (const std::runtime_error &)
+                {
+                }
             }
 
-            while (!ops.empty() && getPrecedence(ops.top()) >= getPrecedence(expr[i]))
+            std::map<std::string, size_t>::iterator found = groupOf.find(compiled.shape());
+            if (found == groupOf.end())
             {
-                double b = values.top();
-                values.pop();
-                double a = values.top();
-                values.pop();
-                char op = ops.top();
-                ops.pop();
-                values.push(applyOperation(a, b, op));
+                found = groupOf.emplace(compiled.shape(), groups.size()).first;
+                groups.push_back({compiled, {}, std::vector<IntervalArray>(literals.size())});
             }
-            ops.push(expr[i]);
+            ShapeGroup &group = groups[found->second];
+            group.lines.push_back(index);
+            for (size_t k = 0; k < literals.size(); k++)
+            {
+                group.columns[k].lo.push_back(literals[k].lo);
+                group.columns[k].hi.push_back(literals[k].hi);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            errors[index] = e.what();
         }
     }
+    if (errors.empty())
+    {
+        std::cout << theme->error << "Error: No expressions in file" << theme->reset << "\n";
+        return;
+    }
+
+    std::vector<Interval> results(errors.size(), Interval(NAN));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (const ShapeGroup &group : groups)
+    {
+        IntervalArray value = group.program.evaluate(group.columns, {}, [](const IntervalArray &a, const IntervalArray &b, char op)
+        {
+            IntervalArray out;
+            if (op == '+')
+                IntervalBatch::add(a, b, out);
+            else if (op == '-')
+                IntervalBatch::subtract(a, b, out);
+            else if (op == '*')
+                IntervalBatch::multiply(a, b, out);
+            else if (op == '/')
+                IntervalBatch::divide(a, b, out);
+            else
+                IntervalBatch::power(a, b, out);
+            return out;
+        });
+        for (size_t j = 0; j < group.lines.size(); j++)
+            results[group.lines[j]] = Interval(value.lo[j], value.hi[j]);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // One line per expression: lo hi value inside(1/0)
+    std::string out;
+    size_t outside = 0, failed = 0, unchecked = 0;
+    double widest = 0;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        if (!errors[i].empty())
+        {
+            out += "error " + errors[i] + "\n";
+            failed++;
+            continue;
+        }
+        bool inside = results[i].contains(checked[i]);
+        unchecked += std::isnan(checked[i]);
+        outside += !inside && !std::isnan(checked[i]);
+        if (std::isfinite(results[i].width()))
+            widest = std::max(widest, results[i].width());
+        appendNumber(out, results[i].lo);
+        out += ' ';
+        appendNumber(out, results[i].hi);
+        out += ' ';
+        appendNumber(out, checked[i]);
+        out += inside ? " 1\n" : " 0\n";
+    }
+    std::ofstream file("interval_result.txt", std::ios::binary);
+    file.write(out.data(), out.size());
+
+    std::cout << theme->success << "\nChecked " << results.size() - failed << " expressions in " << groups.size()
+              << " shapes, " << seconds << " s" << theme->reset << "\n";
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << std::scientific << std::setprecision(3) << "Widest finite enclosure: " << widest << "\n";
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+    if (outside > 0)
+        std::cout << theme->warning << outside << " values lie outside their enclosure" << theme->reset << "\n";
+    if (unchecked > 0)
+        std::cout << theme->warning << unchecked << " expressions had no double value to check" << theme->reset << "\n";
+    if (failed > 0)
+        std::cout << theme->warning << failed << " lines could not be parsed" << theme->reset << "\n";
+    std::cout << theme->success << "Enclosures saved to 'interval_result.txt'" << theme->reset << "\n";
+}
+
+void precisionModeMenu()
+{
+    std::cout << theme->accent << "\n┌─── Expression Precision ───┐" << theme->reset << "\n";
+    std::cout << "Current: " << expressionPrecisionName() << "\n";
+    std::cout << "1. Double (53 bits, hardware)\n";
+    std::cout << "2. Double-Double (106 bits, a few times slower)\n";
+    std::cout << "3. Multiprecision (64-8192 bits, software)\n";
+    std::cout << "4. Interval (guaranteed bounds on the exact result)\n";
+    std::cout << "5. Interval Check of Expression File\n";
+    int choice = getValidChoice(1, 5);
 
-    while (!ops.empty())
+    if (choice == 5)
+    {
+        intervalCheckFromFile();
+        return;
+    }
+    if (choice == 1)
+        expressionPrecision = PRECISION_DOUBLE;
+    else if (choice == 2)
+        expressionPrecision = PRECISION_DOUBLE_DOUBLE;
+    else if (choice == 4)
+        expressionPrecision = PRECISION_INTERVAL;
+    else
     {
-        double b = values.top();
-        values.pop();
-        double a = values.top();
-        values.pop();
-        char op = ops.top();
-        ops.pop();
-        values.push(applyOperation(a, b, op));
+        std::cout << "Bits of precision (" << BigFloat::MIN_PRECISION << "-" << BigFloat::MAX_PRECISION << "):\n";
+        BigFloat::defaultPrecision = static_cast<unsigned>(getValidChoice(BigFloat::MIN_PRECISION, BigFloat::MAX_PRECISION));
+        expressionPrecision = PRECISION_MULTI;
     }
+    std::cout << theme->success << "Expression calculator uses " << expressionPrecisionName() << theme->reset << "\n";
+}
 
-    return values.top();
+// Reads "name value" or "name = value" lines into the variable order of an expression
+std::vector<double> readVariableValues(const std::string &text, const std::vector<std::string> &names)
+{
+    std::map<std::string, size_t> indexOf;
+    for (size_t i = 0; i < names.size(); i++)
+        indexOf[names[i]] = i;
+    std::vector<double> values(names.size(), NAN);
+    std::vector<bool> given(names.size(), false);
+
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        std::replace(line.begin(), line.end(), '=', ' ');
+        std::istringstream fields(line);
+        std::string name;
+        double value;
+        if (!(fields >> name))
+            continue;
+        if (!(fields >> value))
+            throw std::runtime_error("No value on the line for " + name);
+        std::map<std::string, size_t>::const_iterator found = indexOf.find(name);
+        if (found == indexOf.end())
+            throw std::runtime_error("No variable named " + name);
+        values[found->second] = value;
+        given[found->second] = true;
+    }
+    for (size_t i = 0; i < names.size(); i++)
+        if (!given[i])
+            throw std::runtime_error("No value for variable " + names[i]);
+    return values;
 }
 
-void expressionCalculator()
+// Gradient of an expression with respect to its variables by automatic
+// differentiation, exact to rounding and in one pass instead of the N + 1
+// evaluations of finite differences
+void gradientCalculator()
 {
-    std::cout << theme->primary << "\n╔══════════ EXPRESSION CALCULATOR ══════════╗" << theme->reset << std::endl;
-    std::cout << "Supports: +, -, *, /, ^, ( )\n";
-    std::cout << "Example: 3+5*2, (10+5)/3, 2^3+4\n";
-    std::cout << theme->primary << "╚════════════════════════════════════════════╝" << theme->reset << std::endl;
+    std::cout << theme->primary << "\n╔══════════ GRADIENT (AUTO DIFF) ══════════╗" << theme->reset << "\n";
+    std::cout << "Variables are names such as x, y or rate_2\n";
+    std::cout << "Example: x^2*y + 3*x/y\n";
+    std::cout << "Enter @file to read a long expression from a file\n";
+    std::cout << theme->primary << "╚═══════════════════════════════════════════╝" << theme->reset << "\n";
 
     clearInput();
     std::string expr;
     std::cout << theme->warning << "Enter expression: " << theme->reset;
     std::getline(std::cin, expr);
+    bool fromFile = !expr.empty() && expr[0] == '@';
+    if (fromFile && !readFileContents(expr.substr(1), expr))
+    {
+        std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
+        return;
+    }
 
     try
     {
-        double result = evaluateExpression(expr);
-        std::cout << theme->success << "\nResult: " << theme->bold << result << theme->reset << std::endl;
-        addToHistory(result, expr);
+        CompiledExpression compiled(expr);
+        const std::vector<std::string> &names = compiled.variableNames();
+        if (names.empty())
+            throw std::runtime_error("Expression has no variables");
+
+        std::cout << names.size() << " variables\n";
+        std::cout << "1. Enter values\n";
+        std::cout << "2. Load values from file (name value per line)\n";
+        std::vector<double> point;
+        if (getValidChoice(1, 2) == 1)
+        {
+            for (const std::string &name : names)
+                point.push_back(getValidNumber(name + " = "));
+        }
+        else
+        {
+            clearInput();
+            std::string filename, text;
+            std::cout << theme->warning << "Enter file name: " << theme->reset;
+            std::getline(std::cin, filename);
+            if (!readFileContents(filename, text))
+            {
+                std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
+                return;
+            }
+            point = readVariableValues(text, names);
+        }
+
+        std::cout << "1. Reverse mode (tape, best for many variables)\n";
+        std::cout << "2. Forward mode (dual numbers)\n";
+        bool reverse = getValidChoice(1, 2) == 1;
+
+        std::vector<double> literals = compiled.literalValues<double>();
+        std::vector<double> gradient;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        double value = reverse ? compiled.gradient(literals, point, gradient)
+                               : compiled.gradientForward(literals, point, gradient);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << theme->success << "\nValue: " << theme->bold << value << theme->reset << "\n";
+        if (names.size() <= 20)
+        {
+            for (size_t i = 0; i < names.size(); i++)
+                std::cout << "  d/d" << names[i] << " = " << gradient[i] << "\n";
+        }
+        else
+        {
+            std::string out;
+            for (size_t i = 0; i < names.size(); i++)
+            {
+                out += names[i];
+                out += ' ';
+                appendNumber(out, gradient[i]);
+                out += '\n';
+            }
+            std::ofstream file("gradient_result.txt", std::ios::binary);
+            file.write(out.data(), out.size());
+            std::cout << theme->success << "Gradient saved to 'gradient_result.txt'" << theme->reset << "\n";
+        }
+        std::cout << "Gradient computed in " << seconds << " s" << "\n";
+        addToHistory(value, fromFile ? "gradient" : expr);
     }
     catch (const std::exception &e)
     {
-        std::cout << theme->error << "Error: " << e.what() << theme->reset << std::endl;
+        std::cout << theme->error << "Error: " << e.what() << theme->reset << "\n";
     }
 }
 
@@ -336,7 +843,7 @@ class ComplexCalculator
 public:
     static void add()
     {
-        std::cout << theme->primary << "\n=== Complex Addition ===" << theme->reset << std::endl;
+        std::cout << theme->primary << "\n=== Complex Addition ===" << theme->reset << "\n";
         double r1 = getValidNumber("Enter real part of first number: ");
         double i1 = getValidNumber("Enter imaginary part of first number: ");
         double r2 = getValidNumber("Enter real part of second number: ");
@@ -351,7 +858,7 @@ public:
 
     static void multiply()
     {
-        std::cout << theme->primary << "\n=== Complex Multiplication ===" << theme->reset << std::endl;
+        std::cout << theme->primary << "\n=== Complex Multiplication ===" << theme->reset << "\n";
         double r1 = getValidNumber("Enter real part of first number: ");
         double i1 = getValidNumber("Enter imaginary part of first number: ");
         double r2 = getValidNumber("Enter real part of second number: ");
@@ -366,34 +873,34 @@ public:
 
     static void magnitude()
     {
-        std::cout << theme->primary << "\n=== Complex Magnitude ===" << theme->reset << std::endl;
+        std::cout << theme->primary << "\n=== Complex Magnitude ===" << theme->reset << "\n";
         double r = getValidNumber("Enter real part: ");
         double i = getValidNumber("Enter imaginary part: ");
 
         std::complex<double> c(r, i);
         double mag = std::abs(c);
 
-        std::cout << theme->success << "Magnitude: " << mag << theme->reset << std::endl;
+        std::cout << theme->success << "Magnitude: " << mag << theme->reset << "\n";
         addToHistory(mag, "magnitude");
     }
 
     static void phase()
     {
-        std::cout << theme->primary << "\n=== Complex Phase/Argument ===" << theme->reset << std::endl;
+        std::cout << theme->primary << "\n=== Complex Phase/Argument ===" << theme->reset << "\n";
         double r = getValidNumber("Enter real part: ");
         double i = getValidNumber("Enter imaginary part: ");
 
         std::complex<double> c(r, i);
         double ph = std::arg(c);
 
-        std::cout << theme->success << "Phase (radians): " << ph << theme->reset << std::endl;
-        std::cout << theme->success << "Phase (degrees): " << (ph * 180.0 / M_PI) << theme->reset << std::endl;
+        std::cout << theme->success << "Phase (radians): " << ph << theme->reset << "\n";
+        std::cout << theme->success << "Phase (degrees): " << (ph * 180.0 / M_PI) << theme->reset << "\n";
         addToHistory(ph, "phase");
     }
 
     static void conjugate()
     {
-        std::cout << theme->primary << "\n=== Complex Conjugate ===" << theme->reset << std::endl;
+        std::cout << theme->primary << "\n=== Complex Conjugate ===" << theme->reset << "\n";
         double r = getValidNumber("Enter real part: ");
         double i = getValidNumber("Enter imaginary part: ");
 
@@ -413,20 +920,243 @@ private:
             std::cout << " + " << c.imag() << "i";
         else
             std::cout << " - " << std::abs(c.imag()) << "i";
-        std::cout << theme->reset << std::endl;
+        std::cout << theme->reset << "\n";
     }
 };
 
+// Reads "re im" pairs from a file, applies one kernel and writes the results
+void complexBatchFromFile()
+{
+    std::cout << theme->accent << "\n┌─── Batch Complex Operations ───┐" << theme->reset << "\n";
+    std::cout << "1. Magnitude\n";
+    std::cout << "2. Phase/Argument\n";
+    std::cout << "3. Conjugate\n";
+    std::cout << "4. Multiply by Constant\n";
+    int choice = getValidChoice(1, 4);
+
+    std::complex<double> factor;
+    if (choice == 4)
+    {
+        double r = getValidNumber("Enter real part of constant: ");
+        double i = getValidNumber("Enter imaginary part of constant: ");
+        factor = std::complex<double>(r, i);
+    }
+
+    clearInput();
+    std::string filename, text;
+    std::cout << theme->warning << "Enter input file name (re im pairs): " << theme->reset;
+    std::getline(std::cin, filename);
+    if (!readFileContents(filename, text))
+    {
+        std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
+        return;
+    }
+
+    std::vector<double> values = parseNumbers(text);
+    ComplexArray data;
+    data.resize(values.size() / 2);
+    for (size_t k = 0; k < data.size(); k++)
+    {
+        data.re[k] = values[2 * k];
+        data.im[k] = values[2 * k + 1];
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<double> scalars;
+    ComplexArray result;
+    switch (choice)
+    {
+    case 1:
+        scalars.resize(data.size());
+        ComplexBatch::magnitude(data, scalars.data());
+        break;
+    case 2:
+        scalars.resize(data.size());
+        ComplexBatch::phase(data, scalars.data());
+        break;
+    case 3:
+        ComplexBatch::conjugate(data, result);
+        break;
+    case 4:
+        ComplexBatch::scale(data, factor, result);
+        break;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::string out;
+    for (size_t k = 0; k < data.size(); k++)
+    {
+        if (choice <= 2)
+        {
+            appendNumber(out, scalars[k]);
+        }
+        else
+        {
+            appendNumber(out, result.re[k]);
+            out += ' ';
+            appendNumber(out, result.im[k]);
+        }
+        out += '\n';
+    }
+    std::ofstream file("complex_result.txt", std::ios::binary);
+    file.write(out.data(), out.size());
+
+    std::cout << theme->success << "Processed " << data.size() << " samples in " << seconds
+              << " s, saved to 'complex_result.txt'" << theme->reset << "\n";
+}
+
+void fftSpectrum()
+{
+    std::cout << theme->primary << "\n=== FFT & Spectrum ===" << theme->reset << "\n";
+    std::cout << "1. Spectrum of Real Samples\n";
+    std::cout << "2. Complex FFT (re im pairs)\n";
+    std::cout << "3. Inverse Complex FFT (re im pairs)\n";
+    std::cout << "4. Convolution of Two Files\n";
+    int choice = getValidChoice(1, 4);
+
+    double sampleRate = 1.0;
+    if (choice == 1)
+    {
+        sampleRate = getValidNumber("Enter sample rate (Hz): ");
+        if (sampleRate <= 0)
+        {
+            std::cout << theme->error << "Error: Sample rate must be positive!" << theme->reset << "\n";
+            return;
+        }
+    }
+
+    clearInput();
+    std::string filename, text;
+    std::cout << theme->warning << "Enter input file name: " << theme->reset;
+    std::getline(std::cin, filename);
+    if (!readFileContents(filename, text))
+    {
+        std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
+        return;
+    }
+    std::vector<double> values = parseNumbers(text);
+
+    try
+    {
+        std::string out;
+        std::string resultFile = "fft_result.txt";
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        if (choice == 1)
+        {
+            std::vector<std::complex<double>> spectrum = realSpectrum(values);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            // Single-sided power with DC excluded from the peak search
+            size_t n = values.size();
+            double totalPower = 0.0, weighted = 0.0, peakPower = -1.0;
+            size_t peak = 0;
+            for (size_t k = 0; k < spectrum.size(); k++)
+            {
+                double magnitude = std::abs(spectrum[k]);
+                double frequency = k * sampleRate / n;
+                double power = magnitude * magnitude;
+                totalPower += power;
+                weighted += power * frequency;
+                if (k > 0 && power > peakPower)
+                {
+                    peakPower = power;
+                    peak = k;
+                }
+                appendNumber(out, frequency);
+                out += ' ';
+                appendNumber(out, magnitude);
+                out += ' ';
+                appendNumber(out, std::arg(spectrum[k]));
+                out += '\n';
+            }
+
+            std::cout << theme->success << "\nTransformed " << n << " samples in " << seconds << " s" << theme->reset << "\n";
+            std::cout << "DC component (mean): " << spectrum[0].real() / n << "\n";
+            if (peak > 0)
+            {
+                double scale = (2 * peak == n) ? 1.0 : 2.0;
+                std::cout << "Dominant frequency:  " << peak * sampleRate / n << " Hz (amplitude "
+                          << scale * std::abs(spectrum[peak]) / n << ")" << "\n";
+            }
+            if (totalPower > 0)
+                std::cout << "Spectral centroid:   " << weighted / totalPower << " Hz" << "\n";
+            std::cout << "Frequency resolution: " << sampleRate / n << " Hz" << "\n";
+        }
+        else if (choice == 2 || choice == 3)
+        {
+            size_t n = values.size() / 2;
+            if (n == 0)
+                throw std::invalid_argument("No samples to transform");
+            std::vector<std::complex<double>> in(n), result(n);
+            for (size_t k = 0; k < n; k++)
+                in[k] = std::complex<double>(values[2 * k], values[2 * k + 1]);
+            std::shared_ptr<const FftPlan> plan = FftPlan::get(n);
+            if (choice == 2)
+            {
+                plan->forward(in.data(), result.data());
+            }
+            else
+            {
+                plan->inverse(in.data(), result.data());
+                for (size_t k = 0; k < n; k++)
+                    result[k] /= static_cast<double>(n);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            for (size_t k = 0; k < n; k++)
+            {
+                appendNumber(out, result[k].real());
+                out += ' ';
+                appendNumber(out, result[k].imag());
+                out += '\n';
+            }
+            std::cout << theme->success << "\nTransformed " << n << " points in " << seconds << " s"
+                      << (plan->usesBluestein() ? " (Bluestein)" : "") << theme->reset << "\n";
+        }
+        else
+        {
+            std::string secondFile, secondText;
+            std::cout << theme->warning << "Enter second file name: " << theme->reset;
+            std::getline(std::cin, secondFile);
+            if (!readFileContents(secondFile, secondText))
+            {
+                std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
+                return;
+            }
+            start = std::chrono::steady_clock::now();
+            std::vector<double> result = fftConvolve(values, parseNumbers(secondText));
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            for (double v : result)
+            {
+                appendNumber(out, v);
+                out += '\n';
+            }
+            resultFile = "convolution_result.txt";
+            std::cout << theme->success << "\nConvolution of length " << result.size() << " in " << seconds << " s"
+                      << theme->reset << "\n";
+        }
+
+        std::ofstream file(resultFile, std::ios::binary);
+        file.write(out.data(), out.size());
+        std::cout << theme->success << "Results saved to '" << resultFile << "'" << theme->reset << "\n";
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << theme->error << "Error: " << e.what() << theme->reset << "\n";
+    }
+}
+
 void complexNumberMenu()
 {
-    std::cout << theme->accent << "\n┌─── Complex Number Operations ───┐" << theme->reset << std::endl;
+    std::cout << theme->accent << "\n┌─── Complex Number Operations ───┐" << theme->reset << "\n";
     std::cout << "1. Addition\n";
     std::cout << "2. Multiplication\n";
     std::cout << "3. Magnitude\n";
     std::cout << "4. Phase/Argument\n";
     std::cout << "5. Conjugate\n";
+    std::cout << "6. Batch Operations (file)\n";
 
-    int choice = getValidChoice(1, 5);
+    int choice = getValidChoice(1, 6);
 
     switch (choice)
     {
@@ -445,6 +1175,9 @@ void complexNumberMenu()
     case 5:
         ComplexCalculator::conjugate();
         break;
+    case 6:
+        complexBatchFromFile();
+        break;
     }
 }
 
@@ -453,19 +1186,19 @@ void saveHistoryToFile()
 {
     if (history.empty())
     {
-        std::cout << theme->warning << "No history to save." << theme->reset << std::endl;
+        std::cout << theme->warning << "No history to save." << theme->reset << "\n";
         return;
     }
 
     std::ofstream file("calculator_history.txt");
     if (!file.is_open())
     {
-        std::cout << theme->error << "Error opening file!" << theme->reset << std::endl;
+        std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
         return;
     }
 
     time_t now = time(0);
-    file << "Calculator History - " << ctime(&now) << std::endl;
+    file << "Calculator History - " << ctime(&now) << "\n";
     file << "================================\n\n";
 
     for (int i = 0; i < history.size(); i++)
@@ -473,121 +1206,102 @@ void saveHistoryToFile()
         file << "[" << i << "] ";
         if (!historyLabels[i].empty())
             file << historyLabels[i] << " = ";
-        file << history[i] << std::endl;
+        file << formatted(history[i]) << '\n';
     }
 
     file.close();
-    std::cout << theme->success << "History saved to 'calculator_history.txt'" << theme->reset << std::endl;
+    std::cout << theme->success << "History saved to 'calculator_history.txt'" << theme->reset << "\n";
 }
 
-void saveMatrixToFile(const std::vector<std::vector<double>> &matrix, const std::string &filename)
+// Text export keeps full double precision so files round-trip through loadMatrixText
+void saveMatrixToFile(const Matrix &matrix, const std::string &filename)
 {
-    std::ofstream file(filename);
+    std::ofstream file(filename, std::ios::binary);
     if (!file.is_open())
     {
-        std::cout << theme->error << "Error opening file!" << theme->reset << std::endl;
+        std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
         return;
     }
 
-    file << "Matrix (" << matrix.size() << "x" << matrix[0].size() << ")\n";
-    file << "================================\n\n";
+    std::string out = "Matrix (" + std::to_string(matrix.rows()) + "x" + std::to_string(matrix.cols()) + ")\n";
+    out += "================================\n\n";
+    out.reserve(out.size() + matrix.size() * 26);
 
-    for (const auto &row : matrix)
+    char buf[MAX_FORMATTED_LENGTH];
+    for (size_t i = 0; i < matrix.rows(); i++)
     {
-        for (double val : row)
+        for (size_t j = 0; j < matrix.cols(); j++)
         {
-            file << std::setw(12) << std::fixed << std::setprecision(4) << val << " ";
+            size_t len = formatNumber(buf, matrix(i, j));
+            if (len < 24)
+                out.append(24 - len, ' ');
+            out.append(buf, len);
+            out += ' ';
         }
-        file << std::endl;
+        out += '\n';
     }
 
+    file.write(out.data(), out.size());
     file.close();
-    std::cout << theme->success << "Matrix saved to '" << filename << "'" << theme->reset << std::endl;
+    std::cout << theme->success << "Matrix saved to '" << filename << "'" << theme->reset << "\n";
 }
 
-void saveStatisticsToFile(const std::vector<double> &data)
+void printModes(std::ostream &out, const StatisticsSummary &s, NumberFormat format = NumberFormat())
+{
+    if (s.modes.size() == s.count)
+    {
+        out << "No mode";
+        return;
+    }
+    for (size_t i = 0; i < s.modes.size(); i++)
+    {
+        out << formatted(s.modes[i], format);
+        if (i < s.modes.size() - 1)
+            out << ", ";
+    }
+}
+
+void saveStatisticsToFile(const std::vector<double> &data)
 {
     std::ofstream file("statistics_report.txt");
     if (!file.is_open())
     {
-        std::cout << theme->error << "Error opening file!" << theme->reset << std::endl;
+        std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
         return;
     }
 
     time_t now = time(0);
-    file << "Statistics Report - " << ctime(&now) << std::endl;
+    file << "Statistics Report - " << ctime(&now) << "\n";
     file << "================================\n\n";
 
-    double sum = 0, mean, variance = 0;
-    for (double num : data)
-        sum += num;
-    mean = sum / data.size();
-    for (double num : data)
-        variance += std::pow(num - mean, 2);
-    variance /= data.size();
-
-    std::vector<double> sorted = data;
-    std::sort(sorted.begin(), sorted.end());
-    double median = (sorted.size() % 2 == 0) ? (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2.0 : sorted[sorted.size() / 2];
-
-    // Calculate mode
-    std::map<double, int> frequency;
-    for (double num : data)
-        frequency[num]++;
-
-    int maxFreq = 0;
-    std::vector<double> modes;
-    for (const auto &pair : frequency)
-    {
-        if (pair.second > maxFreq)
-        {
-            maxFreq = pair.second;
-            modes.clear();
-            modes.push_back(pair.first);
-        }
-        else if (pair.second == maxFreq)
-        {
-            modes.push_back(pair.first);
-        }
-    }
-
-    file << "Count: " << data.size() << std::endl;
-    file << "Sum: " << sum << std::endl;
-    file << "Mean: " << mean << std::endl;
-    file << "Median: " << median << std::endl;
+    StatisticsSummary s = computeStatistics(data, &commandArena);
+    file << "Count: " << s.count << "\n";
+    file << "Sum: " << formatted(s.sum) << "\n";
+    file << "Mean: " << formatted(s.mean) << "\n";
+    file << "Median: " << formatted(s.median) << "\n";
     file << "Mode: ";
-    if (modes.size() == data.size())
-        file << "No mode";
-    else
-    {
-        for (int i = 0; i < modes.size(); i++)
-        {
-            file << modes[i];
-            if (i < modes.size() - 1)
-                file << ", ";
-        }
-    }
-    file << std::endl;
-    file << "Min: " << *std::min_element(data.begin(), data.end()) << std::endl;
-    file << "Max: " << *std::max_element(data.begin(), data.end()) << std::endl;
-    file << "Range: " << (*std::max_element(data.begin(), data.end()) - *std::min_element(data.begin(), data.end())) << std::endl;
-    file << "Variance: " << variance << std::endl;
-    file << "Std Dev: " << std::sqrt(variance) << std::endl;
+    printModes(file, s);
+    file << "\n";
+    file << "Min: " << formatted(s.minimum) << "\n";
+    file << "Max: " << formatted(s.maximum) << "\n";
+    file << "Range: " << formatted(s.maximum - s.minimum) << "\n";
+    file << "Variance: " << formatted(s.variance) << "\n";
+    file << "Std Dev: " << formatted(std::sqrt(s.variance)) << "\n";
 
     file << "\nData Points:\n";
-    for (int i = 0; i < data.size(); i++)
+    for (size_t i = 0; i < data.size(); i++)
     {
-        file << "[" << i << "] " << data[i] << std::endl;
+        file << "[" << i << "] " << data[i] << "\n";
     }
 
     file.close();
-    std::cout << theme->success << "Statistics saved to 'statistics_report.txt'" << theme->reset << std::endl;
+    std::cout << theme->success << "Statistics saved to 'statistics_report.txt'" << theme->reset << "\n";
 }
 
 // Theme switcher
 void changeTheme()
 {
-    std::cout << theme->accent << "\n┌─── Color Themes ───┐" << theme->reset << std::endl;
+    std::cout << theme->accent << "\n┌─── Color Themes ───┐" << theme->reset << "\n";
     std::cout << "1. Dark Theme (Default)\n";
     std::cout << "2. Light Theme\n";
     std::cout << "3. Monochrome Theme\n";
@@ -597,119 +1311,171 @@ void changeTheme()
     switch (choice)
     {
     case 1:
-        theme = &darkTheme;
-        currentTheme = DARK;
-        std::cout << theme->success << "Dark theme activated!" << theme->reset << std::endl;
+        setTheme(DARK);
+        std::cout << theme->success << "Dark theme activated!" << theme->reset << "\n";
         break;
     case 2:
-        theme = &lightTheme;
-        currentTheme = LIGHT;
-        std::cout << theme->success << "Light theme activated!" << theme->reset << std::endl;
+        setTheme(LIGHT);
+        std::cout << theme->success << "Light theme activated!" << theme->reset << "\n";
         break;
     case 3:
-        theme = &monochromeTheme;
-        currentTheme = MONOCHROME;
-        std::cout << theme->success << "Monochrome theme activated!" << theme->reset << std::endl;
+        setTheme(MONOCHROME);
+        std::cout << theme->success << "Monochrome theme activated!" << theme->reset << "\n";
         break;
     }
 }
 
-// Basic arithmetic operations
-double add(double num1, double num2) { return num1 + num2; }
-double subtract(double num1, double num2) { return num1 - num2; }
-double multiply(double num1, double num2) { return num1 * num2; }
-
-double divide(double num1, double num2)
+// Number format switcher
+void changeNumberFormat()
 {
-    while (num2 == 0)
+    std::cout << theme->accent << "\n┌─── Number Format ───┐" << theme->reset << "\n";
+    std::cout << "Current: " << formatted(M_PI, displayFormat) << "\n";
+    std::cout << "1. Fixed (Default)\n";
+    std::cout << "2. Scientific\n";
+    std::cout << "3. Shortest Exact (fewest digits that read back to the same value)\n";
+
+    int choice = getValidChoice(1, 3);
+    if (choice == 3)
     {
-        std::cout << theme->error << "Error: Division by zero is undefined!" << theme->reset << std::endl;
-        num2 = getValidNumber("Enter divisor again: ");
+        displayFormat.style = NumberStyle::SHORTEST;
     }
-    return num1 / num2;
-}
-
-double modulus(double num1, double num2)
-{
-    while (num2 == 0)
+    else
     {
-        std::cout << theme->error << "Error: Modulus by zero is undefined!" << theme->reset << std::endl;
-        num2 = getValidNumber("Enter divisor again: ");
+        displayFormat.style = choice == 1 ? NumberStyle::FIXED : NumberStyle::SCIENTIFIC;
+        std::cout << "Digits after the point (0-" << MAX_FORMAT_PRECISION << "):\n";
+        displayFormat.precision = getValidChoice(0, MAX_FORMAT_PRECISION);
     }
-    return std::fmod(num1, num2);
+    std::cout << theme->success << "Results now look like " << formatted(M_PI, displayFormat) << theme->reset << "\n";
 }
 
-double percentage()
-{
-    double num = getValidNumber("Enter number: ");
-    double percent = getValidNumber("Enter percentage: ");
-    return (num * percent) / 100.0;
-}
-
-// Trigonometric functions
-double sine() { return std::sin(getValidNumber("Enter angle in radians: ")); }
-double cosine() { return std::cos(getValidNumber("Enter angle in radians: ")); }
-double tangent() { return std::tan(getValidNumber("Enter angle in radians: ")); }
+// Menu front ends for the engine's scalar kernels: read the arguments, show
+// the kernel's domain_error and ask again until it accepts them
 
-// NEW: Reciprocal trigonometric functions
-double cosecant()
+// Re-reads the divisor until the kernel accepts it
+double retryDivisor(double (*kernel)(double, double), double num1, double num2)
 {
-    double angle = getValidNumber("Enter angle in radians: ");
-    double sinVal = std::sin(angle);
-    if (std::abs(sinVal) < 1e-10)
+    while (true)
     {
-        std::cout << theme->error << "Error: Cosecant undefined (sin = 0)" << theme->reset << std::endl;
-        return std::numeric_limits<double>::infinity();
+        try
+        {
+            return kernel(num1, num2);
+        }
+        catch (const std::domain_error &e)
+        {
+            std::cout << theme->error << "Error: " << e.what() << theme->reset << "\n";
+            num2 = getValidNumber("Enter divisor again: ");
+        }
     }
-    return 1.0 / sinVal;
 }
 
-double secant()
+// Reads the argument until the kernel accepts it
+double retryArgument(double (*kernel)(double), const std::string &prompt)
 {
-    double angle = getValidNumber("Enter angle in radians: ");
-    double cosVal = std::cos(angle);
-    if (std::abs(cosVal) < 1e-10)
+    while (true)
     {
-        std::cout << theme->error << "Error: Secant undefined (cos = 0)" << theme->reset << std::endl;
-        return std::numeric_limits<double>::infinity();
+        double value = getValidNumber(prompt);
+        try
+        {
+            return kernel(value);
+        }
+        catch (const std::domain_error &e)
+        {
+            std::cout << theme->error << "Error: " << e.what() << theme->reset << "\n";
+        }
     }
-    return 1.0 / cosVal;
 }
 
-double cotangent()
+// Reads the argument once; an undefined result is shown and returned as infinity
+double undefinedAsInfinity(double (*kernel)(double), const std::string &prompt)
 {
-    double angle = getValidNumber("Enter angle in radians: ");
-    double tanVal = std::tan(angle);
-    if (std::abs(tanVal) < 1e-10)
+    double value = getValidNumber(prompt);
+    try
+    {
+        return kernel(value);
+    }
+    catch (const std::domain_error &e)
     {
-        std::cout << theme->error << "Error: Cotangent undefined (tan = 0)" << theme->reset << std::endl;
+        std::cout << theme->error << "Error: " << e.what() << theme->reset << "\n";
         return std::numeric_limits<double>::infinity();
     }
-    return 1.0 / tanVal;
 }
 
-double arcsine()
+double percentage()
 {
-    double num = getValidNumber("Enter value [-1, 1]: ");
-    while (num < -1 || num > 1)
-    {
-        std::cout << theme->error << "Error: Input must be between -1 and 1!" << theme->reset << std::endl;
-        num = getValidNumber("Enter value [-1, 1]: ");
-    }
-    return std::asin(num);
+    double num = getValidNumber("Enter number: ");
+    double percent = getValidNumber("Enter percentage: ");
+    return percentage(num, percent);
 }
 
-double arccosine()
+// Chooses between libm and the lookup tables, and reports their error per size
+void lookupTableMenu()
 {
-    double num = getValidNumber("Enter value [-1, 1]: ");
-    while (num < -1 || num > 1)
+    std::cout << theme->accent << "\n┌─── Trig/Log Backend ───┐" << theme->reset << "\n";
+    if (lookupTables)
+        std::cout << "Current: lookup tables, " << lookupTables->entries() << " entries ("
+                  << lookupTables->bytes() / 1024.0 << " KiB), "
+                  << (lookupTables->interpolation() == LookupTables::LINEAR ? "linear" : "cubic") << "\n";
+    else
+        std::cout << "Current: libm (full precision)\n";
+    std::cout << "1. Use libm\n";
+    std::cout << "2. Use Lookup Tables\n";
+    std::cout << "3. Error Report by Table Size\n";
+    int choice = getValidChoice(1, 3);
+
+    if (choice == 1)
+    {
+        lookupTables.reset();
+        std::cout << theme->success << "Trig and log functions use libm" << theme->reset << "\n";
+    }
+    else if (choice == 2)
     {
-        std::cout << theme->error << "Error: Input must be between -1 and 1!" << theme->reset << std::endl;
-        num = getValidNumber("Enter value [-1, 1]: ");
+        std::cout << "Entries as a power of two (4-20; 2^11 fits a 32 KiB L1 cache):\n";
+        unsigned log2Entries = static_cast<unsigned>(getValidChoice(LookupTables::MIN_LOG2_ENTRIES, LookupTables::MAX_LOG2_ENTRIES));
+        std::cout << "1. Linear interpolation  2. Cubic interpolation\n";
+        LookupTables::Interpolation interpolation = getValidChoice(1, 2) == 1 ? LookupTables::LINEAR : LookupTables::CUBIC;
+        lookupTables.reset(new LookupTables(log2Entries, interpolation));
+        std::cout << theme->success << "Lookup tables active (" << lookupTables->bytes() / 1024.0 << " KiB)"
+                  << theme->reset << "\n";
+    }
+    else
+    {
+        std::cout << theme->primary << "\n Entries      KiB  Interp    sin abs err   log2 abs err   ns/call" << theme->reset << "\n";
+        std::ios_base::fmtflags flags = std::cout.flags();
+        std::streamsize precision = std::cout.precision();
+        double libmNs = nsPerSinLog2Call([](double a) { return std::sin(a); }, [](double a) { return std::log2(a); });
+        std::cout << "    libm        -  -                    0              0" << std::fixed << std::setprecision(2)
+                  << std::setw(10) << libmNs << "\n";
+        for (unsigned log2Entries = 6; log2Entries <= 16; log2Entries += 2)
+        {
+            for (int i = 0; i < 2; i++)
+            {
+                LookupTableReport r = measureLookupTables(log2Entries, i == 0 ? LookupTables::LINEAR : LookupTables::CUBIC);
+                std::cout << std::setw(8) << r.entries << std::fixed << std::setprecision(1) << std::setw(9)
+                          << r.bytes / 1024.0 << "  " << std::left << std::setw(8)
+                          << (i == 0 ? "linear" : "cubic") << std::right << std::scientific << std::setprecision(2)
+                          << std::setw(13) << r.sinError << std::setw(15) << r.logError << std::fixed
+                          << std::setprecision(2) << std::setw(10) << r.nsPerCall << "\n";
+            }
+        }
+        std::cout.flags(flags);
+        std::cout.precision(precision);
+        std::cout << "Tables up to ~32 KiB stay in L1, up to ~1 MiB in L2; tan error grows near its poles." << "\n";
     }
-    return std::acos(num);
 }
 
+// Trigonometric functions
+double sine() { return backendSin(getValidNumber("Enter angle in radians: ")); }
+double cosine() { return backendCos(getValidNumber("Enter angle in radians: ")); }
+double tangent() { return backendTan(getValidNumber("Enter angle in radians: ")); }
+
+// NEW: Reciprocal trigonometric functions
+double cosecant() { return undefinedAsInfinity(cosecant, "Enter angle in radians: "); }
+double secant() { return undefinedAsInfinity(secant, "Enter angle in radians: "); }
+double cotangent() { return undefinedAsInfinity(cotangent, "Enter angle in radians: "); }
+
+double arcsine() { return retryArgument(arcsine, "Enter value [-1, 1]: "); }
+double arccosine() { return retryArgument(arccosine, "Enter value [-1, 1]: "); }
+
 double arctangent() { return std::atan(getValidNumber("Enter value: ")); }
 double hyperbolicSine() { return std::sinh(getValidNumber("Enter value: ")); }
 double hyperbolicCosine() { return std::cosh(getValidNumber("Enter value: ")); }
@@ -725,80 +1491,119 @@ double power()
 
 double exponential() { return std::exp(getValidNumber("Enter value: ")); }
 
-double naturalLog()
+double naturalLog() { return retryArgument(naturalLog, "Enter positive number: "); }
+double log10Func() { return retryArgument(log10Func, "Enter positive number: "); }
+double log2Func() { return retryArgument(log2Func, "Enter positive number: "); }
+
+double logBase()
 {
     double num = getValidNumber("Enter positive number: ");
     while (num <= 0)
     {
-        std::cout << theme->error << "Error: Logarithm undefined for non-positive numbers!" << theme->reset << std::endl;
+        std::cout << theme->error << "Error: Logarithm undefined for non-positive numbers!" << theme->reset << "\n";
         num = getValidNumber("Enter positive number: ");
     }
-    return std::log(num);
-}
-
-double log10Func()
-{
-    double num = getValidNumber("Enter positive number: ");
-    while (num <= 0)
+    double base = getValidNumber("Enter positive base (≠ 1): ");
+    while (base <= 0 || base == 1)
     {
-        std::cout << theme->error << "Error: Logarithm undefined for non-positive numbers!" << theme->reset << std::endl;
-        num = getValidNumber("Enter positive number: ");
+        std::cout << theme->error << "Error: Base must be positive and not equal to 1!" << theme->reset << "\n";
+        base = getValidNumber("Enter positive base (≠ 1): ");
     }
-    return std::log10(num);
+    return logBase(num, base);
 }
 
-double log2Func()
+// Root functions
+double squareRoot() { return retryArgument(squareRoot, "Enter non-negative number: "); }
+
+double cubeRoot() { return std::cbrt(getValidNumber("Enter number: ")); }
+
+double nthRoot()
 {
-    double num = getValidNumber("Enter positive number: ");
-    while (num <= 0)
+    double num = getValidNumber("Enter number: ");
+    double n = getValidNumber("Enter root degree: ");
+    while (n == 0)
     {
-        std::cout << theme->error << "Error: Logarithm undefined for non-positive numbers!" << theme->reset << std::endl;
-        num = getValidNumber("Enter positive number: ");
+        std::cout << theme->error << "Error: Root degree cannot be zero!" << theme->reset << "\n";
+        n = getValidNumber("Enter root degree: ");
     }
-    return std::log2(num);
+    return nthRoot(num, n);
 }
 
-double logBase()
+// Applies one function to every number in a file and writes the results
+void bulkFunctions()
 {
-    double num = getValidNumber("Enter positive number: ");
-    while (num <= 0)
+    std::cout << theme->primary << "\n=== Bulk Functions (file) ===" << theme->reset << "\n";
+    std::cout << "1. sin    2. cos    3. tan    4. ln\n";
+    std::cout << "5. log10  6. log2   7. e^x    8. x^y\n";
+    int choice = getValidChoice(1, 8);
+
+    double exponent = 0.0;
+    if (choice == 8)
+        exponent = getValidNumber("Enter exponent y: ");
+
+    std::cout << "Accuracy: 1. Fast (vectorized)  2. Strict (libm)\n";
+    VectorMath::Accuracy accuracy = getValidChoice(1, 2) == 1 ? VectorMath::FAST : VectorMath::STRICT;
+
+    clearInput();
+    std::string filename, text;
+    std::cout << theme->warning << "Enter input file name: " << theme->reset;
+    std::getline(std::cin, filename);
+    if (!readFileContents(filename, text))
     {
-        std::cout << theme->error << "Error: Logarithm undefined for non-positive numbers!" << theme->reset << std::endl;
-        num = getValidNumber("Enter positive number: ");
+        std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
+        return;
     }
-    double base = getValidNumber("Enter positive base (≠ 1): ");
-    while (base <= 0 || base == 1)
+
+    std::vector<double> values = parseNumbers(text);
+    std::vector<double> results(values.size());
+    const VectorMath::Function functions[] = {VectorMath::SIN, VectorMath::COS, VectorMath::TAN, VectorMath::LN,
+                                              VectorMath::LOG10, VectorMath::LOG2, VectorMath::EXP};
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (choice == 8)
+        VectorMath::pow(values.data(), exponent, results.data(), values.size(), accuracy);
+    else
+        VectorMath::apply(functions[choice - 1], values.data(), results.data(), values.size(), accuracy);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::string out;
+    out.reserve(results.size() * 20);
+    for (double v : results)
     {
-        std::cout << theme->error << "Error: Base must be positive and not equal to 1!" << theme->reset << std::endl;
-        base = getValidNumber("Enter positive base (≠ 1): ");
+        appendNumber(out, v);
+        out += '\n';
     }
-    return std::log(num) / std::log(base);
+    std::ofstream file("function_result.txt", std::ios::binary);
+    file.write(out.data(), out.size());
+
+    std::cout << theme->success << "Evaluated " << values.size() << " values in " << seconds
+              << " s, saved to 'function_result.txt'" << theme->reset << "\n";
 }
 
-// Root functions
-double squareRoot()
+// Prints a big result in full, or abbreviated with an offer to save it
+void displayBigResult(const BigInt &value, const std::string &label)
 {
-    double num = getValidNumber("Enter non-negative number: ");
-    while (num < 0)
+    const size_t MAX_DIGITS_SHOWN = 1000;
+    std::string digits = value.toString();
+    std::cout << theme->success << "\n"
+              << label << " (" << value.digitCount() << " digits):" << theme->reset << "\n";
+    if (digits.size() <= MAX_DIGITS_SHOWN)
     {
-        std::cout << theme->error << "Error: Square root of negative number is complex!" << theme->reset << std::endl;
-        num = getValidNumber("Enter non-negative number: ");
+        std::cout << digits << "\n";
+        return;
     }
-    return std::sqrt(num);
-}
-
-double cubeRoot() { return std::cbrt(getValidNumber("Enter number: ")); }
 
-double nthRoot()
-{
-    double num = getValidNumber("Enter number: ");
-    double n = getValidNumber("Enter root degree: ");
-    while (n == 0)
+    std::cout << digits.substr(0, 50) << "..." << digits.substr(digits.size() - 50) << "\n";
+    std::cout << theme->warning << "Save full value to file? (y/n): " << theme->reset;
+    char save;
+    std::cin >> save;
+    if (save == 'y' || save == 'Y')
     {
-        std::cout << theme->error << "Error: Root degree cannot be zero!" << theme->reset << std::endl;
-        n = getValidNumber("Enter root degree: ");
+        std::ofstream file("big_result.txt", std::ios::binary);
+        file.write(digits.data(), digits.size());
+        file << '\n';
+        std::cout << theme->success << "Value saved to 'big_result.txt'" << theme->reset << "\n";
     }
-    return std::pow(num, 1.0 / n);
 }
 
 // Advanced functions
@@ -806,18 +1611,20 @@ double absoluteValue() { return std::abs(getValidNumber("Enter number: ")); }
 
 double factorial()
 {
-    int num;
+    const double MAX_FACTORIAL = 1000000;
+    double input;
     while (true)
     {
-        num = static_cast<int>(getValidNumber("Enter non-negative integer: "));
-        if (num >= 0 && num <= 20)
+        input = getValidNumber("Enter non-negative integer: ");
+        if (input >= 0 && input <= MAX_FACTORIAL)
             break;
-        std::cout << theme->error << "Error: Enter a value between 0 and 20!" << theme->reset << std::endl;
+        std::cout << theme->error << "Error: Enter a value between 0 and 1000000!" << theme->reset << "\n";
     }
-    double result = 1;
-    for (int i = 2; i <= num; i++)
-        result *= i;
-    return result;
+    uint64_t num = static_cast<uint64_t>(input);
+    BigInt result = bigFactorial(num);
+    if (num > 20)
+        displayBigResult(result, std::to_string(num) + "!");
+    return result.toDouble();
 }
 
 double ceiling() { return std::ceil(getValidNumber("Enter number: ")); }
@@ -837,74 +1644,32 @@ void statistics()
     int n;
     std::cout << "How many numbers? ";
     std::cin >> n;
-
-    std::vector<double> numbers(n);
-    double sum = 0, mean, variance = 0;
-
-    for (int i = 0; i < n; i++)
+    if (n < 1)
     {
-        numbers[i] = getValidNumber("Enter number " + std::to_string(i + 1) + ": ");
-        sum += numbers[i];
+        std::cout << theme->error << "Error: Enter at least one number!" << theme->reset << "\n";
+        return;
     }
 
-    mean = sum / n;
+    std::vector<double> numbers(n);
     for (int i = 0; i < n; i++)
-        variance += std::pow(numbers[i] - mean, 2);
-    variance /= n;
-
-    double minVal = *std::min_element(numbers.begin(), numbers.end());
-    double maxVal = *std::max_element(numbers.begin(), numbers.end());
-
-    std::vector<double> sorted = numbers;
-    std::sort(sorted.begin(), sorted.end());
-    double median = (n % 2 == 0) ? (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0 : sorted[n / 2];
-
-    // Calculate mode
-    std::map<double, int> frequency;
-    for (double num : numbers)
-        frequency[num]++;
-
-    int maxFreq = 0;
-    std::vector<double> modes;
-    for (const auto &pair : frequency)
-    {
-        if (pair.second > maxFreq)
-        {
-            maxFreq = pair.second;
-            modes.clear();
-            modes.push_back(pair.first);
-        }
-        else if (pair.second == maxFreq)
-        {
-            modes.push_back(pair.first);
-        }
-    }
-
-    std::cout << theme->success << "\n=== Statistics ===" << theme->reset << std::endl;
-    std::cout << "Count: " << n << std::endl;
-    std::cout << "Sum: " << sum << std::endl;
-    std::cout << "Mean: " << mean << std::endl;
-    std::cout << "Median: " << median << std::endl;
+        numbers[i] = getValidNumber(arenaText("Enter number ", i + 1, ": "));
+
+    StatisticsSummary s = computeStatistics(numbers, &commandArena);
+    std::cout << theme->success << "\n=== Statistics ===" << theme->reset << "\n";
+    std::cout << "Count: " << s.count << "\n";
+    std::cout << "Sum: " << formatted(s.sum, displayFormat) << "\n";
+    std::cout << "Mean: " << formatted(s.mean, displayFormat) << "\n";
+    std::cout << "Median: " << formatted(s.median, displayFormat) << "\n";
     std::cout << "Mode: ";
-    if (modes.size() == numbers.size())
-        std::cout << "No mode";
-    else
-    {
-        for (int i = 0; i < modes.size(); i++)
-        {
-            std::cout << modes[i];
-            if (i < modes.size() - 1)
-                std::cout << ", ";
-        }
-    }
-    std::cout << std::endl;
-    std::cout << "Minimum: " << minVal << std::endl;
-    std::cout << "Maximum: " << maxVal << std::endl;
-    std::cout << "Range: " << (maxVal - minVal) << std::endl;
-    std::cout << "Variance: " << variance << std::endl;
-    std::cout << "Standard Deviation: " << std::sqrt(variance) << std::endl;
+    printModes(std::cout, s, displayFormat);
+    std::cout << "\n";
+    std::cout << "Minimum: " << formatted(s.minimum, displayFormat) << "\n";
+    std::cout << "Maximum: " << formatted(s.maximum, displayFormat) << "\n";
+    std::cout << "Range: " << formatted(s.maximum - s.minimum, displayFormat) << "\n";
+    std::cout << "Variance: " << formatted(s.variance, displayFormat) << "\n";
+    std::cout << "Standard Deviation: " << formatted(std::sqrt(s.variance), displayFormat) << "\n";
 
-    addToHistory(mean, "mean");
+    addToHistory(s.mean, "mean");
 
     std::cout << theme->warning << "\nSave to file? (y/n): " << theme->reset;
     char save;
@@ -916,214 +1681,474 @@ void statistics()
 }
 
 // Permutation and Combination
-double permutation()
+// Reads 0 <= r <= n <= MAX_COMBINATORICS_N
+void getCombinatoricsArgs(uint64_t &n, uint64_t &r)
 {
-    int n = static_cast<int>(getValidNumber("Enter n: "));
-    int r = static_cast<int>(getValidNumber("Enter r: "));
+    const double MAX_COMBINATORICS_N = 1000000;
+    double nIn = getValidNumber("Enter n: ");
+    double rIn = getValidNumber("Enter r: ");
 
-    while (n < 0 || r < 0 || r > n || n > 20)
+    while (nIn < 0 || rIn < 0 || rIn > nIn || nIn > MAX_COMBINATORICS_N)
     {
-        std::cout << theme->error << "Error: Invalid values! (0 <= r <= n <= 20)" << theme->reset << std::endl;
-        n = static_cast<int>(getValidNumber("Enter n: "));
-        r = static_cast<int>(getValidNumber("Enter r: "));
+        std::cout << theme->error << "Error: Invalid values! (0 <= r <= n <= 1000000)" << theme->reset << "\n";
+        nIn = getValidNumber("Enter n: ");
+        rIn = getValidNumber("Enter r: ");
     }
+    n = static_cast<uint64_t>(nIn);
+    r = static_cast<uint64_t>(rIn);
+}
 
-    double result = 1;
-    for (int i = 0; i < r; i++)
-        result *= (n - i);
-    return result;
+double permutation()
+{
+    uint64_t n, r;
+    getCombinatoricsArgs(n, r);
+
+    BigInt result = bigPermutation(n, r);
+    if (!result.fitsUint64() || result.toUint64() > (1ULL << 53))
+        displayBigResult(result, "P(" + std::to_string(n) + ", " + std::to_string(r) + ")");
+    return result.toDouble();
 }
 
 double combination()
 {
-    int n = static_cast<int>(getValidNumber("Enter n: "));
-    int r = static_cast<int>(getValidNumber("Enter r: "));
-
-    while (n < 0 || r < 0 || r > n || n > 20)
-    {
-        std::cout << theme->error << "Error: Invalid values! (0 <= r <= n <= 20)" << theme->reset << std::endl;
-        n = static_cast<int>(getValidNumber("Enter n: "));
-        r = static_cast<int>(getValidNumber("Enter r: "));
-    }
+    uint64_t n, r;
+    getCombinatoricsArgs(n, r);
 
-    double numerator = 1, denominator = 1;
-    for (int i = 0; i < r; i++)
-    {
-        numerator *= (n - i);
-        denominator *= (i + 1);
-    }
-    return numerator / denominator;
+    BigInt result = bigBinomial(n, r);
+    if (!result.fitsUint64() || result.toUint64() > (1ULL << 53))
+        displayBigResult(result, "C(" + std::to_string(n) + ", " + std::to_string(r) + ")");
+    return result.toDouble();
 }
 
-// GCD and LCM
-int gcd(int a, int b)
+// Reads an integer of any length
+BigInt getValidBigInt(const std::string &prompt)
 {
-    a = std::abs(a);
-    b = std::abs(b);
-    while (b != 0)
+    std::string token;
+    while (true)
     {
-        int temp = b;
-        b = a % b;
-        a = temp;
+        std::cout << prompt;
+        if (std::cin >> token)
+        {
+            try
+            {
+                return BigInt::fromString(token);
+            }
+            catch (const std::invalid_argument &)
+            {
+            }
+        }
+        std::cout << theme->error << "Invalid input! Please enter an integer." << theme->reset << "\n";
+        clearInput();
     }
-    return a;
 }
 
 void gcdLcm()
 {
-    int a = static_cast<int>(getValidNumber("Enter first integer: "));
-    int b = static_cast<int>(getValidNumber("Enter second integer: "));
+    BigInt a = getValidBigInt("Enter first integer: ");
+    BigInt b = getValidBigInt("Enter second integer: ");
 
-    int gcdVal = gcd(a, b);
-    int lcmVal = std::abs(a * b) / gcdVal;
+    BigInt gcdVal = BigInt::gcd(a, b);
+    BigInt lcmVal = gcdVal.isZero() ? BigInt() : (a.abs() / gcdVal) * b.abs();
 
-    std::cout << theme->success << "\n=== Results ===" << theme->reset << std::endl;
-    std::cout << "GCD: " << gcdVal << std::endl;
-    std::cout << "LCM: " << lcmVal << std::endl;
+    std::cout << theme->success << "\n=== Results ===" << theme->reset << "\n";
+    std::cout << "GCD: " << gcdVal.toString() << "\n";
+    std::cout << "LCM: " << lcmVal.toString() << "\n";
 
-    addToHistory(gcdVal, "GCD");
-    addToHistory(lcmVal, "LCM");
+    addToHistory(gcdVal.toDouble(), "GCD");
+    addToHistory(lcmVal.toDouble(), "LCM");
 }
 
-// NEW: Prime number checker
-bool isPrime(int n)
+void primeChecker()
 {
-    if (n <= 1)
-        return false;
-    if (n <= 3)
-        return true;
-    if (n % 2 == 0 || n % 3 == 0)
-        return false;
+    uint64_t num = getValidUnsigned("Enter a positive integer: ");
 
-    for (int i = 5; i * i <= n; i += 6)
+    if (num == 0)
     {
-        if (n % i == 0 || n % (i + 2) == 0)
-            return false;
+        std::cout << theme->error << "Please enter a positive integer!" << theme->reset << "\n";
+        return;
+    }
+
+    std::cout << theme->success << "\n=== Prime Check ===" << theme->reset << "\n";
+    std::cout << "Number: " << num << "\n";
+
+    if (isPrime(num))
+    {
+        std::cout << theme->success << num << " is a PRIME number!" << theme->reset << "\n";
+    }
+    else
+    {
+        std::cout << theme->warning << num << " is NOT a prime number." << theme->reset << "\n";
+
+        std::vector<std::pair<uint64_t, int>> factors = primeFactorization(num);
+        if (!factors.empty())
+        {
+            std::cout << "Prime factorization: ";
+            for (size_t i = 0; i < factors.size(); i++)
+            {
+                std::cout << factors[i].first;
+                if (factors[i].second > 1)
+                    std::cout << "^" << factors[i].second;
+                if (i + 1 < factors.size())
+                    std::cout << " x ";
+            }
+            std::cout << "\n";
+        }
+
+        // Show factors
+        const size_t MAX_SHOWN = 200;
+        std::vector<uint64_t> divisors = divisorsFromFactors(factors);
+        std::cout << "Factors (" << divisors.size() << "): ";
+        for (size_t i = 0; i < divisors.size() && i < MAX_SHOWN; i++)
+            std::cout << divisors[i] << " ";
+        if (divisors.size() > MAX_SHOWN)
+            std::cout << "...";
+        std::cout << "\n";
     }
-    return true;
 }
 
-void primeChecker()
+// Tests every integer in a whitespace-separated file and writes "n 0|1" lines
+void primeBatchFromFile()
 {
-    int num = static_cast<int>(getValidNumber("Enter a positive integer: "));
+    clearInput();
+    std::string filename;
+    std::cout << theme->warning << "Enter input file name: " << theme->reset;
+    std::getline(std::cin, filename);
 
-    if (num <= 0)
+    std::string text;
+    if (!readFileContents(filename, text))
     {
-        std::cout << theme->error << "Please enter a positive integer!" << theme->reset << std::endl;
+        std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
         return;
     }
 
-    std::cout << theme->success << "\n=== Prime Check ===" << theme->reset << std::endl;
-    std::cout << "Number: " << num << std::endl;
+    std::vector<uint64_t> values;
+    const char *p = text.c_str();
+    while (*p)
+    {
+        char *end;
+        unsigned long long v = std::strtoull(p, &end, 10);
+        if (end == p)
+        {
+            p++;
+            continue;
+        }
+        values.push_back(v);
+        p = end;
+    }
+
+    std::vector<uint8_t> flags(values.size());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    isPrimeBatch(values.data(), values.size(), flags.data());
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t primeCount = 0;
+    std::string out;
+    out.reserve(values.size() * 22);
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        primeCount += flags[i];
+        out += std::to_string(values[i]);
+        out += flags[i] ? " 1\n" : " 0\n";
+    }
+    std::ofstream result("prime_batch_result.txt", std::ios::binary);
+    result.write(out.data(), out.size());
+
+    std::cout << theme->success << "\nTested " << values.size() << " numbers, " << primeCount
+              << " prime" << theme->reset << "\n";
+    std::cout << "Time: " << seconds << " s";
+    if (seconds > 0)
+        std::cout << " (" << static_cast<uint64_t>(values.size() / seconds) << " numbers/s)";
+    std::cout << "\n";
+    std::cout << theme->success << "Results saved to 'prime_batch_result.txt'" << theme->reset << "\n";
+}
 
-    if (isPrime(num))
+// NEW: Count or list primes in a range with the segmented sieve
+void primeSieve()
+{
+    std::cout << theme->accent << "\n┌─── Prime Sieve ───┐" << theme->reset << "\n";
+    std::cout << "1. Count primes in range\n";
+    std::cout << "2. List primes in range\n";
+    std::cout << "3. Batch primality test (file)\n";
+    int choice = getValidChoice(1, 3);
+
+    if (choice == 3)
     {
-        std::cout << theme->success << num << " is a PRIME number!" << theme->reset << std::endl;
+        primeBatchFromFile();
+        return;
     }
-    else
+
+    double lowInput = getValidNumber("Enter lower bound: ");
+    double highInput = getValidNumber("Enter upper bound: ");
+    if (lowInput < 0 || highInput < lowInput || highInput >= static_cast<double>(SIEVE_MAX_LIMIT))
     {
-        std::cout << theme->warning << num << " is NOT a prime number." << theme->reset << std::endl;
+        std::cout << theme->error << "Error: Need 0 <= lower <= upper < 2^62!" << theme->reset << "\n";
+        return;
+    }
+    uint64_t lo = static_cast<uint64_t>(lowInput);
+    uint64_t hi = static_cast<uint64_t>(highInput);
 
-        // Show factors
-        std::cout << "Factors: ";
-        for (int i = 1; i <= num; i++)
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (choice == 1)
+    {
+        uint64_t count = PrimeSieve::countPrimes(lo, hi);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << theme->success << "\nPrimes in [" << lo << ", " << hi << "]: " << count << theme->reset << "\n";
+        std::cout << "Time: " << seconds << " s" << "\n";
+        addToHistory(static_cast<double>(count), "prime count");
+        return;
+    }
+
+    const size_t MAX_SHOWN = 100;
+    std::vector<uint64_t> primes = PrimeSieve::primesInRange(lo, hi);
+    std::cout << theme->success << "\nFound " << primes.size() << " primes" << theme->reset << "\n";
+    for (size_t i = 0; i < primes.size() && i < MAX_SHOWN; i++)
+        std::cout << primes[i] << " ";
+    if (primes.size() > MAX_SHOWN)
+        std::cout << "...";
+    std::cout << "\n";
+
+    if (primes.size() > MAX_SHOWN)
+    {
+        std::cout << theme->warning << "\nSave full list to file? (y/n): " << theme->reset;
+        char save;
+        std::cin >> save;
+        if (save == 'y' || save == 'Y')
         {
-            if (num % i == 0)
-                std::cout << i << " ";
+            std::ofstream file("primes.txt");
+            std::string out;
+            for (size_t i = 0; i < primes.size(); i++)
+            {
+                out += std::to_string(primes[i]);
+                out += '\n';
+            }
+            file.write(out.data(), out.size());
+            std::cout << theme->success << "Primes saved to 'primes.txt'" << theme->reset << "\n";
         }
-        std::cout << std::endl;
     }
 }
 
 // Quadratic Equation Solver
-void quadraticSolver()
+void solveSingleQuadratic()
 {
-    std::cout << theme->primary << "\nSolving: ax² + bx + c = 0" << theme->reset << std::endl;
+    std::cout << theme->primary << "\nSolving: ax² + bx + c = 0" << theme->reset << "\n";
     double a = getValidNumber("Enter a: ");
     while (a == 0)
     {
-        std::cout << theme->error << "Coefficient 'a' cannot be zero!" << theme->reset << std::endl;
+        std::cout << theme->error << "Coefficient 'a' cannot be zero!" << theme->reset << "\n";
         a = getValidNumber("Enter a: ");
     }
     double b = getValidNumber("Enter b: ");
     double c = getValidNumber("Enter c: ");
 
     double discriminant = b * b - 4 * a * c;
+    double re1, im1, re2, im2;
+    PolynomialSolver::quadraticCore(a, b, c, re1, im1, re2, im2);
 
-    std::cout << theme->success << "\n=== Solution ===" << theme->reset << std::endl;
-    std::cout << "Discriminant: " << discriminant << std::endl;
+    std::cout << theme->success << "\n=== Solution ===" << theme->reset << "\n";
+    std::cout << "Discriminant: " << discriminant << "\n";
 
     if (discriminant > 0)
     {
-        double x1 = (-b + std::sqrt(discriminant)) / (2 * a);
-        double x2 = (-b - std::sqrt(discriminant)) / (2 * a);
-        std::cout << "Two real roots:" << std::endl;
-        std::cout << "x₁ = " << x1 << std::endl;
-        std::cout << "x₂ = " << x2 << std::endl;
-        addToHistory(x1, "root1");
-        addToHistory(x2, "root2");
+        std::cout << "Two real roots:" << "\n";
+        std::cout << "x₁ = " << re1 << "\n";
+        std::cout << "x₂ = " << re2 << "\n";
+        addToHistory(re1, "root1");
+        addToHistory(re2, "root2");
     }
     else if (discriminant == 0)
     {
-        double x = -b / (2 * a);
-        std::cout << "One real root:" << std::endl;
-        std::cout << "x = " << x << std::endl;
-        addToHistory(x, "root");
+        std::cout << "One real root:" << "\n";
+        std::cout << "x = " << re1 << "\n";
+        addToHistory(re1, "root");
     }
     else
     {
-        double realPart = -b / (2 * a);
-        double imagPart = std::sqrt(-discriminant) / (2 * a);
-        std::cout << "Two complex roots:" << std::endl;
-        std::cout << "x₁ = " << realPart << " + " << imagPart << "i" << std::endl;
-        std::cout << "x₂ = " << realPart << " - " << imagPart << "i" << std::endl;
+        std::cout << "Two complex roots:" << "\n";
+        std::cout << "x₁ = " << re1 << " + " << im1 << "i" << "\n";
+        std::cout << "x₂ = " << re2 << " - " << im1 << "i" << "\n";
     }
 }
 
-// Matrix Operations with file save
-void matrixAddition()
+void solveSinglePolynomial()
 {
-    int rows, cols;
-    std::cout << "Enter number of rows: ";
-    std::cin >> rows;
-    std::cout << "Enter number of columns: ";
-    std::cin >> cols;
+    int degree = static_cast<int>(getValidNumber("Enter degree (1-100): "));
+    if (degree < 1 || degree > 100)
+    {
+        std::cout << theme->error << "Error: Degree must be between 1 and 100!" << theme->reset << "\n";
+        return;
+    }
+    std::vector<double> coeffs(degree + 1);
+    for (int k = 0; k <= degree; k++)
+        coeffs[k] = getValidNumber(arenaText("Coefficient of x^", degree - k, ": "));
 
-    std::vector<std::vector<double>> matrix1(rows, std::vector<double>(cols));
-    std::vector<std::vector<double>> matrix2(rows, std::vector<double>(cols));
-    std::vector<std::vector<double>> result(rows, std::vector<double>(cols));
+    try
+    {
+        std::vector<std::complex<double>> roots = PolynomialSolver::roots(coeffs);
+        std::cout << theme->success << "\n=== Roots ===" << theme->reset << "\n";
+        for (size_t k = 0; k < roots.size(); k++)
+        {
+            std::cout << "x" << k + 1 << " = " << roots[k].real();
+            if (roots[k].imag() != 0.0)
+                std::cout << (roots[k].imag() < 0 ? " - " : " + ") << std::fabs(roots[k].imag()) << "i";
+            std::cout << "\n";
+        }
+        if (roots.size() < static_cast<size_t>(degree))
+            std::cout << theme->warning << "Leading coefficients were zero; degree reduced to " << roots.size()
+                      << theme->reset << "\n";
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << theme->error << "Error: " << e.what() << theme->reset << "\n";
+    }
+}
+
+void polynomialBatchFromFile()
+{
+    int degree = static_cast<int>(getValidNumber("Enter degree (1-100): "));
+    if (degree < 1 || degree > 100)
+    {
+        std::cout << theme->error << "Error: Degree must be between 1 and 100!" << theme->reset << "\n";
+        return;
+    }
+
+    clearInput();
+    std::string filename, text;
+    std::cout << theme->warning << "Enter file name (" << degree + 1 << " coefficients per equation, highest first): "
+              << theme->reset;
+    std::getline(std::cin, filename);
+    if (!readFileContents(filename, text))
+    {
+        std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
+        return;
+    }
+    std::vector<double> values = parseNumbers(text);
+    size_t width = static_cast<size_t>(degree) + 1;
+    if (values.empty() || values.size() % width != 0)
+    {
+        std::cout << theme->error << "Error: Expected a multiple of " << width << " numbers, found " << values.size()
+                  << theme->reset << "\n";
+        return;
+    }
+
+    PolynomialBatch batch(static_cast<unsigned>(degree), values.size() / width);
+    for (size_t i = 0; i < batch.count; i++)
+        for (size_t k = 0; k < width; k++)
+            batch.coeff[k][i] = values[i * width + k];
 
-    std::cout << "\nEnter elements of Matrix 1:" << std::endl;
-    for (int i = 0; i < rows; i++)
-        for (int j = 0; j < cols; j++)
-            matrix1[i][j] = getValidNumber("Element [" + std::to_string(i) + "][" + std::to_string(j) + "]: ");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    PolynomialSolver::solve(batch);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-    std::cout << "\nEnter elements of Matrix 2:" << std::endl;
-    for (int i = 0; i < rows; i++)
-        for (int j = 0; j < cols; j++)
-            matrix2[i][j] = getValidNumber("Element [" + std::to_string(i) + "][" + std::to_string(j) + "]: ");
+    // One line per equation: re im for each root
+    std::string out;
+    size_t degenerate = 0;
+    for (size_t i = 0; i < batch.count; i++)
+    {
+        if (std::isnan(batch.re[degree - 1][i]))
+            degenerate++;
+        for (int k = 0; k < degree; k++)
+        {
+            if (k)
+                out += ' ';
+            appendNumber(out, batch.re[k][i]);
+            out += ' ';
+            appendNumber(out, batch.im[k][i]);
+        }
+        out += '\n';
+    }
+    std::ofstream file("roots_result.txt", std::ios::binary);
+    file.write(out.data(), out.size());
 
-    for (int i = 0; i < rows; i++)
-        for (int j = 0; j < cols; j++)
-            result[i][j] = matrix1[i][j] + matrix2[i][j];
+    std::cout << theme->success << "\nSolved " << batch.count << " equations in " << seconds << " s" << theme->reset << "\n";
+    if (degenerate > 0)
+        std::cout << theme->warning << degenerate << " equations had zero leading coefficients (missing roots are nan)"
+                  << theme->reset << "\n";
+    std::cout << theme->success << "Roots saved to 'roots_result.txt'" << theme->reset << "\n";
+}
 
-    std::cout << theme->success << "\n=== Result Matrix ===" << theme->reset << std::endl;
-    for (int i = 0; i < rows; i++)
+void quadraticSolver()
+{
+    std::cout << theme->primary << "\n=== Polynomial Solver ===" << theme->reset << "\n";
+    std::cout << "1. Quadratic (ax² + bx + c)\n";
+    std::cout << "2. Polynomial of Any Degree\n";
+    std::cout << "3. Batch from File\n";
+    int choice = getValidChoice(1, 3);
+    if (choice == 1)
+        solveSingleQuadratic();
+    else if (choice == 2)
+        solveSinglePolynomial();
+    else
+        polynomialBatchFromFile();
+}
+
+// Matrix Operations with file save
+void readMatrixElements(Matrix &matrix, const std::string &title)
+{
+    std::cout << "\nEnter elements of " << title << ":" << "\n";
+    for (size_t i = 0; i < matrix.rows(); i++)
+        for (size_t j = 0; j < matrix.cols(); j++)
+            matrix(i, j) = getValidNumber(arenaText("Element [", i, "][", j, "]: "));
+}
+
+void printMatrix(const Matrix &matrix)
+{
+    for (size_t i = 0; i < matrix.rows(); i++)
     {
-        for (int j = 0; j < cols; j++)
-            std::cout << std::setw(10) << result[i][j] << " ";
-        std::cout << std::endl;
+        for (size_t j = 0; j < matrix.cols(); j++)
+            std::cout << std::setw(10) << matrix(i, j) << " ";
+        std::cout << "\n";
     }
+}
 
+void offerMatrixSave(const Matrix &matrix)
+{
     std::cout << theme->warning << "\nSave to file? (y/n): " << theme->reset;
     char save;
     std::cin >> save;
-    if (save == 'y' || save == 'Y')
+    if (save != 'y' && save != 'Y')
+        return;
+
+    std::cout << "1. Text (matrix_result.txt)\n";
+    std::cout << "2. Binary (matrix_result.cmat)\n";
+    if (getValidChoice(1, 2) == 1)
+    {
+        saveMatrixToFile(matrix, "matrix_result.txt");
+        return;
+    }
+
+    try
+    {
+        saveMatrixBinary(matrix, "matrix_result.cmat");
+        std::cout << theme->success << "Matrix saved to 'matrix_result.cmat'" << theme->reset << "\n";
+    }
+    catch (const std::exception &e)
     {
-        saveMatrixToFile(result, "matrix_result.txt");
+        std::cout << theme->error << "Error: " << e.what() << theme->reset << "\n";
     }
 }
 
+void matrixAddition()
+{
+    int rows, cols;
+    std::cout << "Enter number of rows: ";
+    std::cin >> rows;
+    std::cout << "Enter number of columns: ";
+    std::cin >> cols;
+
+    Matrix matrix1(rows, cols);
+    Matrix matrix2(rows, cols);
+
+    readMatrixElements(matrix1, "Matrix 1");
+    readMatrixElements(matrix2, "Matrix 2");
+
+    Matrix result = matrix1 + matrix2;
+
+    std::cout << theme->success << "\n=== Result Matrix ===" << theme->reset << "\n";
+    printMatrix(result);
+
+    offerMatrixSave(result);
+}
+
 void matrixMultiplication()
 {
     int r1, c1, r2, c2;
@@ -1138,44 +2163,22 @@ void matrixMultiplication()
 
     if (c1 != r2)
     {
-        std::cout << theme->error << "Error: Matrix 1 columns must equal Matrix 2 rows!" << theme->reset << std::endl;
+        std::cout << theme->error << "Error: Matrix 1 columns must equal Matrix 2 rows!" << theme->reset << "\n";
         return;
     }
-
-    std::vector<std::vector<double>> matrix1(r1, std::vector<double>(c1));
-    std::vector<std::vector<double>> matrix2(r2, std::vector<double>(c2));
-    std::vector<std::vector<double>> result(r1, std::vector<double>(c2, 0));
-
-    std::cout << "\nEnter elements of Matrix 1:" << std::endl;
-    for (int i = 0; i < r1; i++)
-        for (int j = 0; j < c1; j++)
-            matrix1[i][j] = getValidNumber("Element [" + std::to_string(i) + "][" + std::to_string(j) + "]: ");
-
-    std::cout << "\nEnter elements of Matrix 2:" << std::endl;
-    for (int i = 0; i < r2; i++)
-        for (int j = 0; j < c2; j++)
-            matrix2[i][j] = getValidNumber("Element [" + std::to_string(i) + "][" + std::to_string(j) + "]: ");
-
-    for (int i = 0; i < r1; i++)
-        for (int j = 0; j < c2; j++)
-            for (int k = 0; k < c1; k++)
-                result[i][j] += matrix1[i][k] * matrix2[k][j];
-
-    std::cout << theme->success << "\n=== Result Matrix ===" << theme->reset << std::endl;
-    for (int i = 0; i < r1; i++)
-    {
-        for (int j = 0; j < c2; j++)
-            std::cout << std::setw(10) << result[i][j] << " ";
-        std::cout << std::endl;
-    }
-
-    std::cout << theme->warning << "\nSave to file? (y/n): " << theme->reset;
-    char save;
-    std::cin >> save;
-    if (save == 'y' || save == 'Y')
-    {
-        saveMatrixToFile(result, "matrix_result.txt");
-    }
+
+    Matrix matrix1(r1, c1);
+    Matrix matrix2(r2, c2);
+
+    readMatrixElements(matrix1, "Matrix 1");
+    readMatrixElements(matrix2, "Matrix 2");
+
+    Matrix result = matrixProduct(matrix1, matrix2);
+
+    std::cout << theme->success << "\n=== Result Matrix ===" << theme->reset << "\n";
+    printMatrix(result);
+
+    offerMatrixSave(result);
 }
 
 // NEW: Matrix Transpose
@@ -1187,205 +2190,235 @@ void matrixTranspose()
     std::cout << "Enter number of columns: ";
     std::cin >> cols;
 
-    std::vector<std::vector<double>> matrix(rows, std::vector<double>(cols));
-    std::vector<std::vector<double>> transpose(cols, std::vector<double>(rows));
+    Matrix matrix(rows, cols);
+
+    readMatrixElements(matrix, "Matrix");
+
+    Matrix transpose = transposed(matrix);
+
+    std::cout << theme->success << "\n=== Original Matrix ===" << theme->reset << "\n";
+    printMatrix(matrix);
 
-    std::cout << "\nEnter elements of Matrix:" << std::endl;
-    for (int i = 0; i < rows; i++)
-        for (int j = 0; j < cols; j++)
-            matrix[i][j] = getValidNumber("Element [" + std::to_string(i) + "][" + std::to_string(j) + "]: ");
+    std::cout << theme->success << "\n=== Transposed Matrix ===" << theme->reset << "\n";
+    printMatrix(transpose);
+}
 
-    // Transpose
-    for (int i = 0; i < rows; i++)
-        for (int j = 0; j < cols; j++)
-            transpose[j][i] = matrix[i][j];
+// NEW: Load a matrix saved as text or binary (.cmat)
+void matrixLoad()
+{
+    clearInput();
+    std::string filename;
+    std::cout << theme->warning << "Enter matrix file name: " << theme->reset;
+    std::getline(std::cin, filename);
 
-    std::cout << theme->success << "\n=== Original Matrix ===" << theme->reset << std::endl;
-    for (int i = 0; i < rows; i++)
+    try
     {
-        for (int j = 0; j < cols; j++)
-            std::cout << std::setw(10) << matrix[i][j] << " ";
-        std::cout << std::endl;
+        Matrix matrix = loadMatrixFromFile(filename);
+        std::cout << theme->success << "\n=== Loaded Matrix (" << matrix.rows() << "x" << matrix.cols()
+                  << ") ===" << theme->reset << "\n";
+        if (matrix.rows() <= 20 && matrix.cols() <= 10)
+            printMatrix(matrix);
+        else
+            std::cout << "Matrix too large to display (" << matrix.size() << " elements)." << "\n";
     }
-
-    std::cout << theme->success << "\n=== Transposed Matrix ===" << theme->reset << std::endl;
-    for (int i = 0; i < cols; i++)
+    catch (const std::exception &e)
     {
-        for (int j = 0; j < rows; j++)
-            std::cout << std::setw(10) << transpose[i][j] << " ";
-        std::cout << std::endl;
+        std::cout << theme->error << "Error: " << e.what() << theme->reset << "\n";
     }
 }
 
 // Number System Conversions
+void numberSystemBatch()
+{
+    clearInput();
+    std::string filename;
+    std::cout << theme->warning << "Enter input file name (decimal integers): " << theme->reset;
+    std::getline(std::cin, filename);
+    int base = static_cast<int>(getValidNumber("Enter target base (2-36): "));
+    if (!RadixConverter::validBase(base))
+    {
+        std::cout << theme->error << "Error: Base must be between 2 and 36!" << theme->reset << "\n";
+        return;
+    }
+
+    std::string text;
+    if (!readFileContents(filename, text))
+    {
+        std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
+        return;
+    }
+
+    try
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<int64_t> values;
+        RadixConverter::parseBatch(text.data(), text.size(), 10, values);
+        std::string out;
+        RadixConverter::formatBatch(values.data(), values.size(), base, '\n', out);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::ofstream result("radix_result.txt", std::ios::binary);
+        result.write(out.data(), out.size());
+        std::cout << theme->success << "Converted " << values.size() << " values in " << seconds
+                  << " s, saved to 'radix_result.txt'" << theme->reset << "\n";
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << theme->error << "Error: " << e.what() << theme->reset << "\n";
+    }
+}
+
 void numberSystemConversion()
 {
-    std::cout << theme->accent << "\n┌─── Number System Conversion ───┐" << theme->reset << std::endl;
+    std::cout << theme->accent << "\n┌─── Number System Conversion ───┐" << theme->reset << "\n";
     std::cout << "1. Decimal to Binary\n";
     std::cout << "2. Decimal to Octal\n";
     std::cout << "3. Decimal to Hexadecimal\n";
     std::cout << "4. Binary to Decimal\n";
     std::cout << "5. Octal to Decimal\n";
     std::cout << "6. Hexadecimal to Decimal\n";
+    std::cout << "7. Any Base to Any Base (2-36)\n";
+    std::cout << "8. Batch Convert File\n";
 
-    int choice = getValidChoice(1, 6);
-    long long num;
-    std::string input;
+    int choice = getValidChoice(1, 8);
+    if (choice == 8)
+    {
+        numberSystemBatch();
+        return;
+    }
 
-    switch (choice)
+    static const int TARGET_BASES[] = {2, 8, 16};
+    static const char *const TARGET_NAMES[] = {"Binary", "Octal", "Hexadecimal"};
+    static const char *const SOURCE_NAMES[] = {"binary", "octal", "hexadecimal"};
+    static const char *const HISTORY_LABELS[] = {"binary->decimal", "octal->decimal", "hex->decimal"};
+
+    try
     {
-    case 1:
-        num = static_cast<long long>(getValidNumber("Enter decimal number: "));
-        std::cout << theme->success << "Binary: ";
-        if (num == 0)
-            std::cout << "0";
+        if (choice <= 3)
+        {
+            BigInt num = getValidBigInt("Enter decimal number: ");
+            std::cout << theme->success << TARGET_NAMES[choice - 1] << ": "
+                      << RadixConverter::toString(num, TARGET_BASES[choice - 1]) << theme->reset << "\n";
+        }
+        else if (choice <= 6)
+        {
+            std::string input;
+            std::cout << "Enter " << SOURCE_NAMES[choice - 4] << " number: ";
+            std::cin >> input;
+            BigInt num = RadixConverter::parseBig(input, TARGET_BASES[choice - 4]);
+            std::cout << theme->success << "Decimal: " << num.toString() << theme->reset << "\n";
+            addToHistory(num.toDouble(), HISTORY_LABELS[choice - 4]);
+        }
         else
         {
-            std::string binary = "";
-            long long temp = num;
-            while (temp > 0)
-            {
-                binary = (char)('0' + temp % 2) + binary;
-                temp /= 2;
-            }
-            std::cout << binary;
+            int from = static_cast<int>(getValidNumber("Enter source base (2-36): "));
+            int to = static_cast<int>(getValidNumber("Enter target base (2-36): "));
+            std::string input;
+            std::cout << "Enter number in base " << from << ": ";
+            std::cin >> input;
+            BigInt num = RadixConverter::parseBig(input, from);
+            std::cout << theme->success << "Base " << to << ": " << RadixConverter::toString(num, to)
+                      << theme->reset << "\n";
+            addToHistory(num.toDouble(), "base " + std::to_string(from) + "->" + std::to_string(to));
         }
-        std::cout << theme->reset << std::endl;
-        break;
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << theme->error << "Error: " << e.what() << theme->reset << "\n";
+    }
+}
 
-    case 2:
-        num = static_cast<long long>(getValidNumber("Enter decimal number: "));
-        std::cout << theme->success << "Octal: " << std::oct << num << std::dec << theme->reset << std::endl;
-        break;
+// Lists the units of one dimension and returns the chosen table index
+size_t chooseUnit(Dimension dimension, const std::string &prompt)
+{
+    std::vector<size_t> options;
+    std::cout << prompt << "\n";
+    for (size_t i = 0; i < UNIT_COUNT; i++)
+        if (UNIT_TABLE[i].dimension == dimension)
+        {
+            options.push_back(i);
+            std::cout << options.size() << ". " << UNIT_TABLE[i].name << " (" << UNIT_TABLE[i].symbol << ")\n";
+        }
+    return options[getValidChoice(1, static_cast<int>(options.size())) - 1];
+}
 
-    case 3:
-        num = static_cast<long long>(getValidNumber("Enter decimal number: "));
-        std::cout << theme->success << "Hexadecimal: " << std::hex << num << std::dec << theme->reset << std::endl;
-        break;
+void unitConversions()
+{
+    std::cout << theme->accent << "\n┌─── Unit Conversions ───┐" << theme->reset << "\n";
+    for (int d = 0; d < DIMENSION_COUNT; d++)
+        std::cout << d + 1 << ". " << DIMENSION_NAMES[d] << "\n";
+    std::cout << DIMENSION_COUNT + 1 << ". Batch Convert File\n";
 
-    case 4:
-        clearInput();
-        std::cout << "Enter binary number: ";
-        std::cin >> input;
-        num = std::stoll(input, nullptr, 2);
-        std::cout << theme->success << "Decimal: " << num << theme->reset << std::endl;
-        addToHistory(num, "binary->decimal");
-        break;
+    int choice = getValidChoice(1, DIMENSION_COUNT + 1);
+    bool batch = choice == DIMENSION_COUNT + 1;
+    if (batch)
+    {
+        for (int d = 0; d < DIMENSION_COUNT; d++)
+            std::cout << d + 1 << ". " << DIMENSION_NAMES[d] << "\n";
+        choice = getValidChoice(1, DIMENSION_COUNT);
+    }
+    Dimension dimension = static_cast<Dimension>(choice - 1);
 
-    case 5:
-        clearInput();
-        std::cout << "Enter octal number: ";
-        std::cin >> input;
-        num = std::stoll(input, nullptr, 8);
-        std::cout << theme->success << "Decimal: " << num << theme->reset << std::endl;
-        addToHistory(num, "octal->decimal");
-        break;
+    size_t from = chooseUnit(dimension, "\nConvert from:");
+    size_t to = chooseUnit(dimension, "\nConvert to:");
+    const UnitDef &a = UNIT_TABLE[from];
+    const UnitDef &b = UNIT_TABLE[to];
 
-    case 6:
-        clearInput();
-        std::cout << "Enter hexadecimal number: ";
-        std::cin >> input;
-        num = std::stoll(input, nullptr, 16);
-        std::cout << theme->success << "Decimal: " << num << theme->reset << std::endl;
-        addToHistory(num, "hex->decimal");
-        break;
+    if (!batch)
+    {
+        double value = getValidNumber("Enter value in " + std::string(a.name) + ": ");
+        double result = convertUnit(value, from, to);
+        std::cout << theme->success << formatted(value, displayFormat) << " " << a.symbol << " = " << formatted(result, displayFormat) << " " << b.symbol
+                  << theme->reset << "\n";
+        addToHistory(result, std::string(a.symbol) + "->" + b.symbol);
+        return;
     }
-}
 
-// Unit Conversions
-void unitConversions()
-{
-    std::cout << theme->accent << "\n┌─── Unit Conversions ───┐" << theme->reset << std::endl;
-    std::cout << "1. Celsius to Fahrenheit\n";
-    std::cout << "2. Fahrenheit to Celsius\n";
-    std::cout << "3. Celsius to Kelvin\n";
-    std::cout << "4. Kelvin to Celsius\n";
-    std::cout << "5. Meters to Feet\n";
-    std::cout << "6. Feet to Meters\n";
-    std::cout << "7. Kilometers to Miles\n";
-    std::cout << "8. Miles to Kilometers\n";
-    std::cout << "9. Kilograms to Pounds\n";
-    std::cout << "10. Pounds to Kilograms\n";
-
-    int choice = getValidChoice(1, 10);
-    double value, result;
+    clearInput();
+    std::string filename, text;
+    std::cout << theme->warning << "Enter input file name: " << theme->reset;
+    std::getline(std::cin, filename);
+    if (!readFileContents(filename, text))
+    {
+        std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
+        return;
+    }
 
-    switch (choice)
+    std::vector<double> values = parseNumbers(text);
+    std::vector<double> converted(values.size());
+    convertUnitArray(values.data(), converted.data(), values.size(), from, to);
+
+    std::string out;
+    out.reserve(converted.size() * 24);
+    for (size_t i = 0; i < converted.size(); i++)
     {
-    case 1:
-        value = getValidNumber("Enter temperature in Celsius: ");
-        result = (value * 9.0 / 5.0) + 32;
-        std::cout << theme->success << value << "°C = " << result << "°F" << theme->reset << std::endl;
-        addToHistory(result, "C->F");
-        break;
-    case 2:
-        value = getValidNumber("Enter temperature in Fahrenheit: ");
-        result = (value - 32) * 5.0 / 9.0;
-        std::cout << theme->success << value << "°F = " << result << "°C" << theme->reset << std::endl;
-        addToHistory(result, "F->C");
-        break;
-    case 3:
-        value = getValidNumber("Enter temperature in Celsius: ");
-        result = value + 273.15;
-        std::cout << theme->success << value << "°C = " << result << "K" << theme->reset << std::endl;
-        addToHistory(result, "C->K");
-        break;
-    case 4:
-        value = getValidNumber("Enter temperature in Kelvin: ");
-        result = value - 273.15;
-        std::cout << theme->success << value << "K = " << result << "°C" << theme->reset << std::endl;
-        addToHistory(result, "K->C");
-        break;
-    case 5:
-        value = getValidNumber("Enter length in meters: ");
-        result = value * 3.28084;
-        std::cout << theme->success << value << " m = " << result << " ft" << theme->reset << std::endl;
-        addToHistory(result, "m->ft");
-        break;
-    case 6:
-        value = getValidNumber("Enter length in feet: ");
-        result = value / 3.28084;
-        std::cout << theme->success << value << " ft = " << result << " m" << theme->reset << std::endl;
-        addToHistory(result, "ft->m");
-        break;
-    case 7:
-        value = getValidNumber("Enter distance in kilometers: ");
-        result = value * 0.621371;
-        std::cout << theme->success << value << " km = " << result << " mi" << theme->reset << std::endl;
-        addToHistory(result, "km->mi");
-        break;
-    case 8:
-        value = getValidNumber("Enter distance in miles: ");
-        result = value / 0.621371;
-        std::cout << theme->success << value << " mi = " << result << " km" << theme->reset << std::endl;
-        addToHistory(result, "mi->km");
-        break;
-    case 9:
-        value = getValidNumber("Enter weight in kilograms: ");
-        result = value * 2.20462;
-        std::cout << theme->success << value << " kg = " << result << " lbs" << theme->reset << std::endl;
-        addToHistory(result, "kg->lbs");
-        break;
-    case 10:
-        value = getValidNumber("Enter weight in pounds: ");
-        result = value / 2.20462;
-        std::cout << theme->success << value << " lbs = " << result << " kg" << theme->reset << std::endl;
-        addToHistory(result, "lbs->kg");
-        break;
+        appendNumber(out, converted[i]);
+        out += '\n';
     }
+    std::ofstream result("unit_result.txt", std::ios::binary);
+    result.write(out.data(), out.size());
+    std::cout << theme->success << "Converted " << values.size() << " values (" << a.symbol << " -> " << b.symbol
+              << "), saved to 'unit_result.txt'" << theme->reset << "\n";
 }
 
 // Memory operations menu
 void memoryMenu()
 {
-    std::cout << theme->accent << "\n┌─── Memory Operations ───┐" << theme->reset << std::endl;
+    std::cout << theme->accent << "\n┌─── Memory Operations ───┐" << theme->reset << "\n";
     std::cout << "1. Store (MS)\n";
     std::cout << "2. Recall (MR)\n";
     std::cout << "3. Clear (MC)\n";
     std::cout << "4. Add (M+)\n";
     std::cout << "5. Subtract (M-)\n";
+    std::cout << "6. Store in Register\n";
+    std::cout << "7. Add to Register (M+)\n";
+    std::cout << "8. Subtract from Register (M-)\n";
+    std::cout << "9. Clear Register\n";
+    std::cout << "10. Add File Column to Register (M+)\n";
+    std::cout << "11. Subtract File Column from Register (M-)\n";
+    std::cout << "12. List Registers\n";
 
-    int choice = getValidChoice(1, 5);
+    int choice = getValidChoice(1, 12);
 
     switch (choice)
     {
@@ -1413,68 +2446,620 @@ void memoryMenu()
         memorySubtract(val);
         break;
     }
+    case 6:
+    {
+        std::string name = getRegisterName();
+        registerStore(name, getValidNumber("Enter value to store: "));
+        break;
+    }
+    case 7:
+    {
+        std::string name = getRegisterName();
+        registerAdd(name, getValidNumber("Enter value to add: "));
+        break;
+    }
+    case 8:
+    {
+        std::string name = getRegisterName();
+        registerAdd(name, -getValidNumber("Enter value to subtract: "));
+        break;
+    }
+    case 9:
+        registerClear(getRegisterName());
+        break;
+    case 10:
+        accumulateFileColumn(1.0);
+        break;
+    case 11:
+        accumulateFileColumn(-1.0);
+        break;
+    case 12:
+        listRegisters();
+        break;
+    }
+}
+
+// Operation names for the instrumentation, indexed by menu choice
+const char *const MENU_OPERATIONS[] = {
+    "menu: exit", "menu: addition", "menu: subtraction", "menu: multiplication", "menu: division",
+    "menu: modulus", "menu: absolute value", "menu: percentage", "menu: sin", "menu: cos", "menu: tan",
+    "menu: cosec", "menu: sec", "menu: cot", "menu: arcsin", "menu: arccos", "menu: arctan", "menu: sinh",
+    "menu: cosh", "menu: tanh", "menu: power", "menu: e^x", "menu: ln", "menu: log10", "menu: log2",
+    "menu: log base", "menu: square root", "menu: cube root", "menu: nth root", "menu: factorial",
+    "menu: ceiling", "menu: floor", "menu: round", "menu: truncate", "menu: statistics",
+    "menu: deg/rad", "menu: number systems", "menu: units", "menu: permutation", "menu: combination",
+    "menu: gcd & lcm", "menu: prime check", "menu: polynomial solver", "menu: matrix add",
+    "menu: matrix multiply", "menu: matrix transpose", "menu: expression parser", "menu: complex numbers",
+    "menu: memory ops", "menu: view history", "menu: save history", "menu: use history value",
+    "menu: change theme", "menu: load matrix file", "menu: prime sieve", "menu: fft & spectrum",
+    "menu: bulk functions", "menu: trig/log backend", "menu: expression precision", "menu: gradient",
+    "menu: session stats", "menu: number format"};
+
+// Call counts, latencies and allocations per operation for this session
+void sessionStatsMenu()
+{
+    std::cout << theme->accent << "\n┌─── Session Stats ───┐" << theme->reset << "\n";
+#ifdef CALC_INSTRUMENT
+    std::cout << "1. Show Stats\n";
+    std::cout << "2. Save Stats to File\n";
+    std::cout << "3. Reset Stats\n";
+    int choice = getValidChoice(1, 3);
+
+    if (choice == 1)
+    {
+        std::vector<instrument::OperationStats> stats = instrument::collectStats();
+        if (stats.empty())
+        {
+            std::cout << theme->warning << "Nothing recorded yet." << theme->reset << "\n";
+            return;
+        }
+        std::ios_base::fmtflags flags = std::cout.flags();
+        std::streamsize precision = std::cout.precision();
+        std::cout << theme->primary << std::left << std::setw(36) << "Operation" << std::right << std::setw(8)
+                  << "Calls" << std::setw(12) << "Total ms" << std::setw(12) << "Mean µs" << std::setw(12)
+                  << "p50 µs" << std::setw(12) << "p99 µs" << std::setw(12) << "Bytes" << theme->reset << "\n";
+        std::cout << std::fixed << std::setprecision(1);
+        for (const instrument::OperationStats &s : stats)
+            std::cout << std::left << std::setw(36) << s.name << std::right << std::setw(8) << s.calls
+                      << std::setw(12) << s.totalNs / 1e6 << std::setw(11) << s.meanNs / 1e3 << std::setw(11)
+                      << s.p50Ns / 1e3 << std::setw(11) << s.p99Ns / 1e3 << std::setw(12) << s.bytes << "\n";
+        std::cout.flags(flags);
+        std::cout.precision(precision);
+        std::cout << "Menu rows include the time spent typing input; percentiles are accurate to a factor of √2."
+                  << "\n";
+    }
+    else if (choice == 2)
+    {
+        clearInput();
+        std::string filename;
+        std::cout << "Enter filename (e.g., calculator_stats.tsv): ";
+        std::getline(std::cin, filename);
+        if (instrument::dumpStats(filename))
+            std::cout << theme->success << "Stats saved to '" << filename << "'" << theme->reset << "\n";
+        else
+            std::cout << theme->error << "Error opening file!" << theme->reset << "\n";
+    }
+    else
+    {
+        instrument::resetStats();
+        std::cout << theme->success << "Stats cleared." << theme->reset << "\n";
     }
+#else
+    std::cout << theme->warning << "Instrumentation is not compiled in; rebuild with -DCALC_INSTRUMENT." << theme->reset
+              << "\n";
+#endif
 }
 
+// Screen rendering
+// The menu is composed into one buffer and written with a single call, each
+// theme color emitted once per run of lines instead of per line. On a
+// terminal tall enough to hold it, the menu is pinned to the top rows and
+// everything else scrolls underneath (a VT100 scroll region), so later
+// iterations rewrite only the lines that changed: usually none, all of them
+// after a theme change.
+struct ScreenLine
+{
+    std::string color;
+    std::string text;
+};
+
+class MenuScreen
+{
+public:
+    static const int MIN_SCROLL_ROWS = 12; // Rows left below a pinned menu for prompts and results
+
+    ~MenuScreen() { release(); }
+
+    void show(const std::vector<ScreenLine> &frame)
+    {
+        std::string out;
+        int rows = terminalRows();
+        int height = static_cast<int>(frame.size());
+        if (rows < height + MIN_SCROLL_ROWS)
+        {
+            if (pinnedRows)
+                unpin(out);
+            appendRegions(out, frame);
+        }
+        else if (rows != pinnedRows)
+        {
+            // First draw, or the terminal was resized: lay the screen out again
+            if (pinnedRows)
+                unpin(out);
+            out += "\033[2J\033[H";
+            appendRegions(out, frame);
+            out += "\033[" + std::to_string(height + 1) + ";" + std::to_string(rows) + "r";
+            out += "\033[" + std::to_string(height + 1) + ";1H";
+            drawn.clear();
+            for (const ScreenLine &line : frame)
+                drawn.push_back(line.color + line.text);
+            pinnedRows = rows;
+            pinScreen(this);
+        }
+        else
+        {
+            drawn.resize(frame.size());
+            for (size_t i = 0; i < frame.size(); i++)
+            {
+                std::string line = frame[i].color + frame[i].text;
+                if (line == drawn[i])
+                    continue;
+                // Save the cursor, rewrite the row, clear its old tail, restore the cursor
+                out += "\0337\033[" + std::to_string(i + 1) + ";1H" + line + theme->reset + "\033[K\0338";
+                drawn[i] = line;
+            }
+        }
+        std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+        std::cout.flush();
+    }
+
+    // Gives the whole terminal back to normal scrolling
+    void release()
+    {
+        if (!pinnedRows)
+            return;
+        std::string out;
+        unpin(out);
+        std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+        std::cout.flush();
+    }
+
+private:
+    static void appendRegions(std::string &out, const std::vector<ScreenLine> &frame)
+    {
+        const std::string *color = nullptr;
+        for (const ScreenLine &line : frame)
+        {
+            if (!color || line.color != *color)
+            {
+                if (color && !color->empty())
+                    out += theme->reset;
+                out += line.color;
+                color = &line.color;
+            }
+            out += line.text;
+            out += '\n';
+        }
+        if (color && !color->empty())
+            out += theme->reset;
+    }
+
+    // Drops the scroll region, which homes the cursor, and continues on the last row
+    void unpin(std::string &out)
+    {
+        out += "\033[r\033[" + std::to_string(pinnedRows) + ";1H\n";
+        pinnedRows = 0;
+        drawn.clear();
+        pinScreen(nullptr);
+    }
+
+    // Rows of the interactive terminal, or 0 when input or output is redirected
+    static int terminalRows()
+    {
+#ifndef _WIN32
+        const char *term = std::getenv("TERM");
+        winsize size;
+        if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || !term || std::strcmp(term, "dumb") == 0 ||
+            ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0)
+            return 0;
+        return size.ws_row;
+#else
+        return 0;
+#endif
+    }
+
+    // Ctrl+C must not leave the user's shell stuck inside the scroll region
+    static void pinScreen(MenuScreen *screen)
+    {
+#ifndef _WIN32
+        std::signal(SIGINT, screen ? restoreAndExit : SIG_DFL);
+        std::signal(SIGTERM, screen ? restoreAndExit : SIG_DFL);
+#else
+        (void)screen;
+#endif
+    }
+
+    static void restoreAndExit(int signal)
+    {
+#ifndef _WIN32
+        const char restore[] = "\033[r\033[999;1H\n";
+        ssize_t written = write(STDOUT_FILENO, restore, sizeof(restore) - 1);
+        (void)written;
+        _exit(128 + signal);
+#else
+        (void)signal;
+#endif
+    }
+
+    std::vector<std::string> drawn; // Pinned rows as last written, color included
+    int pinnedRows = 0;             // Terminal height the pinned layout is for; 0 when not pinned
+};
+
+MenuScreen menuScreen;
+
 // Display menu
-void displayMenu()
+std::vector<ScreenLine> menuFrame()
 {
-    std::cout << "\n"
-              << theme->bold << theme->primary;
-    std::cout << "╔════════════════════════════════════════════════════════════════╗\n";
-    std::cout << "║               ULTIMATE SCIENTIFIC CALCULATOR                   ║\n";
-    std::cout << "╚════════════════════════════════════════════════════════════════╝\n";
-    std::cout << theme->reset;
+    const std::string heading = theme->bold + theme->primary;
+    return {
+        {"", ""},
+        {heading, "╔════════════════════════════════════════════════════════════════╗"},
+        {heading, "║               ULTIMATE SCIENTIFIC CALCULATOR                   ║"},
+        {heading, "╚════════════════════════════════════════════════════════════════╝"},
+        {"", ""},
+        {theme->secondary, "┌─── Basic Operations ───┐"},
+        {"", " 1. Addition            2. Subtraction         3. Multiplication"},
+        {"", " 4. Division            5. Modulus             6. Absolute Value"},
+        {"", " 7. Percentage"},
+        {"", ""},
+        {theme->secondary, "┌─── Trigonometric ───┐"},
+        {"", " 8. sin()               9. cos()              10. tan()"},
+        {"", "11. cosec()            12. sec()              13. cot()"},
+        {"", "14. arcsin()           15. arccos()           16. arctan()"},
+        {"", "17. sinh()             18. cosh()             19. tanh()"},
+        {"", ""},
+        {theme->secondary, "┌─── Exponential & Log ───┐"},
+        {"", "20. Power (x^y)        21. e^x                22. ln(x)"},
+        {"", "23. log10(x)           24. log2(x)            25. logₐ(x)"},
+        {"", ""},
+        {theme->secondary, "┌─── Roots & Advanced ───┐"},
+        {"", "26. Square Root        27. Cube Root          28. nth Root"},
+        {"", "29. Factorial          30. Ceiling            31. Floor"},
+        {"", "32. Round              33. Truncate           34. Statistics"},
+        {"", ""},
+        {theme->secondary, "┌─── Conversions ───┐"},
+        {"", "35. Deg ↔ Rad          36. Number Systems     37. Units"},
+        {"", ""},
+        {theme->secondary, "┌─── Advanced Math ───┐"},
+        {"", "38. Permutation        39. Combination        40. GCD & LCM"},
+        {"", "41. Prime Check        42. Polynomial Solver  43. Matrix Add"},
+        {"", "44. Matrix Multiply    45. Matrix Transpose"},
+        {"", ""},
+        {theme->accent, "┌─── ADVANCED FEATURES ───┐"},
+        {"", "46. Expression Parser  47. Complex Numbers    48. Memory Ops"},
+        {"", "49. View History       50. Save History       51. Use History Value"},
+        {"", "52. Change Theme       53. Load Matrix File   54. Prime Sieve"},
+        {"", "55. FFT & Spectrum     56. Bulk Functions     57. Trig/Log Backend"},
+        {"", "58. Expression Precision 59. Gradient (Auto Diff)"},
+        {"", "60. Session Stats      61. Number Format"},
+        {"", ""},
+        {theme->error, " 0. Exit Calculator"},
+        {"", ""},
+    };
+}
 
-    std::cout << theme->secondary << "\n┌─── Basic Operations ───┐" << theme->reset << std::endl;
-    std::cout << " 1. Addition            2. Subtraction         3. Multiplication\n";
-    std::cout << " 4. Division            5. Modulus             6. Absolute Value\n";
-    std::cout << " 7. Percentage\n";
+void displayMenu()
+{
+    menuScreen.show(menuFrame());
+}
 
-    std::cout << theme->secondary << "\n┌─── Trigonometric ───┐" << theme->reset << std::endl;
-    std::cout << " 8. sin()               9. cos()              10. tan()\n";
-    std::cout << "11. cosec()            12. sec()              13. cot()\n";
-    std::cout << "14. arcsin()           15. arccos()           16. arctan()\n";
-    std::cout << "17. sinh()             18. cosh()             19. tanh()\n";
+// Session snapshot
+// History, memory and registers, theme, number format, precision settings
+// and the lookup tables are saved when the calculator exits and mapped back
+// in at startup, so a restarted session carries on without rebuilding its
+// tables. The file is native-endian: a 64-byte header, the doubles (history
+// values, then the sin and log2 tables), the label lengths and label text,
+// then the registers. It is replaced atomically, so a crash while saving
+// keeps the previous snapshot. Version 1, from before registers, still loads.
+const char SESSION_FILE_MAGIC[8] = {'C', 'A', 'L', 'C', 'S', 'E', 'S', '\0'};
+const uint32_t SESSION_FILE_VERSION = 2;
+
+struct SessionFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endianTag; // MATRIX_ENDIAN_TAG, written in native order
+    double memory;
+    uint32_t historyCount;
+    uint32_t labelBytes;
+    uint32_t tableLog2Entries; // 0 when no lookup tables were active
+    uint32_t bigFloatPrecision;
+    int32_t numberPrecision;
+    uint8_t numberStyle;
+    uint8_t theme;
+    uint8_t expressionPrecision;
+    uint8_t tableInterpolation;
+    // Each register: u32 name length, u32 kind (0 scalar, 1 vector), u64
+    // element count, the name, then the sums and the error terms
+    uint32_t registerCount;
+    uint32_t reserved;
+    uint64_t registerBytes;
+};
+static_assert(sizeof(SessionFileHeader) == 64, "session header must fill one 64-byte block");
 
-    std::cout << theme->secondary << "\n┌─── Exponential & Log ───┐" << theme->reset << std::endl;
-    std::cout << "20. Power (x^y)        21. e^x                22. ln(x)\n";
-    std::cout << "23. log10(x)           24. log2(x)            25. logₐ(x)\n";
+// The snapshot lives in the per-user state directory, never the working
+// directory; CALC_SESSION_FILE=path moves it and an empty path turns it off
+std::string sessionFileName()
+{
+    if (const char *path = std::getenv("CALC_SESSION_FILE"))
+        return path;
+#ifdef _WIN32
+    const char *localAppData = std::getenv("LOCALAPPDATA");
+    return localAppData && *localAppData ? std::string(localAppData) + "\\calculator\\session.bin" : std::string();
+#else
+    const char *stateHome = std::getenv("XDG_STATE_HOME");
+    if (stateHome && *stateHome)
+        return std::string(stateHome) + "/calculator/session.bin";
+    const char *home = std::getenv("HOME");
+    return home && *home ? std::string(home) + "/.local/state/calculator/session.bin" : std::string();
+#endif
+}
 
-    std::cout << theme->secondary << "\n┌─── Roots & Advanced ───┐" << theme->reset << std::endl;
-    std::cout << "26. Square Root        27. Cube Root          28. nth Root\n";
-    std::cout << "29. Factorial          30. Ceiling            31. Floor\n";
-    std::cout << "32. Round              33. Truncate           34. Statistics\n";
+template <typename T>
+std::string_view bytesOf(const T *values, size_t count)
+{
+    return std::string_view(reinterpret_cast<const char *>(values), count * sizeof(T));
+}
 
-    std::cout << theme->secondary << "\n┌─── Conversions ───┐" << theme->reset << std::endl;
-    std::cout << "35. Deg ↔ Rad          36. Number Systems     37. Units\n";
+void appendRegister(std::string &out, const std::string &name, uint32_t kind, const double *sums,
+                    const double *errors, uint64_t count)
+{
+    uint32_t nameLength = static_cast<uint32_t>(name.size());
+    out.append(bytesOf(&nameLength, 1));
+    out.append(bytesOf(&kind, 1));
+    out.append(bytesOf(&count, 1));
+    out += name;
+    out.append(bytesOf(sums, count));
+    out.append(bytesOf(errors, count));
+}
 
-    std::cout << theme->secondary << "\n┌─── Advanced Math ───┐" << theme->reset << std::endl;
-    std::cout << "38. Permutation        39. Combination        40. GCD & LCM\n";
-    std::cout << "41. Prime Check        42. Quadratic Solver   43. Matrix Add\n";
-    std::cout << "44. Matrix Multiply    45. Matrix Transpose\n";
+void saveSession(const std::string &filename)
+{
+    std::filesystem::path directory = std::filesystem::path(filename).parent_path();
+    if (!directory.empty())
+        std::filesystem::create_directories(directory);
+    std::vector<uint32_t> labelLengths;
+    std::string labels;
+    for (const std::string &label : historyLabels)
+    {
+        labelLengths.push_back(static_cast<uint32_t>(label.size()));
+        labels += label;
+    }
+    std::string registers;
+    for (const auto &entry : scalarRegisters)
+        appendRegister(registers, entry.first, 0, &entry.second.sum, &entry.second.error, 1);
+    for (const auto &entry : vectorRegisters)
+        appendRegister(registers, entry.first, 1, entry.second.sums.data(), entry.second.errors.data(),
+                       entry.second.sums.size());
+
+    SessionFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SESSION_FILE_MAGIC, sizeof(header.magic));
+    header.version = SESSION_FILE_VERSION;
+    header.endianTag = MATRIX_ENDIAN_TAG;
+    header.memory = memory;
+    header.historyCount = static_cast<uint32_t>(history.size());
+    header.labelBytes = static_cast<uint32_t>(labels.size());
+    header.bigFloatPrecision = BigFloat::defaultPrecision;
+    header.numberPrecision = displayFormat.precision;
+    header.numberStyle = static_cast<uint8_t>(displayFormat.style);
+    header.theme = static_cast<uint8_t>(currentTheme);
+    header.expressionPrecision = static_cast<uint8_t>(expressionPrecision);
+    header.registerCount = static_cast<uint32_t>(scalarRegisters.size() + vectorRegisters.size());
+    header.registerBytes = registers.size();
+    if (lookupTables)
+    {
+        header.tableLog2Entries = lookupTables->log2Entries();
+        header.tableInterpolation = static_cast<uint8_t>(lookupTables->interpolation());
+    }
+
+    std::vector<std::string_view> parts = {bytesOf(&header, 1), bytesOf(history.data(), history.size())};
+    if (lookupTables)
+    {
+        parts.push_back(bytesOf(lookupTables->sinValues(), lookupTables->tableSize()));
+        parts.push_back(bytesOf(lookupTables->log2Values(), lookupTables->tableSize()));
+    }
+    parts.push_back(bytesOf(labelLengths.data(), labelLengths.size()));
+    parts.push_back(labels);
+    parts.push_back(registers);
+    writeFileAtomically(filename, parts);
+}
 
-    std::cout << theme->accent << "\n┌─── ADVANCED FEATURES ───┐" << theme->reset << std::endl;
-    std::cout << "46. Expression Parser  47. Complex Numbers    48. Memory Ops\n";
-    std::cout << "49. View History       50. Save History       51. Use History Value\n";
-    std::cout << "52. Change Theme\n";
+// Everything is checked before any setting changes, so a damaged file leaves
+// the fresh session as it was; returns the number of history entries restored
+size_t restoreSession(const std::string &filename)
+{
+    MappedFile file(filename);
+    SessionFileHeader header;
+    if (file.size() < sizeof(header))
+        throw std::runtime_error("Not a session file");
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, SESSION_FILE_MAGIC, sizeof(header.magic)) != 0)
+        throw std::runtime_error("Not a session file");
+    if (header.version < 1 || header.version > SESSION_FILE_VERSION)
+        throw std::runtime_error("Unsupported session file version");
+    if (header.endianTag != MATRIX_ENDIAN_TAG)
+        throw std::runtime_error("Session file was written with a different byte order");
+
+    bool tables = header.tableLog2Entries != 0;
+    uint64_t tableSize = tables ? (uint64_t(1) << std::min(header.tableLog2Entries, 32u)) + 3 : 0;
+    if (header.historyCount > static_cast<uint32_t>(MAX_HISTORY) || header.theme > MONOCHROME ||
+        header.numberStyle > static_cast<uint8_t>(NumberStyle::SCIENTIFIC) ||
+        header.numberPrecision < 0 || header.numberPrecision > MAX_FORMAT_PRECISION ||
+        header.expressionPrecision > PRECISION_INTERVAL || header.tableInterpolation > LookupTables::CUBIC ||
+        header.bigFloatPrecision < BigFloat::MIN_PRECISION || header.bigFloatPrecision > BigFloat::MAX_PRECISION ||
+        (tables && (header.tableLog2Entries < LookupTables::MIN_LOG2_ENTRIES ||
+                    header.tableLog2Entries > LookupTables::MAX_LOG2_ENTRIES)))
+        throw std::runtime_error("Session file is damaged");
+    uint64_t count = header.historyCount;
+    uint64_t expectedSize = sizeof(header) + (count + 2 * tableSize) * sizeof(double) + count * sizeof(uint32_t) +
+                            header.labelBytes;
+    if (header.registerBytes > file.size() || file.size() - header.registerBytes != expectedSize)
+        throw std::runtime_error("Session file is damaged");
+
+    // The doubles start at offset 64 of a mapping, so they are aligned
+    const double *values = reinterpret_cast<const double *>(file.data() + sizeof(header));
+    const char *lengths = file.data() + sizeof(header) + (count + 2 * tableSize) * sizeof(double);
+    const char *text = lengths + count * sizeof(uint32_t);
+    std::vector<std::string> labels(count);
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t length;
+        std::memcpy(&length, lengths + i * sizeof(uint32_t), sizeof(length));
+        if (length > header.labelBytes - used)
+            throw std::runtime_error("Session file is damaged");
+        labels[i].assign(text + used, length);
+        used += length;
+    }
+
+    std::map<std::string, CompensatedSum> scalars;
+    std::map<std::string, VectorRegister> vectors;
+    const char *record = text + header.labelBytes;
+    uint64_t left = header.registerBytes;
+    auto take = [&](void *out, uint64_t bytes)
+    {
+        if (bytes > left)
+            throw std::runtime_error("Session file is damaged");
+        std::memcpy(out, record, bytes);
+        record += bytes;
+        left -= bytes;
+    };
+    for (uint32_t r = 0; r < header.registerCount; r++)
+    {
+        uint32_t nameLength, kind;
+        uint64_t elements;
+        take(&nameLength, sizeof(nameLength));
+        take(&kind, sizeof(kind));
+        take(&elements, sizeof(elements));
+        if (kind > 1 || (kind == 0 && elements != 1) || nameLength > left || elements > left / (2 * sizeof(double)))
+            throw std::runtime_error("Session file is damaged");
+        std::string name(nameLength, '\0');
+        take(&name[0], nameLength);
+        if (kind == 0)
+        {
+            CompensatedSum &total = scalars[name];
+            take(&total.sum, sizeof(double));
+            take(&total.error, sizeof(double));
+        }
+        else
+        {
+            VectorRegister &vector = vectors[name];
+            vector.sums.resize(elements);
+            vector.errors.resize(elements);
+            take(vector.sums.data(), elements * sizeof(double));
+            take(vector.errors.data(), elements * sizeof(double));
+        }
+    }
+    if (left != 0)
+        throw std::runtime_error("Session file is damaged");
+
+    std::unique_ptr<const LookupTables> restoredTables;
+    if (tables)
+        restoredTables.reset(new LookupTables(header.tableLog2Entries,
+                                              static_cast<LookupTables::Interpolation>(header.tableInterpolation),
+                                              values + count, values + count + tableSize));
+
+    history.assign(values, values + count);
+    historyLabels = std::move(labels);
+    memory = header.memory;
+    scalarRegisters = std::move(scalars);
+    vectorRegisters = std::move(vectors);
+    setTheme(static_cast<ColorTheme>(header.theme));
+    displayFormat = {static_cast<NumberStyle>(header.numberStyle), header.numberPrecision};
+    expressionPrecision = static_cast<ExpressionPrecision>(header.expressionPrecision);
+    BigFloat::defaultPrecision = header.bigFloatPrecision;
+    lookupTables = std::move(restoredTables);
+    return count;
+}
 
-    std::cout << theme->error << "\n 0. Exit Calculator\n"
-              << theme->reset << std::endl;
+// Command-line server mode; returns the process exit status
+int serverFromArguments(int argc, char *argv[])
+{
+    const char *usage = "Usage: calculator [--serve SOCKET_PATH | --serve-tcp PORT] [--threads N] [--cache N]\n";
+    ServerOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << usage;
+            return 2;
+        }
+        std::string value = argv[++i];
+        char *end;
+        unsigned long number = std::strtoul(value.c_str(), &end, 10);
+        bool isNumber = !value.empty() && *end == '\0' && number <= 65535;
+        if (arg == "--serve")
+            options.socketPath = value;
+        else if (arg == "--serve-tcp" && isNumber)
+            options.tcpPort = static_cast<int>(number);
+        else if (arg == "--threads" && isNumber)
+            options.threads = static_cast<unsigned>(number);
+        else if (arg == "--cache" && !value.empty() && *end == '\0')
+            options.cacheCapacity = number;
+        else
+        {
+            std::cerr << usage;
+            return 2;
+        }
+    }
+    if (options.socketPath.empty() == !options.tcpPort)
+    {
+        std::cerr << usage;
+        return 2;
+    }
+    int status = runServer(options);
+#ifdef CALC_INSTRUMENT
+    if (const char *statsFile = std::getenv("CALC_STATS_FILE"))
+        instrument::dumpStats(statsFile);
+#endif
+    return status;
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+    if (argc > 1)
+        return serverFromArguments(argc, argv);
+
     double a, b, result;
     int choice;
     char continueCalc;
 
+    // Buffer cout ourselves instead of going through stdio line by line; cout
+    // is tied to cin, so prompts still appear before every read
+    std::ios::sync_with_stdio(false);
     std::cout << std::fixed << std::setprecision(6);
 
+    std::string session = sessionFileName();
+    if (!session.empty() && std::ifstream(session).good())
+    {
+        try
+        {
+            size_t restored = restoreSession(session);
+            std::cout << theme->success << "Session restored (" << restored << " history entries)" << theme->reset
+                      << "\n";
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << theme->warning << "Starting a new session: " << e.what() << theme->reset << "\n";
+        }
+    }
+
     do
     {
         displayMenu();
-        choice = getValidChoice(0, 52);
+        choice = getValidChoice(0, 61);
 
         if (choice == 0)
         {
@@ -1486,6 +3071,11 @@ int main()
         }
 
         bool validOperation = true;
+        commandArena.reset();
+#ifdef CALC_INSTRUMENT
+        std::optional<instrument::Scope> menuScope;
+        menuScope.emplace(instrument::operationId(MENU_OPERATIONS[choice]));
+#endif
 
         switch (choice)
         {
@@ -1507,12 +3097,12 @@ int main()
         case 4:
             a = getValidNumber("Enter dividend: ");
             b = getValidNumber("Enter divisor: ");
-            result = divide(a, b);
+            result = retryDivisor(divide, a, b);
             break;
         case 5:
             a = getValidNumber("Enter first number: ");
             b = getValidNumber("Enter second number: ");
-            result = modulus(a, b);
+            result = retryDivisor(modulus, a, b);
             break;
         case 6:
             result = absoluteValue();
@@ -1674,15 +3264,54 @@ int main()
             changeTheme();
             validOperation = false;
             break;
+        case 53:
+            matrixLoad();
+            validOperation = false;
+            break;
+        case 54:
+            primeSieve();
+            validOperation = false;
+            break;
+        case 55:
+            fftSpectrum();
+            validOperation = false;
+            break;
+        case 56:
+            bulkFunctions();
+            validOperation = false;
+            break;
+        case 57:
+            lookupTableMenu();
+            validOperation = false;
+            break;
+        case 58:
+            precisionModeMenu();
+            validOperation = false;
+            break;
+        case 59:
+            gradientCalculator();
+            validOperation = false;
+            break;
+        case 60:
+            sessionStatsMenu();
+            validOperation = false;
+            break;
+        case 61:
+            changeNumberFormat();
+            validOperation = false;
+            break;
         default:
             validOperation = false;
             break;
         }
+#ifdef CALC_INSTRUMENT
+        menuScope.reset();
+#endif
 
         if (validOperation)
         {
             std::cout << theme->success << "\n┌─────────────────────┐\n";
-            std::cout << "│ Result: " << theme->bold << result << theme->reset << theme->success << "\n";
+            std::cout << "│ Result: " << theme->bold << formatted(result, displayFormat) << theme->reset << theme->success << "\n";
             std::cout << "└─────────────────────┘\n"
                       << theme->reset;
             addToHistory(result);
@@ -1693,6 +3322,25 @@ int main()
         clearInput();
 
     } while (continueCalc == 'y' || continueCalc == 'Y');
+    menuScreen.release();
+
+    if (!session.empty())
+    {
+        try
+        {
+            saveSession(session);
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << theme->error << "Error: Session not saved: " << e.what() << theme->reset << "\n";
+        }
+    }
+
+#ifdef CALC_INSTRUMENT
+    // CALC_STATS_FILE=path keeps a record of where a whole session spent its time
+    if (const char *statsFile = std::getenv("CALC_STATS_FILE"))
+        instrument::dumpStats(statsFile);
+#endif
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,3729 @@
+// Calculator engine: out-of-line kernels declared in CalculatorEngine.h
+#include "CalculatorEngine.h"
+
+bool readFileContents(const std::string &filename, std::string &text)
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return false;
+    text.assign(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(&text[0], text.size());
+    return true;
+}
+
+std::vector<double> parseNumbers(const std::string &text)
+{
+    std::vector<double> values;
+    const char *p = text.c_str();
+    while (*p)
+    {
+        char *end;
+        double v = std::strtod(p, &end);
+        if (end == p)
+        {
+            p++;
+            continue;
+        }
+        values.push_back(v);
+        p = end;
+    }
+    return values;
+}
+
+void writeFileAtomically(const std::string &filename, const std::vector<std::string_view> &parts)
+{
+    std::string temporary = filename + ".tmp";
+#ifndef _WIN32
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open '" + filename + "' for writing");
+    bool ok = true;
+    for (std::string_view part : parts)
+    {
+        while (ok && !part.empty())
+        {
+            ssize_t written = ::write(fd, part.data(), part.size());
+            if (written < 0 && errno == EINTR)
+                continue;
+            ok = written > 0;
+            if (ok)
+                part.remove_prefix(static_cast<size_t>(written));
+        }
+    }
+    // The data must be on disk before the rename can make it visible
+    ok = ok && ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || ::rename(temporary.c_str(), filename.c_str()) != 0)
+    {
+        ::unlink(temporary.c_str());
+        throw std::runtime_error("Error writing '" + filename + "'");
+    }
+#else
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        for (std::string_view part : parts)
+            file.write(part.data(), static_cast<std::streamsize>(part.size()));
+        if (!file.is_open() || !file.flush())
+        {
+            file.close();
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Error writing '" + filename + "'");
+        }
+    }
+    // rename does not replace an existing file here
+    std::remove(filename.c_str());
+    if (std::rename(temporary.c_str(), filename.c_str()) != 0)
+        throw std::runtime_error("Error writing '" + filename + "'");
+#endif
+}
+
+MappedFile::MappedFile(const std::string &filename)
+{
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open '" + filename + "'");
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("Cannot read '" + filename + "'");
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0)
+    {
+        void *mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error("Cannot map '" + filename + "'");
+        }
+        data_ = static_cast<const char *>(mapped);
+    }
+    ::close(fd);
+#else
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        throw std::runtime_error("Cannot open '" + filename + "'");
+    size_ = static_cast<size_t>(file.tellg());
+    buffer_.resize((size_ + sizeof(double) - 1) / sizeof(double));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(buffer_.data()), size_);
+    data_ = reinterpret_cast<const char *>(buffer_.data());
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if (data_)
+        ::munmap(const_cast<char *>(data_), size_);
+#endif
+}
+
+Arena::~Arena()
+{
+    for (const Block &block : blocks)
+        ::operator delete(block.begin);
+}
+
+void Arena::reset()
+{
+    // The latest blocks are the largest, so they go first
+    while (heldBytes > RETAINED_BYTES)
+    {
+        heldBytes -= blocks.back().size;
+        ::operator delete(blocks.back().begin);
+        blocks.pop_back();
+    }
+    current = 0;
+    next = blocks.empty() ? nullptr : blocks[0].begin;
+    end = blocks.empty() ? nullptr : blocks[0].begin + blocks[0].size;
+}
+
+void *Arena::allocateFromNextBlock(size_t bytes, size_t alignment)
+{
+    size_t needed = bytes + alignment;
+    // Blocks kept from before the last reset are used again in order
+    while (current + 1 < blocks.size())
+    {
+        current++;
+        if (blocks[current].size >= needed)
+        {
+            next = blocks[current].begin;
+            end = next + blocks[current].size;
+            return do_allocate(bytes, alignment);
+        }
+    }
+    // Each new block doubles in size, up to 64 times the first
+    size_t size = std::max(needed, blockSize << std::min<size_t>(blocks.size(), 6));
+    blocks.reserve(blocks.size() + 1);
+    blocks.push_back({static_cast<char *>(::operator new(size)), size});
+    heldBytes += size;
+    current = blocks.size() - 1;
+    next = blocks[current].begin;
+    end = next + size;
+    return do_allocate(bytes, alignment);
+}
+
+size_t formatNumber(char *out, double value, NumberFormat format)
+{
+    char *end = out + MAX_FORMATTED_LENGTH;
+    if (format.style == NumberStyle::SHORTEST)
+        return static_cast<size_t>(std::to_chars(out, end, value).ptr - out);
+    int precision = std::min(std::max(format.precision, 0), MAX_FORMAT_PRECISION);
+    std::chars_format style = format.style == NumberStyle::FIXED ? std::chars_format::fixed : std::chars_format::scientific;
+    return static_cast<size_t>(std::to_chars(out, end, value, style, precision).ptr - out);
+}
+
+#ifdef CALC_INSTRUMENT
+namespace instrument
+{
+namespace
+{
+struct Totals
+{
+    uint64_t calls = 0, ticks = 0, maxTicks = 0, bytes = 0, allocations = 0;
+    std::array<uint64_t, LATENCY_BUCKETS> histogram{};
+
+    void add(const OperationCounters &c)
+    {
+        calls += c.calls.load(std::memory_order_relaxed);
+        ticks += c.ticks.load(std::memory_order_relaxed);
+        maxTicks = std::max(maxTicks, c.maxTicks.load(std::memory_order_relaxed));
+        bytes += c.bytes.load(std::memory_order_relaxed);
+        allocations += c.allocations.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+            histogram[i] += c.histogram[i].load(std::memory_order_relaxed);
+    }
+};
+
+struct Registry
+{
+    std::mutex mutex;
+    std::array<const char *, MAX_OPERATIONS> names{};
+    size_t count = 0;
+    std::vector<ThreadCounters *> threads;
+    std::array<Totals, MAX_OPERATIONS> retired;
+    // Tick rate is calibrated against the steady clock since the first use
+    uint64_t startTicks = ticks();
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+};
+
+// Function-local so it exists before any static initialiser records a call
+Registry &registry()
+{
+    static Registry *r = new Registry; // Never destroyed: threads may still exit after main
+    return *r;
+}
+
+// Latency at quantile q, taking the geometric middle of its log2 bucket
+double quantileTicks(const Totals &t, double q)
+{
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * t.calls)), seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        seen += t.histogram[i];
+        if (seen >= rank && t.histogram[i])
+            return std::min(std::ldexp(std::sqrt(2.0), static_cast<int>(i)), static_cast<double>(t.maxTicks));
+    }
+    return static_cast<double>(t.maxTicks);
+}
+
+void zero(std::atomic<uint64_t> &counter)
+{
+    counter.store(0, std::memory_order_relaxed);
+}
+}
+
+ThreadCounters::ThreadCounters()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.push_back(this);
+}
+
+ThreadCounters::~ThreadCounters()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (size_t id = 0; id < r.count; id++)
+        r.retired[id].add(operations[id]);
+    r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+}
+
+size_t operationId(const char *name)
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (size_t id = 0; id < r.count; id++)
+        if (std::strcmp(r.names[id], name) == 0)
+            return id;
+    if (r.count == MAX_OPERATIONS - 1)
+    {
+        r.names[r.count++] = "other";
+        return MAX_OPERATIONS - 1;
+    }
+    if (r.count == MAX_OPERATIONS)
+        return MAX_OPERATIONS - 1;
+    r.names[r.count] = name;
+    return r.count++;
+}
+
+ThreadCounters &threadCounters()
+{
+    thread_local std::unique_ptr<ThreadCounters> counters(new ThreadCounters);
+    return *counters;
+}
+
+std::vector<OperationStats> collectStats()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - r.startTime).count();
+    uint64_t elapsedTicks = ticks() - r.startTicks;
+    double nsPerTick = (ns > 0 && elapsedTicks > 0) ? ns / elapsedTicks : 1.0;
+
+    std::vector<OperationStats> stats;
+    for (size_t id = 0; id < r.count; id++)
+    {
+        Totals t = r.retired[id];
+        for (const ThreadCounters *thread : r.threads)
+            t.add(thread->operations[id]);
+        if (t.calls == 0)
+            continue;
+
+        OperationStats s;
+        s.name = r.names[id];
+        s.calls = t.calls;
+        s.totalNs = t.ticks * nsPerTick;
+        s.meanNs = s.totalNs / t.calls;
+        s.p50Ns = quantileTicks(t, 0.50) * nsPerTick;
+        s.p99Ns = quantileTicks(t, 0.99) * nsPerTick;
+        s.maxNs = t.maxTicks * nsPerTick;
+        s.bytes = t.bytes;
+        s.allocations = t.allocations;
+        stats.push_back(s);
+    }
+    std::sort(stats.begin(), stats.end(), [](const OperationStats &a, const OperationStats &b)
+              { return a.totalNs > b.totalNs; });
+    return stats;
+}
+
+void resetStats()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.retired.fill(Totals());
+    for (ThreadCounters *thread : r.threads)
+        for (OperationCounters &c : thread->operations)
+        {
+            zero(c.calls);
+            zero(c.ticks);
+            zero(c.maxTicks);
+            zero(c.bytes);
+            zero(c.allocations);
+            for (std::atomic<uint64_t> &bucket : c.histogram)
+                zero(bucket);
+        }
+}
+
+bool dumpStats(const std::string &filename)
+{
+    std::FILE *file = std::fopen(filename.c_str(), "w");
+    if (!file)
+        return false;
+    std::fprintf(file, "operation\tcalls\ttotal_ms\tmean_us\tp50_us\tp99_us\tmax_us\tbytes\tallocations\n");
+    for (const OperationStats &s : collectStats())
+        std::fprintf(file, "%s\t%llu\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%llu\t%llu\n", s.name.c_str(),
+                     static_cast<unsigned long long>(s.calls), s.totalNs / 1e6, s.meanNs / 1e3, s.p50Ns / 1e3,
+                     s.p99Ns / 1e3, s.maxNs / 1e3, static_cast<unsigned long long>(s.bytes),
+                     static_cast<unsigned long long>(s.allocations));
+    return std::fclose(file) == 0;
+}
+}
+#endif
+
+double BigFloat::toDouble() const
+{
+    if (isZero())
+        return negative ? -0.0 : 0.0;
+    size_t n = limbs.size();
+    double top = static_cast<double>((static_cast<uint64_t>(limbs[n - 1]) << 32) | limbs[n - 2]);
+    int64_t shift = exponent + 32 * static_cast<int64_t>(n) - 64;
+    shift = std::max<int64_t>(std::min<int64_t>(shift, 4096), -4096);
+    double value = std::ldexp(top, static_cast<int>(shift));
+    return negative ? -value : value;
+}
+
+std::string BigFloat::toString(int significant) const
+{
+    if (isZero())
+        return "0";
+    if (significant <= 0)
+        significant = static_cast<int>((precision() - 1) * 0.30102999566398119521);
+
+    size_t work = limbs.size() + 2;
+    BigFloat scaled = abs().withLimbs(work);
+    size_t n = limbs.size();
+    double top = static_cast<double>(limbs[n - 1]) * 0x1p-32;
+    int64_t decimalExponent = static_cast<int64_t>(
+        std::floor(std::log10(top) + static_cast<double>(exponent + 32 * static_cast<int64_t>(n)) * 0.30102999566398119521));
+    BigFloat ten(10.0, static_cast<unsigned>(work * 32));
+    if (decimalExponent > 0)
+        scaled = scaled / integerPower(ten, static_cast<uint64_t>(decimalExponent));
+    else if (decimalExponent < 0)
+        scaled = scaled * integerPower(ten, static_cast<uint64_t>(-decimalExponent));
+    while (scaled.integerPart() >= 10)
+    {
+        scaled = scaled.dividedBy(10);
+        decimalExponent++;
+    }
+    while (scaled.integerPart() == 0)
+    {
+        scaled = scaled.multipliedBy(10);
+        decimalExponent--;
+    }
+
+    std::string digits;
+    for (int i = 0; i <= significant; i++)
+    {
+        uint32_t digit = scaled.integerPart();
+        digits += static_cast<char>('0' + digit);
+        scaled = (scaled - BigFloat(static_cast<double>(digit), static_cast<unsigned>(work * 32))).multipliedBy(10);
+    }
+    bool roundUp = digits.back() >= '5';
+    digits.pop_back();
+    for (size_t i = digits.size(); roundUp && i-- > 0;)
+    {
+        roundUp = digits[i] == '9';
+        digits[i] = roundUp ? '0' : static_cast<char>(digits[i] + 1);
+    }
+    if (roundUp)
+    {
+        digits.insert(digits.begin(), '1');
+        digits.pop_back();
+        decimalExponent++;
+    }
+    while (digits.size() > 1 && digits.back() == '0')
+        digits.pop_back();
+
+    std::string out = negative ? "-" : "";
+    if (decimalExponent >= -5 && decimalExponent < significant)
+    {
+        if (decimalExponent < 0)
+            out += "0." + std::string(static_cast<size_t>(-decimalExponent - 1), '0') + digits;
+        else if (static_cast<size_t>(decimalExponent) + 1 >= digits.size())
+            out += digits + std::string(static_cast<size_t>(decimalExponent) + 1 - digits.size(), '0');
+        else
+            out += digits.substr(0, decimalExponent + 1) + "." + digits.substr(decimalExponent + 1);
+    }
+    else
+    {
+        out += digits.substr(0, 1);
+        if (digits.size() > 1)
+            out += "." + digits.substr(1);
+        out += (decimalExponent < 0 ? "e-" : "e+") + std::to_string(std::llabs(decimalExponent));
+    }
+    return out;
+}
+
+BigFloat operator*(const BigFloat &a, const BigFloat &b)
+{
+    size_t n = std::max(a.limbs.size(), b.limbs.size());
+    bool sign = a.negative != b.negative;
+    if (a.isZero() || b.isZero())
+        return BigFloat::zero(n, sign);
+    std::vector<uint32_t> product(a.limbs.size() + b.limbs.size(), 0);
+    for (size_t i = 0; i < a.limbs.size(); i++)
+    {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b.limbs.size(); j++)
+        {
+            uint64_t t = static_cast<uint64_t>(a.limbs[i]) * b.limbs[j] + product[i + j] + carry;
+            product[i + j] = static_cast<uint32_t>(t);
+            carry = t >> 32;
+        }
+        product[i + b.limbs.size()] = static_cast<uint32_t>(carry);
+    }
+    return BigFloat::rounded(product, a.exponent + b.exponent, sign, n, false);
+}
+
+BigFloat operator/(const BigFloat &a, const BigFloat &b)
+{
+    if (b.isZero())
+        throw std::runtime_error("Division by zero");
+    size_t n = std::max(a.limbs.size(), b.limbs.size());
+    bool sign = a.negative != b.negative;
+    if (a.isZero())
+        return BigFloat::zero(n, sign);
+    return BigFloat::quotient(a.limbs, a.exponent, b.limbs, b.exponent, sign, n);
+}
+
+BigFloat BigFloat::exp(const BigFloat &x)
+{
+    size_t n = x.limbs.size();
+    if (x.isZero())
+        return BigFloat(1.0, x.precision());
+    double approx = x.toDouble();
+    if (approx > 1e9)
+        throw std::runtime_error("Result too large");
+    if (approx < -1e9)
+        return zero(n, false);
+
+    // x = k ln2 + r, then e^r = (e^(r / 2^s))^(2^s) with a Taylor series for the inner power
+    unsigned halvings = static_cast<unsigned>(std::sqrt(static_cast<double>(n * 32)));
+    size_t work = n + 2 + (halvings + 31) / 32;
+    unsigned workBits = static_cast<unsigned>(work * 32);
+    int64_t k = static_cast<int64_t>(std::llround(approx / 0.69314718055994530942));
+    BigFloat r = x.withLimbs(work) - ln2(workBits) * BigFloat(static_cast<double>(k), workBits);
+    r.exponent -= halvings;
+
+    BigFloat total(1.0, workBits), term(1.0, workBits);
+    for (uint32_t i = 1; !term.isZero() && term.topBit() > total.topBit() - static_cast<int64_t>(workBits) - 2; i++)
+    {
+        term = (term * r).dividedBy(i);
+        total = total + term;
+    }
+    for (unsigned i = 0; i < halvings; i++)
+        total = total * total;
+    total.exponent += k;
+    return total.withLimbs(n);
+}
+
+BigFloat BigFloat::log(const BigFloat &x)
+{
+    if (x.isZero())
+        throw std::runtime_error("Logarithm of zero");
+    if (x.negative)
+        throw std::runtime_error("Logarithm of a negative number");
+    size_t n = x.limbs.size();
+    int64_t binaryExponent = x.topBit();
+    size_t work = n + 2 + static_cast<size_t>(std::log2(std::fabs(static_cast<double>(binaryExponent)) + 1.0)) / 32;
+    unsigned workBits = static_cast<unsigned>(work * 32);
+
+    BigFloat target = x.withLimbs(work);
+    double top = static_cast<double>(x.limbs[n - 1]) * 0x1p-32;
+    BigFloat y(std::log(top) + static_cast<double>(binaryExponent) * 0.69314718055994530942, workBits);
+    for (double correctBits = 40; correctBits < workBits; correctBits *= 3)
+    {
+        BigFloat e = exp(y);
+        BigFloat step = (target - e) / (target + e);
+        step.exponent += 1;
+        y = y + step;
+    }
+    return y.withLimbs(n);
+}
+
+BigFloat BigFloat::pow(const BigFloat &base, const BigFloat &power)
+{
+    size_t n = std::max(base.limbs.size(), power.limbs.size());
+    size_t work = n + 1;
+    if (power.isZero())
+        return BigFloat(1.0, static_cast<unsigned>(n * 32));
+    if (power.isInteger() && power.topBit() < 62)
+    {
+        if (base.isZero() && power.negative)
+            throw std::runtime_error("Division by zero");
+        uint64_t count = power.toUnsigned();
+        BigFloat result = integerPower(base.withLimbs(work), count);
+        if (power.negative)
+            result = BigFloat(1.0, static_cast<unsigned>(work * 32)) / result;
+        return result.withLimbs(n);
+    }
+    if (base.isZero())
+    {
+        if (power.negative)
+            throw std::runtime_error("Division by zero");
+        return zero(n, false);
+    }
+    if (base.negative)
+        throw std::runtime_error("Negative base with a fractional exponent");
+
+    // The error of b ln(a) is amplified by its magnitude, so carry its integer bits as guard bits
+    double top = static_cast<double>(base.limbs.back()) * 0x1p-32;
+    double magnitude = std::fabs(power.toDouble() * (std::log(top) + static_cast<double>(base.topBit()) * 0.69314718055994530942));
+    work += static_cast<size_t>(std::log2(magnitude + 1.0)) / 32 + 1;
+    BigFloat product = power.withLimbs(work) * log(base.withLimbs(work));
+    return exp(product).withLimbs(n);
+}
+
+BigFloat BigFloat::withLimbs(size_t n) const
+{
+    if (n == limbs.size())
+        return *this;
+    if (isZero())
+        return zero(n, negative);
+    return rounded(limbs, exponent, negative, n, false);
+}
+
+uint32_t BigFloat::integerPart() const
+{
+    if (isZero() || topBit() <= 0)
+        return 0;
+    std::vector<uint32_t> whole = shifted(limbs, exponent, 1);
+    return whole[0];
+}
+
+BigFloat BigFloat::multipliedBy(uint32_t factor) const
+{
+    if (isZero())
+        return *this;
+    std::vector<uint32_t> product = limbs;
+    multiplyAdd(product, factor, 0);
+    return rounded(product, exponent, negative, limbs.size(), false);
+}
+
+BigFloat BigFloat::dividedBy(uint32_t divisor) const
+{
+    if (isZero())
+        return *this;
+    std::vector<uint32_t> wide(limbs.size() + 2, 0);
+    std::copy(limbs.begin(), limbs.end(), wide.begin() + 2);
+    uint64_t remainder = 0;
+    for (size_t i = wide.size(); i-- > 0;)
+    {
+        uint64_t current = (remainder << 32) | wide[i];
+        wide[i] = static_cast<uint32_t>(current / divisor);
+        remainder = current % divisor;
+    }
+    return rounded(wide, exponent - 64, negative, limbs.size(), remainder != 0);
+}
+
+BigFloat BigFloat::integerPower(BigFloat base, uint64_t count)
+{
+    BigFloat result(1.0, base.precision());
+    while (count > 0)
+    {
+        if (count & 1)
+            result = result * base;
+        count >>= 1;
+        if (count > 0)
+            base = base * base;
+    }
+    return result;
+}
+
+BigFloat BigFloat::ln2(unsigned bits)
+{
+    static std::mutex cacheMutex;
+    static std::unique_ptr<BigFloat> cached;
+    size_t n = limbCount(bits);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (!cached || cached->limbs.size() < n + 1)
+    {
+        unsigned workBits = static_cast<unsigned>((n + 2) * 32);
+        BigFloat power = BigFloat(1.0, workBits).dividedBy(3), total(0.0, workBits);
+        for (uint32_t k = 0; !power.isZero() && power.topBit() > -static_cast<int64_t>(workBits) - 2; k++)
+        {
+            total = total + power.dividedBy(2 * k + 1);
+            power = power.dividedBy(9);
+        }
+        total.exponent += 1;
+        cached.reset(new BigFloat(total.withLimbs(n + 1)));
+    }
+    return cached->withLimbs(n);
+}
+
+void BigFloat::multiplyAdd(std::vector<uint32_t> &magnitude, uint32_t factor, uint32_t addend)
+{
+    uint64_t carry = addend;
+    for (uint32_t &limb : magnitude)
+    {
+        uint64_t t = static_cast<uint64_t>(limb) * factor + carry;
+        limb = static_cast<uint32_t>(t);
+        carry = t >> 32;
+    }
+    if (carry)
+        magnitude.push_back(static_cast<uint32_t>(carry));
+}
+
+size_t BigFloat::bitLength(const std::vector<uint32_t> &magnitude)
+{
+    for (size_t i = magnitude.size(); i-- > 0;)
+    {
+        if (magnitude[i])
+        {
+            uint32_t top = magnitude[i];
+            size_t bits = 0;
+            while (top)
+            {
+                top >>= 1;
+                bits++;
+            }
+            return i * 32 + bits;
+        }
+    }
+    return 0;
+}
+
+bool BigFloat::anyBitBelow(const std::vector<uint32_t> &magnitude, int64_t bit)
+{
+    if (bit <= 0)
+        return false;
+    size_t whole = static_cast<size_t>(std::min<int64_t>(bit / 32, static_cast<int64_t>(magnitude.size())));
+    for (size_t i = 0; i < whole; i++)
+    {
+        if (magnitude[i])
+            return true;
+    }
+    return whole < magnitude.size() && bit % 32 != 0 && (magnitude[whole] & ((1u << (bit % 32)) - 1)) != 0;
+}
+
+std::vector<uint32_t> BigFloat::shifted(const std::vector<uint32_t> &magnitude, int64_t left, size_t size)
+{
+    std::vector<uint32_t> out(size, 0);
+    int64_t limbShift = left >= 0 ? left / 32 : -((-left + 31) / 32);
+    unsigned bitShift = static_cast<unsigned>(left - limbShift * 32);
+    for (size_t i = 0; i < size; i++)
+    {
+        int64_t source = static_cast<int64_t>(i) - limbShift;
+        uint64_t low = source >= 0 && source < static_cast<int64_t>(magnitude.size()) ? magnitude[source] : 0;
+        uint64_t below = source >= 1 && source - 1 < static_cast<int64_t>(magnitude.size()) ? magnitude[source - 1] : 0;
+        out[i] = static_cast<uint32_t>(((low << 32 | below) << bitShift) >> 32);
+    }
+    return out;
+}
+
+BigFloat BigFloat::rounded(const std::vector<uint32_t> &magnitude, int64_t scale, bool sign, size_t n, bool sticky)
+{
+    size_t length = bitLength(magnitude);
+    if (length == 0)
+        return zero(n, sign);
+    int64_t drop = static_cast<int64_t>(length) - static_cast<int64_t>(n * 32);
+    BigFloat result = zero(n, sign);
+    result.limbs = shifted(magnitude, -drop, n);
+    result.exponent = scale + drop;
+    if (drop > 0)
+    {
+        bool half = (magnitude[(drop - 1) / 32] >> ((drop - 1) % 32)) & 1;
+        bool rest = sticky || anyBitBelow(magnitude, drop - 1);
+        if (half && (rest || (result.limbs[0] & 1)))
+        {
+            size_t i = 0;
+            while (i < n && ++result.limbs[i] == 0)
+                i++;
+            if (i == n)
+            {
+                result.limbs.back() = 0x80000000u;
+                result.exponent++;
+            }
+        }
+    }
+    return result;
+}
+
+BigFloat BigFloat::quotient(const std::vector<uint32_t> &numerator, int64_t numeratorScale,
+                            const std::vector<uint32_t> &denominator, int64_t denominatorScale, bool sign, size_t n)
+{
+    // Shift the numerator so the integer quotient carries n limbs plus guard bits
+    int64_t extra = std::max<int64_t>(0, static_cast<int64_t>(n * 32 + 2 + bitLength(denominator)) -
+                                             static_cast<int64_t>(bitLength(numerator))) + 1;
+    std::vector<uint32_t> dividend = shifted(numerator, extra, (bitLength(numerator) + extra + 31) / 32 + 1);
+    std::vector<uint32_t> divisor(denominator.begin(), denominator.begin() + (bitLength(denominator) + 31) / 32);
+    bool sticky = false;
+    std::vector<uint32_t> result = divideMagnitudes(dividend, divisor, sticky);
+    return rounded(result, numeratorScale - extra - denominatorScale, sign, n, sticky);
+}
+
+std::vector<uint32_t> BigFloat::divideMagnitudes(std::vector<uint32_t> u, const std::vector<uint32_t> &v, bool &sticky)
+{
+    const uint64_t BASE = 1ULL << 32;
+    size_t n = v.size();
+    while (u.size() <= n)
+        u.push_back(0);
+    size_t m = u.size();
+    std::vector<uint32_t> q(m - n, 0);
+
+    if (n == 1)
+    {
+        uint64_t remainder = 0;
+        for (size_t i = m; i-- > 0;)
+        {
+            uint64_t current = (remainder << 32) | u[i];
+            if (i < q.size())
+                q[i] = static_cast<uint32_t>(current / v[0]);
+            remainder = current % v[0];
+        }
+        sticky = remainder != 0;
+        return q;
+    }
+
+    // Normalize so the divisor's top digit has its high bit set
+    unsigned shift = 0;
+    while (!(v[n - 1] & (0x80000000u >> shift)))
+        shift++;
+    std::vector<uint32_t> vn = shifted(v, shift, n);
+    std::vector<uint32_t> un = shifted(u, shift, m + 1);
+
+    for (size_t j = m - n; j-- > 0;)
+    {
+        uint64_t top = (static_cast<uint64_t>(un[j + n]) << 32) | un[j + n - 1];
+        uint64_t qhat = top / vn[n - 1];
+        uint64_t rhat = top % vn[n - 1];
+        while (qhat >= BASE || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2]))
+        {
+            qhat--;
+            rhat += vn[n - 1];
+            if (rhat >= BASE)
+                break;
+        }
+
+        int64_t borrow = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t p = qhat * vn[i];
+            int64_t t = static_cast<int64_t>(un[i + j]) - borrow - static_cast<int64_t>(p & 0xffffffffu);
+            un[i + j] = static_cast<uint32_t>(t);
+            borrow = static_cast<int64_t>(p >> 32) - (t >> 32);
+        }
+        int64_t t = static_cast<int64_t>(un[j + n]) - borrow;
+        un[j + n] = static_cast<uint32_t>(t);
+
+        // qhat was one too large: add the divisor back
+        if (t < 0)
+        {
+            qhat--;
+            uint64_t carry = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                uint64_t sum = static_cast<uint64_t>(un[i + j]) + vn[i] + carry;
+                un[i + j] = static_cast<uint32_t>(sum);
+                carry = sum >> 32;
+            }
+            un[j + n] += static_cast<uint32_t>(carry);
+        }
+        q[j] = static_cast<uint32_t>(qhat);
+    }
+    sticky = bitLength(un) != 0;
+    return q;
+}
+
+BigFloat BigFloat::sum(const BigFloat &a, const BigFloat &b, bool subtract)
+{
+    size_t n = std::max(a.limbs.size(), b.limbs.size());
+    bool bNegative = b.negative != subtract;
+    if (b.isZero())
+        return a.isZero() ? zero(n, a.negative && bNegative) : a.withLimbs(n);
+    if (a.isZero())
+    {
+        BigFloat result = b.withLimbs(n);
+        result.negative = bNegative;
+        return result;
+    }
+
+    const BigFloat *large = &a, *small = &b;
+    bool largeNegative = a.negative, smallNegative = bNegative;
+    if (b.topBit() > a.topBit())
+    {
+        std::swap(large, small);
+        std::swap(largeNegative, smallNegative);
+    }
+    // Bits of the smaller operand far below the result's last place only matter as a sticky bit
+    int64_t floor = large->topBit() - static_cast<int64_t>((n + 2) * 32);
+    if (small->topBit() <= floor)
+        return large->withLimbs(n).withSign(largeNegative);
+
+    int64_t base = std::max(std::min(large->exponent, small->exponent), floor);
+    size_t size = static_cast<size_t>((large->topBit() - base) / 32 + 2);
+    std::vector<uint32_t> x = shifted(large->limbs, large->exponent - base, size);
+    std::vector<uint32_t> y = shifted(small->limbs, small->exponent - base, size);
+    bool sticky = small->exponent < base && anyBitBelow(small->limbs, base - small->exponent);
+
+    if (largeNegative == smallNegative)
+    {
+        uint64_t carry = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            uint64_t t = static_cast<uint64_t>(x[i]) + y[i] + carry;
+            x[i] = static_cast<uint32_t>(t);
+            carry = t >> 32;
+        }
+        return rounded(x, base, largeNegative, n, sticky);
+    }
+
+    bool sign = largeNegative;
+    bool swapped = false;
+    for (size_t i = size; i-- > 0;)
+    {
+        if (x[i] != y[i])
+        {
+            swapped = x[i] < y[i];
+            break;
+        }
+    }
+    if (swapped)
+    {
+        std::swap(x, y);
+        sign = smallNegative;
+    }
+    // The truncated part of the smaller operand is subtracted as one unit plus a sticky remainder
+    int64_t borrow = sticky && !swapped ? 1 : 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        int64_t t = static_cast<int64_t>(x[i]) - y[i] - borrow;
+        borrow = t < 0;
+        x[i] = static_cast<uint32_t>(t + (borrow << 32));
+    }
+    if (bitLength(x) == 0 && !sticky)
+        return zero(n, false);
+    return rounded(x, base, sign, n, sticky);
+}
+
+DoubleDouble DoubleDouble::exp(const DoubleDouble &a)
+{
+    const DoubleDouble LN2(6.931471805599452862e-01, 2.319046813846299558e-17);
+    if (a.hi > 709.8)
+        return DoubleDouble(HUGE_VAL);
+    if (a.hi < -745.2)
+        return DoubleDouble(0.0);
+    if (std::isnan(a.hi))
+        return a;
+    double k = std::nearbyint(a.hi / LN2.hi);
+    DoubleDouble r = ldexp(a - LN2 * DoubleDouble(k), -4);
+
+    // expm1 of r by Taylor to r^14 (|r| < 0.022), then e^(2x) - 1 = (e^x - 1)(e^x - 1 + 2)
+    // four times; fewer doublings keep the rounding error from being amplified
+    static const std::array<DoubleDouble, 15> INVERSE_FACTORIALS = []()
+    {
+        std::array<DoubleDouble, 15> table;
+        table[0] = DoubleDouble(1.0);
+        for (int i = 1; i < 15; i++)
+            table[i] = table[i - 1] / DoubleDouble(i);
+        return table;
+    }();
+    DoubleDouble total = INVERSE_FACTORIALS[14];
+    for (int i = 13; i >= 1; i--)
+        total = total * r + INVERSE_FACTORIALS[i];
+    total = total * r;
+    for (int i = 0; i < 4; i++)
+        total = total * (total + DoubleDouble(2.0));
+    return ldexp(total + DoubleDouble(1.0), static_cast<int>(k));
+}
+
+DoubleDouble DoubleDouble::log(const DoubleDouble &a)
+{
+    if (a.hi <= 0.0)
+        return DoubleDouble(a.hi == 0.0 ? -HUGE_VAL : NAN);
+    if (!std::isfinite(a.hi))
+        return a;
+    DoubleDouble y(std::log(a.hi));
+    return y + a * exp(-y) - DoubleDouble(1.0);
+}
+
+DoubleDouble DoubleDouble::pow(const DoubleDouble &base, const DoubleDouble &power)
+{
+    if (power.lo == 0.0 && std::trunc(power.hi) == power.hi && std::fabs(power.hi) < 0x1p53)
+    {
+        uint64_t count = static_cast<uint64_t>(std::fabs(power.hi));
+        DoubleDouble result(1.0), square = base;
+        while (count > 0)
+        {
+            if (count & 1)
+                result = result * square;
+            count >>= 1;
+            if (count > 0)
+                square = square * square;
+        }
+        return power.hi < 0 ? DoubleDouble(1.0) / result : result;
+    }
+    if (base.hi == 0.0)
+        return DoubleDouble(power.hi > 0 ? 0.0 : HUGE_VAL);
+    return exp(power * log(base));
+}
+
+Interval Interval::fromString(const std::string &text)
+{
+    double nearest = std::stod(text);
+    uint64_t digits = 0;
+    int significant = 0, decimals = 0;
+    bool seenPoint = false;
+    for (char ch : text)
+    {
+        if (ch == '.')
+        {
+            if (seenPoint)
+                break;
+            seenPoint = true;
+            continue;
+        }
+        if (!std::isdigit(static_cast<unsigned char>(ch)))
+            break;
+        if (digits > 0 || ch != '0')
+            significant++;
+        if (significant <= 19)
+            digits = digits * 10 + static_cast<uint64_t>(ch - '0');
+        decimals += seenPoint;
+    }
+    if (digits == 0)
+        return Interval(0.0);
+
+    int direction;
+    if (significant <= 19 && decimals <= 22)
+    {
+        DoubleDouble scaled = DoubleDouble::twoProduct(nearest, std::pow(10.0, decimals));
+        double digitsHi = static_cast<double>(digits);
+        double digitsLo = static_cast<double>(static_cast<int64_t>(digits - static_cast<uint64_t>(digitsHi)));
+        if (scaled.hi == digitsHi && scaled.lo == digitsLo)
+            return Interval(nearest);
+        DoubleDouble difference = DoubleDouble::twoSum(scaled.hi, -digitsHi);
+        double total = difference.hi + (difference.lo + (scaled.lo - digitsLo));
+        // Too close to call in double-double: widen both ways
+        if (std::fabs(total) <= 0x1p-95 * digitsHi)
+            return Interval(IntervalMath::nextDown(nearest), IntervalMath::nextUp(nearest));
+        direction = total > 0 ? 1 : -1;
+    }
+    else
+    {
+        unsigned bits = static_cast<unsigned>(std::min<size_t>(BigFloat::MAX_PRECISION, 1216 + 4 * text.size()));
+        BigFloat difference = BigFloat(nearest, bits) - BigFloat::fromString(text, bits);
+        if (difference.isZero())
+            return Interval(nearest);
+        direction = difference.isNegative() ? -1 : 1;
+    }
+    // direction > 0: the double is above the decimal
+    return direction > 0 ? Interval(IntervalMath::nextDown(nearest), nearest)
+                         : Interval(nearest, IntervalMath::nextUp(nearest));
+}
+
+Interval Interval::pow(const Interval &base, const Interval &power)
+{
+    if (power.lo == power.hi && std::trunc(power.lo) == power.lo && std::fabs(power.lo) < 0x1p31)
+    {
+        long long n = static_cast<long long>(power.lo);
+        uint64_t count = static_cast<uint64_t>(std::llabs(n));
+        Interval result;
+        if (count % 2 == 1 || base.lo >= 0.0)
+            result = Interval(integerPower(Interval(base.lo), count).lo, integerPower(Interval(base.hi), count).hi);
+        else if (base.hi <= 0.0)
+            result = Interval(integerPower(Interval(base.hi), count).lo, integerPower(Interval(base.lo), count).hi);
+        else
+            result = Interval(0.0, std::max(integerPower(Interval(base.lo), count).hi, integerPower(Interval(base.hi), count).hi));
+        if (n < 0)
+        {
+            if (result.containsZero())
+                throw std::runtime_error("Division by zero");
+            result = Interval(1.0) / result;
+        }
+        return result;
+    }
+    if (base.lo < 0.0 || (base.lo == 0.0 && power.lo <= 0.0))
+        throw std::runtime_error("Interval power needs a positive base for fractional exponents");
+
+    double corners[4] = {std::pow(base.lo, power.lo), std::pow(base.lo, power.hi),
+                         std::pow(base.hi, power.lo), std::pow(base.hi, power.hi)};
+    double low = *std::min_element(corners, corners + 4), high = *std::max_element(corners, corners + 4);
+    low = std::max(0.0, IntervalMath::nextDown(IntervalMath::nextDown(low)));
+    high = IntervalMath::nextUp(IntervalMath::nextUp(high));
+    return Interval(low, high);
+}
+
+std::string Interval::toString() const
+{
+    std::string out = "[";
+    appendNumber(out, lo);
+    out += ", ";
+    appendNumber(out, hi);
+    return out + "]";
+}
+
+Interval Interval::integerPower(Interval base, uint64_t count)
+{
+    Interval result(1.0);
+    while (count > 0)
+    {
+        if (count & 1)
+            result = result * base;
+        count >>= 1;
+        if (count > 0)
+            base = base * base;
+    }
+    return result;
+}
+
+int getPrecedence(char op)
+{
+    if (op == '+' || op == '-')
+        return 1;
+    if (op == '*' || op == '/')
+        return 2;
+    if (op == '^')
+        return 3;
+    return 0;
+}
+
+CompiledExpression::CompiledExpression(std::string_view expr, std::pmr::memory_resource *memory)
+    : literals(memory), program(memory)
+{
+    CALC_PROFILE("compileExpression");
+    std::pmr::vector<char> ops(memory);
+    size_t depth = 0;
+
+    for (size_t i = 0; i < expr.length(); i++)
+    {
+        if (isspace(expr[i]))
+            continue;
+
+        if (isdigit(expr[i]) || expr[i] == '.')
+        {
+            size_t start = i;
+            while (i < expr.length() && (isdigit(expr[i]) || expr[i] == '.'))
+                i++;
+            pushLiteral(expr.substr(start, i - start), depth);
+            i--;
+        }
+        else if (isalpha(expr[i]) || expr[i] == '_')
+        {
+            size_t start = i;
+            while (i < expr.length() && (isalnum(expr[i]) || expr[i] == '_'))
+                i++;
+            pushVariable(expr.substr(start, i - start), depth);
+            i--;
+        }
+        else if (expr[i] == '(')
+        {
+            ops.push_back(expr[i]);
+        }
+        else if (expr[i] == ')')
+        {
+            while (!ops.empty() && ops.back() != '(')
+            {
+                pushOperator(ops.back(), depth);
+                ops.pop_back();
+            }
+            if (!ops.empty())
+                ops.pop_back(); // Remove '('
+        }
+        else if (expr[i] == '+' || expr[i] == '-' || expr[i] == '*' || expr[i] == '/' || expr[i] == '^')
+        {
+            // Handle negative numbers
+            if (expr[i] == '-' && (i == 0 || expr[i - 1] == '(' || expr[i - 1] == '+' ||
+                                   expr[i - 1] == '-' || expr[i - 1] == '*' || expr[i - 1] == '/' || expr[i - 1] == '^'))
+            {
+                pushLiteral("0", depth);
+            }
+
+            while (!ops.empty() && getPrecedence(ops.back()) >= getPrecedence(expr[i]))
+            {
+                pushOperator(ops.back(), depth);
+                ops.pop_back();
+            }
+            ops.push_back(expr[i]);
+        }
+    }
+
+    // Unclosed parentheses are closed at the end
+    while (!ops.empty())
+    {
+        if (ops.back() != '(')
+            pushOperator(ops.back(), depth);
+        ops.pop_back();
+    }
+    if (depth != 1)
+        throw std::runtime_error("Invalid expression");
+}
+
+std::string CompiledExpression::shape() const
+{
+    std::string key;
+    key.reserve(program.size());
+    for (const Instruction &step : program)
+    {
+        if (step.op == LITERAL)
+            key += '#';
+        else if (step.op == VARIABLE)
+            key += '$' + std::to_string(step.index) + ',';
+        else
+            key += step.op;
+    }
+    return key;
+}
+
+double CompiledExpression::gradient(const std::vector<double> &values, const std::vector<double> &variableValues,
+                                    std::vector<double> &gradient) const
+{
+    CALC_PROFILE("CompiledExpression::gradient");
+    checkVariables(variableValues.size());
+    thread_local std::vector<double> node, adjoint;
+    thread_local std::vector<uint32_t> stack, left, right;
+    thread_local std::vector<uint8_t> constant;
+    size_t n = program.size();
+    node.resize(n);
+    left.resize(n);
+    right.resize(n);
+    constant.resize(n);
+    stack.clear();
+    for (size_t k = 0; k < n; k++)
+    {
+        const Instruction &step = program[k];
+        if (step.op == LITERAL || step.op == VARIABLE)
+        {
+            node[k] = step.op == LITERAL ? values[step.index] : variableValues[step.index];
+            constant[k] = step.op == LITERAL;
+            stack.push_back(static_cast<uint32_t>(k));
+            continue;
+        }
+        right[k] = stack.back();
+        stack.pop_back();
+        left[k] = stack.back();
+        stack.back() = static_cast<uint32_t>(k);
+        node[k] = applyOperation(node[left[k]], node[right[k]], step.op);
+        constant[k] = constant[left[k]] & constant[right[k]];
+    }
+
+    gradient.assign(variableValues.size(), 0.0);
+    adjoint.assign(n, 0.0);
+    adjoint[n - 1] = 1.0;
+    for (size_t k = n; k-- > 0;)
+    {
+        const Instruction &step = program[k];
+        if (constant[k] || adjoint[k] == 0.0)
+            continue;
+        if (step.op == VARIABLE)
+        {
+            gradient[step.index] += adjoint[k];
+            continue;
+        }
+        double dLeft, dRight;
+        partials(step.op, node[left[k]], node[right[k]], node[k], dLeft, dRight);
+        // Constant operands are skipped: their partials may be nan (log of a negative base)
+        if (!constant[left[k]])
+            adjoint[left[k]] += adjoint[k] * dLeft;
+        if (!constant[right[k]])
+            adjoint[right[k]] += adjoint[k] * dRight;
+    }
+    return node[n - 1];
+}
+
+double CompiledExpression::gradientForward(const std::vector<double> &values, const std::vector<double> &variableValues,
+                                           std::vector<double> &gradient) const
+{
+    CALC_PROFILE("CompiledExpression::gradientForward");
+    checkVariables(variableValues.size());
+    size_t width = variableValues.size();
+    thread_local std::vector<double> stack, tangents;
+    thread_local std::vector<uint8_t> constant;
+    stack.clear();
+    constant.clear();
+    for (const Instruction &step : program)
+    {
+        if (step.op == LITERAL || step.op == VARIABLE)
+        {
+            stack.push_back(step.op == LITERAL ? values[step.index] : variableValues[step.index]);
+            constant.push_back(step.op == LITERAL);
+            tangents.resize(stack.size() * width);
+            double *row = &tangents[(stack.size() - 1) * width];
+            std::fill(row, row + width, 0.0);
+            if (step.op == VARIABLE)
+                row[step.index] = 1.0;
+            continue;
+        }
+        size_t top = stack.size() - 1;
+        double a = stack[top - 1], b = stack[top];
+        double result = applyOperation(a, b, step.op);
+        double dLeft, dRight;
+        partials(step.op, a, b, result, dLeft, dRight);
+        double *rowLeft = &tangents[(top - 1) * width];
+        const double *rowRight = &tangents[top * width];
+        if (constant[top - 1] && !constant[top])
+        {
+            for (size_t j = 0; j < width; j++)
+                rowLeft[j] = dRight * rowRight[j];
+        }
+        else if (!constant[top - 1] && constant[top])
+        {
+            for (size_t j = 0; j < width; j++)
+                rowLeft[j] *= dLeft;
+        }
+        else if (!constant[top - 1])
+        {
+            for (size_t j = 0; j < width; j++)
+                rowLeft[j] = dLeft * rowLeft[j] + dRight * rowRight[j];
+        }
+        constant[top - 1] &= constant[top];
+        stack.pop_back();
+        constant.pop_back();
+        stack[top - 1] = result;
+    }
+    gradient.assign(tangents.begin(), tangents.begin() + width);
+    return stack.back();
+}
+
+void CompiledExpression::pushVariable(std::string_view name, size_t &depth)
+{
+    size_t index = std::find(variables.begin(), variables.end(), name) - variables.begin();
+    if (index == variables.size())
+        variables.emplace_back(name);
+    program.push_back({VARIABLE, static_cast<uint32_t>(index)});
+    depth++;
+}
+
+void CompiledExpression::partials(char op, double a, double b, double r, double &dLeft, double &dRight)
+{
+    switch (op)
+    {
+    case '+':
+        dLeft = 1.0;
+        dRight = 1.0;
+        break;
+    case '-':
+        dLeft = 1.0;
+        dRight = -1.0;
+        break;
+    case '*':
+        dLeft = b;
+        dRight = a;
+        break;
+    case '/':
+        dLeft = 1.0 / b;
+        dRight = -r / b;
+        break;
+    case '^':
+        dLeft = b == 0.0 ? 0.0 : b * std::pow(a, b - 1.0);
+        dRight = r == 0.0 ? 0.0 : r * std::log(a);
+        break;
+    default:
+        dLeft = 0.0;
+        dRight = 0.0;
+        break;
+    }
+}
+
+void CompiledExpression::pushOperator(char op, size_t &depth)
+{
+    if (depth < 2)
+        throw std::runtime_error("Invalid expression");
+    program.push_back({op, 0});
+    depth--;
+}
+
+double evaluateExpression(const std::string &expr)
+{
+    CALC_PROFILE("evaluateExpression");
+    // The compiled form only lives for this call
+    thread_local Arena arena;
+    arena.reset();
+    return CompiledExpression(expr, &arena).evaluate<double>();
+}
+
+const ExpressionCache::Entry &ExpressionCache::get(std::string_view text)
+{
+    auto found = index.find(text);
+    if (found != index.end())
+    {
+        hitCount++;
+        entries.splice(entries.begin(), entries, found->second);
+        return found->second->second;
+    }
+    missCount++;
+    CompiledExpression expression(text);
+    std::vector<double> literals = expression.literalValues<double>();
+    if (entries.size() == capacity)
+    {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+    entries.emplace_front(std::string(text), Entry{std::move(expression), std::move(literals)});
+    index.emplace(entries.front().first, entries.begin());
+    return entries.front().second;
+}
+
+void ComplexBatch::add(const ComplexArray &a, const ComplexArray &b, ComplexArray &out)
+{
+    size_t n = checkSizes(a, b, out);
+    const double *ar = a.re.data(), *ai = a.im.data(), *br = b.re.data(), *bi = b.im.data();
+    double *outRe = out.re.data(), *outIm = out.im.data();
+    for (size_t i = 0; i < n; i++)
+    {
+        outRe[i] = ar[i] + br[i];
+        outIm[i] = ai[i] + bi[i];
+    }
+}
+
+void ComplexBatch::multiply(const ComplexArray &a, const ComplexArray &b, ComplexArray &out)
+{
+    size_t n = checkSizes(a, b, out);
+    const double *ar = a.re.data(), *ai = a.im.data(), *br = b.re.data(), *bi = b.im.data();
+    double *outRe = out.re.data(), *outIm = out.im.data();
+    for (size_t i = 0; i < n; i++)
+    {
+        double r = ar[i] * br[i] - ai[i] * bi[i];
+        double m = ar[i] * bi[i] + ai[i] * br[i];
+        outRe[i] = r;
+        outIm[i] = m;
+    }
+}
+
+void ComplexBatch::scale(const ComplexArray &in, std::complex<double> c, ComplexArray &out)
+{
+    out.resize(in.size());
+    const double cr = c.real(), ci = c.imag();
+    const double *inRe = in.re.data(), *inIm = in.im.data();
+    double *outRe = out.re.data(), *outIm = out.im.data();
+    for (size_t i = 0, n = in.size(); i < n; i++)
+    {
+        double r = inRe[i] * cr - inIm[i] * ci;
+        double m = inRe[i] * ci + inIm[i] * cr;
+        outRe[i] = r;
+        outIm[i] = m;
+    }
+}
+
+void ComplexBatch::conjugate(const ComplexArray &in, ComplexArray &out)
+{
+    out.resize(in.size());
+    const double *inIm = in.im.data();
+    double *outIm = out.im.data();
+    if (&out != &in)
+        std::copy(in.re.begin(), in.re.end(), out.re.begin());
+    for (size_t i = 0, n = in.size(); i < n; i++)
+        outIm[i] = -inIm[i];
+}
+
+void ComplexBatch::magnitude(const ComplexArray &in, double *out)
+{
+    const double *inRe = in.re.data(), *inIm = in.im.data();
+    size_t n = in.size();
+    uint64_t outliers = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double r = inRe[i], m = inIm[i];
+        out[i] = std::sqrt(r * r + m * m);
+        outliers |= needsHypot(r, m);
+    }
+    if (outliers == 0)
+        return;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (needsHypot(inRe[i], inIm[i]))
+            out[i] = std::hypot(inRe[i], inIm[i]);
+    }
+}
+
+size_t ComplexBatch::checkSizes(const ComplexArray &a, const ComplexArray &b, ComplexArray &out)
+{
+    if (a.size() != b.size())
+        throw std::invalid_argument("Complex arrays differ in length");
+    out.resize(a.size());
+    return a.size();
+}
+
+FftPlan::FftPlan(size_t n)
+    : length(n)
+{
+    if (n == 0)
+        throw std::invalid_argument("FFT length must be positive");
+
+    std::vector<size_t> factors;
+    size_t rest = n;
+    while (rest % 4 == 0)
+    {
+        factors.push_back(4);
+        rest /= 4;
+    }
+    if (rest % 2 == 0)
+    {
+        factors.push_back(2);
+        rest /= 2;
+    }
+    for (size_t p = 3; p * p <= rest; p += 2)
+    {
+        while (rest % p == 0)
+        {
+            factors.push_back(p);
+            rest /= p;
+        }
+    }
+    if (rest > 1)
+        factors.push_back(rest);
+
+    if (factors.empty() || *std::max_element(factors.begin(), factors.end()) <= MAX_DIRECT_RADIX)
+    {
+        radices = factors;
+        twiddles.resize(n);
+        for (size_t k = 0; k < n; k++)
+            twiddles[k] = std::polar(1.0, -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(n));
+    }
+    else
+    {
+        initBluestein();
+    }
+}
+
+void FftPlan::forward(const Complex *in, Complex *out, unsigned threads) const
+{
+    threads = resolveThreads(threads);
+    if (usesBluestein())
+        bluestein(in, out, threads);
+    else
+        transform(out, in, 1, 1, 0, threads);
+}
+
+void FftPlan::inverse(const Complex *in, Complex *out, unsigned threads) const
+{
+    std::vector<Complex> conjugated(length);
+    for (size_t k = 0; k < length; k++)
+        conjugated[k] = std::conj(in[k]);
+    forward(conjugated.data(), out, threads);
+    for (size_t k = 0; k < length; k++)
+        out[k] = std::conj(out[k]);
+}
+
+unsigned FftPlan::resolveThreads(unsigned threads) const
+{
+    if (length < PARALLEL_MIN)
+        return 1;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    return threads;
+}
+
+void FftPlan::initBluestein()
+{
+    size_t m = 1;
+    while (m < 2 * length - 1)
+        m <<= 1;
+    inner = get(m);
+
+    // k^2 mod 2n keeps the chirp angle small and exact
+    chirp.resize(length);
+    uint64_t square = 0;
+    for (size_t k = 0; k < length; k++)
+    {
+        chirp[k] = std::polar(1.0, -M_PI * static_cast<double>(square) / static_cast<double>(length));
+        square = (square + 2 * k + 1) % (2 * length);
+    }
+
+    std::vector<Complex> filter(m, Complex(0.0, 0.0));
+    filter[0] = std::conj(chirp[0]);
+    for (size_t k = 1; k < length; k++)
+        filter[k] = filter[m - k] = std::conj(chirp[k]);
+    chirpSpectrum.resize(m);
+    inner->forward(filter.data(), chirpSpectrum.data(), 1);
+    for (size_t k = 0; k < m; k++)
+        chirpSpectrum[k] /= static_cast<double>(m);
+}
+
+void FftPlan::bluestein(const Complex *in, Complex *out, unsigned threads) const
+{
+    size_t m = inner->size();
+    std::vector<Complex> a(m, Complex(0.0, 0.0)), spectrum(m);
+    for (size_t k = 0; k < length; k++)
+        a[k] = in[k] * chirp[k];
+    inner->forward(a.data(), spectrum.data(), threads);
+    for (size_t k = 0; k < m; k++)
+        spectrum[k] *= chirpSpectrum[k];
+    inner->inverse(spectrum.data(), a.data(), threads);
+    for (size_t k = 0; k < length; k++)
+        out[k] = a[k] * chirp[k];
+}
+
+void FftPlan::transform(Complex *out, const Complex *in, size_t inStride, size_t fstride, size_t stage,
+                        unsigned threads) const
+{
+    if (stage == radices.size())
+    {
+        out[0] = in[0];
+        return;
+    }
+    const size_t p = radices[stage];
+    const size_t m = length / (fstride * p);
+
+    if (m == 1)
+    {
+        for (size_t q = 0; q < p; q++)
+            out[q] = in[q * fstride * inStride];
+    }
+    else if (threads > 1 && m * p >= PARALLEL_MIN)
+    {
+        unsigned workers = static_cast<unsigned>(std::min<size_t>(threads, p));
+        unsigned childThreads = std::max(1u, threads / workers);
+        std::vector<std::thread> pool;
+        for (unsigned w = 1; w < workers; w++)
+            pool.emplace_back([=]()
+                              {
+                for (size_t q = w; q < p; q += workers)
+                    transform(out + q * m, in + q * fstride * inStride, inStride, fstride * p, stage + 1, childThreads); });
+        for (size_t q = 0; q < p; q += workers)
+            transform(out + q * m, in + q * fstride * inStride, inStride, fstride * p, stage + 1, childThreads);
+        for (std::thread &t : pool)
+            t.join();
+    }
+    else
+    {
+        for (size_t q = 0; q < p; q++)
+            transform(out + q * m, in + q * fstride * inStride, inStride, fstride * p, stage + 1, 1);
+    }
+
+    if (threads > 1 && m * p >= PARALLEL_MIN)
+    {
+        unsigned workers = static_cast<unsigned>(std::min<size_t>(threads, m));
+        std::vector<std::thread> pool;
+        for (unsigned w = 1; w < workers; w++)
+            pool.emplace_back([=]()
+                              { butterfly(out, fstride, p, m, m * w / workers, m * (w + 1) / workers); });
+        butterfly(out, fstride, p, m, 0, m / workers);
+        for (std::thread &t : pool)
+            t.join();
+    }
+    else
+    {
+        butterfly(out, fstride, p, m, 0, m);
+    }
+}
+
+void FftPlan::butterfly(Complex *out, size_t fstride, size_t p, size_t m, size_t begin, size_t end) const
+{
+    const Complex *tw = twiddles.data();
+    switch (p)
+    {
+    case 2:
+        for (size_t u = begin; u < end; u++)
+        {
+            Complex t = out[u + m] * tw[u * fstride];
+            out[u + m] = out[u] - t;
+            out[u] += t;
+        }
+        break;
+    case 3:
+    {
+        const double s = std::sqrt(3.0) / 2.0;
+        for (size_t u = begin; u < end; u++)
+        {
+            Complex a = out[u + m] * tw[u * fstride];
+            Complex b = out[u + 2 * m] * tw[2 * u * fstride];
+            Complex sum = a + b, diff = a - b;
+            Complex mid = out[u] - 0.5 * sum;
+            Complex rot(s * diff.imag(), -s * diff.real());
+            out[u] += sum;
+            out[u + m] = mid + rot;
+            out[u + 2 * m] = mid - rot;
+        }
+        break;
+    }
+    case 4:
+        for (size_t u = begin; u < end; u++)
+        {
+            Complex s0 = out[u + m] * tw[u * fstride];
+            Complex s1 = out[u + 2 * m] * tw[2 * u * fstride];
+            Complex s2 = out[u + 3 * m] * tw[3 * u * fstride];
+            Complex s5 = out[u] - s1;
+            Complex s6 = out[u] + s1;
+            Complex s3 = s0 + s2, s4 = s0 - s2;
+            out[u] = s6 + s3;
+            out[u + 2 * m] = s6 - s3;
+            out[u + m] = Complex(s5.real() + s4.imag(), s5.imag() - s4.real());
+            out[u + 3 * m] = Complex(s5.real() - s4.imag(), s5.imag() + s4.real());
+        }
+        break;
+    default:
+    {
+        // Generic radix-p DFT; the p-th roots of unity are every (n/p)-th twiddle
+        const size_t rootStep = length / p;
+        std::vector<Complex> scratch(p);
+        for (size_t u = begin; u < end; u++)
+        {
+            for (size_t q = 0; q < p; q++)
+                scratch[q] = out[u + q * m] * tw[q * fstride * u];
+            for (size_t k = 0; k < p; k++)
+            {
+                Complex sum = scratch[0];
+                size_t index = 0;
+                for (size_t q = 1; q < p; q++)
+                {
+                    index += k;
+                    if (index >= p)
+                        index -= p;
+                    sum += scratch[q] * tw[index * rootStep];
+                }
+                out[u + k * m] = sum;
+            }
+        }
+        break;
+    }
+    }
+}
+
+RealFftPlan::RealFftPlan(size_t n)
+    : length(n)
+{
+    if (n < 2 || n % 2 != 0)
+        throw std::invalid_argument("Real FFT length must be even");
+    half = FftPlan::get(n / 2);
+    twiddles.resize(n / 2);
+    for (size_t k = 0; k < n / 2; k++)
+        twiddles[k] = std::polar(1.0, -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(n));
+}
+
+void RealFftPlan::forward(const double *in, Complex *out, unsigned threads) const
+{
+    const size_t h = length / 2;
+    std::vector<Complex> packed(h), z(h);
+    for (size_t j = 0; j < h; j++)
+        packed[j] = Complex(in[2 * j], in[2 * j + 1]);
+    half->forward(packed.data(), z.data(), threads);
+
+    out[0] = Complex(z[0].real() + z[0].imag(), 0.0);
+    out[h] = Complex(z[0].real() - z[0].imag(), 0.0);
+    for (size_t k = 1; k < h; k++)
+    {
+        Complex a = z[k], b = std::conj(z[h - k]);
+        Complex even = 0.5 * (a + b);
+        Complex odd = Complex(0.0, -0.5) * (a - b);
+        out[k] = even + twiddles[k] * odd;
+    }
+}
+
+void RealFftPlan::inverse(const Complex *in, double *out, unsigned threads) const
+{
+    const size_t h = length / 2;
+    std::vector<Complex> packed(h), z(h);
+    for (size_t k = 0; k < h; k++)
+    {
+        Complex a = in[k], b = std::conj(in[h - k]);
+        Complex odd = (a - b) * std::conj(twiddles[k]);
+        packed[k] = (a + b) + Complex(-odd.imag(), odd.real());
+    }
+    half->inverse(packed.data(), z.data(), threads);
+    for (size_t j = 0; j < h; j++)
+    {
+        out[2 * j] = z[j].real();
+        out[2 * j + 1] = z[j].imag();
+    }
+}
+
+std::vector<std::complex<double>> realSpectrum(const std::vector<double> &samples, unsigned threads)
+{
+    CALC_PROFILE("realSpectrum");
+    size_t n = samples.size();
+    if (n == 0)
+        throw std::invalid_argument("No samples to transform");
+    std::vector<std::complex<double>> spectrum(n / 2 + 1);
+    if (n % 2 == 0)
+    {
+        RealFftPlan::get(n)->forward(samples.data(), spectrum.data(), threads);
+        return spectrum;
+    }
+    std::vector<std::complex<double>> in(samples.begin(), samples.end()), out(n);
+    FftPlan::get(n)->forward(in.data(), out.data(), threads);
+    std::copy(out.begin(), out.begin() + spectrum.size(), spectrum.begin());
+    return spectrum;
+}
+
+std::vector<double> fftConvolve(const std::vector<double> &a, const std::vector<double> &b, unsigned threads)
+{
+    CALC_PROFILE("fftConvolve");
+    if (a.empty() || b.empty())
+        return std::vector<double>();
+    size_t outLength = a.size() + b.size() - 1;
+    size_t n = 2;
+    while (n < outLength)
+        n <<= 1;
+
+    std::shared_ptr<const RealFftPlan> plan = RealFftPlan::get(n);
+    std::vector<double> padded(n, 0.0);
+    std::vector<std::complex<double>> spectrumA(n / 2 + 1), spectrumB(n / 2 + 1);
+    std::copy(a.begin(), a.end(), padded.begin());
+    plan->forward(padded.data(), spectrumA.data(), threads);
+    std::fill(padded.begin(), padded.end(), 0.0);
+    std::copy(b.begin(), b.end(), padded.begin());
+    plan->forward(padded.data(), spectrumB.data(), threads);
+
+    for (size_t k = 0; k <= n / 2; k++)
+        spectrumA[k] *= spectrumB[k];
+    plan->inverse(spectrumA.data(), padded.data(), threads);
+
+    std::vector<double> result(outLength);
+    for (size_t k = 0; k < outLength; k++)
+        result[k] = padded[k] / static_cast<double>(n);
+    return result;
+}
+
+Matrix matrixProduct(const Matrix &a, const Matrix &b)
+{
+    CALC_PROFILE("matrixProduct");
+    if (a.cols() != b.rows())
+        throw std::invalid_argument("Matrix 1 columns must equal Matrix 2 rows");
+    Matrix result(a.rows(), b.cols(), 0);
+    size_t n = b.cols();
+    for (size_t i = 0; i < a.rows(); i++)
+    {
+        double *row = result.data() + i * n;
+        for (size_t k = 0; k < a.cols(); k++)
+        {
+            double aik = a(i, k);
+            const double *bRow = b.data() + k * n;
+            for (size_t j = 0; j < n; j++)
+                row[j] += aik * bRow[j];
+        }
+    }
+    return result;
+}
+
+Matrix transposed(const Matrix &m)
+{
+    CALC_PROFILE("transposed");
+    Matrix result(m.cols(), m.rows());
+    for (size_t i = 0; i < m.rows(); i++)
+        for (size_t j = 0; j < m.cols(); j++)
+            result(j, i) = m(i, j);
+    return result;
+}
+
+MatrixFileHeader makeMatrixHeader(size_t rows, size_t cols)
+{
+    MatrixFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+    header.version = MATRIX_FILE_VERSION;
+    header.dtype = MATRIX_DTYPE_FLOAT64;
+    header.rows = rows;
+    header.cols = cols;
+    header.dataOffset = sizeof(MatrixFileHeader);
+    header.alignment = MATRIX_FILE_ALIGNMENT;
+    header.endianTag = MATRIX_ENDIAN_TAG;
+    return header;
+}
+
+void validateMatrixHeader(const MatrixFileHeader &header, uint64_t fileSize)
+{
+    if (std::memcmp(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic)) != 0)
+        throw std::runtime_error("Not a binary matrix file");
+    if (header.version != MATRIX_FILE_VERSION)
+        throw std::runtime_error("Unsupported matrix file version");
+    if (header.endianTag != MATRIX_ENDIAN_TAG)
+        throw std::runtime_error("Matrix file was written with a different byte order");
+    if (header.dtype != MATRIX_DTYPE_FLOAT64)
+        throw std::runtime_error("Unsupported matrix element type");
+    if (header.cols != 0 && header.rows > UINT64_MAX / header.cols / sizeof(double))
+        throw std::runtime_error("Matrix dimensions overflow");
+    if (header.dataOffset < sizeof(MatrixFileHeader) || header.dataOffset > fileSize ||
+        fileSize - header.dataOffset < header.rows * header.cols * sizeof(double))
+        throw std::runtime_error("Matrix file is truncated");
+}
+
+void saveMatrixBinary(const Matrix &matrix, const std::string &filename)
+{
+    CALC_PROFILE("saveMatrixBinary");
+    MatrixFileHeader header = makeMatrixHeader(matrix.rows(), matrix.cols());
+    writeFileAtomically(filename, {std::string_view(reinterpret_cast<const char *>(&header), sizeof(header)),
+                                   std::string_view(reinterpret_cast<const char *>(matrix.data()),
+                                                    matrix.size() * sizeof(double))});
+}
+
+bool isBinaryMatrixFile(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(MATRIX_FILE_MAGIC)] = {0};
+    file.read(magic, sizeof(magic));
+    return file && std::memcmp(magic, MATRIX_FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+MappedMatrix::MappedMatrix(const std::string &filename)
+    : base_(nullptr), length_(0), rows_(0), cols_(0), values_(nullptr)
+{
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open '" + filename + "'");
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(MatrixFileHeader))
+    {
+        ::close(fd);
+        throw std::runtime_error("Not a binary matrix file");
+    }
+    length_ = static_cast<size_t>(st.st_size);
+    void *mapped = ::mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        throw std::runtime_error("Cannot map '" + filename + "'");
+    base_ = mapped;
+#else
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        throw std::runtime_error("Cannot open '" + filename + "'");
+    length_ = static_cast<size_t>(file.tellg());
+    if (length_ < sizeof(MatrixFileHeader))
+        throw std::runtime_error("Not a binary matrix file");
+    buffer_.resize((length_ + sizeof(double) - 1) / sizeof(double));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(buffer_.data()), length_);
+    base_ = buffer_.data();
+#endif
+    MatrixFileHeader header;
+    std::memcpy(&header, base_, sizeof(header));
+    try
+    {
+        validateMatrixHeader(header, length_);
+    }
+    catch (...)
+    {
+        release();
+        throw;
+    }
+    rows_ = static_cast<size_t>(header.rows);
+    cols_ = static_cast<size_t>(header.cols);
+    values_ = reinterpret_cast<const double *>(static_cast<const char *>(base_) + header.dataOffset);
+#ifndef _WIN32
+    ::madvise(base_, length_, MADV_SEQUENTIAL);
+#endif
+}
+
+Matrix MappedMatrix::toMatrix() const
+{
+    Matrix m(rows_, cols_);
+    if (m.size())
+        std::memcpy(m.data(), values_, m.size() * sizeof(double));
+    return m;
+}
+
+void MappedMatrix::release()
+{
+#ifndef _WIN32
+    if (base_)
+        ::munmap(base_, length_);
+#endif
+    base_ = nullptr;
+}
+
+Matrix loadMatrixText(const std::string &filename)
+{
+    std::string text;
+    if (!readFileContents(filename, text))
+        throw std::runtime_error("Cannot open '" + filename + "'");
+
+    std::vector<double> values;
+    size_t rows = 0, cols = 0;
+    const char *p = text.c_str();
+    const char *end = p + text.size();
+
+    while (p < end)
+    {
+        const char *lineEnd = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        if (!lineEnd)
+            lineEnd = end;
+
+        // Header and separator lines start with a letter or '='
+        const char *q = p;
+        while (q < lineEnd && (*q == ' ' || *q == '\t' || *q == '\r'))
+            q++;
+        if (q < lineEnd && (std::isalpha(static_cast<unsigned char>(*q)) || *q == '=') &&
+            *q != 'i' && *q != 'I' && *q != 'n' && *q != 'N')
+        {
+            p = lineEnd + 1;
+            continue;
+        }
+
+        size_t count = 0;
+        while (q < lineEnd)
+        {
+            char *next;
+            double v = std::strtod(q, &next);
+            if (next == q || next > lineEnd)
+                break;
+            values.push_back(v);
+            count++;
+            q = next;
+            while (q < lineEnd && (*q == ' ' || *q == '\t' || *q == ',' || *q == '\r'))
+                q++;
+        }
+        if (count > 0 && q < lineEnd)
+        {
+            const char *tokenEnd = q;
+            while (tokenEnd < lineEnd && *tokenEnd != ' ' && *tokenEnd != '\t' && *tokenEnd != ',' && *tokenEnd != '\r')
+                tokenEnd++;
+            throw std::runtime_error("Row " + std::to_string(rows + 1) + ": cannot read '" + std::string(q, tokenEnd) + "'");
+        }
+        if (count > 0)
+        {
+            if (rows == 0)
+                cols = count;
+            else if (count != cols)
+                throw std::runtime_error("Row " + std::to_string(rows) + " has " + std::to_string(count) +
+                                         " values, expected " + std::to_string(cols));
+            rows++;
+        }
+        p = lineEnd + 1;
+    }
+
+    Matrix m(rows, cols);
+    if (!values.empty())
+        std::memcpy(m.data(), values.data(), values.size() * sizeof(double));
+    return m;
+}
+
+Matrix loadMatrixFromFile(const std::string &filename)
+{
+    CALC_PROFILE("loadMatrixFromFile");
+    if (isBinaryMatrixFile(filename))
+        return MappedMatrix(filename).toMatrix();
+    return loadMatrixText(filename);
+}
+
+StatisticsSummary computeStatistics(const std::vector<double> &data, std::pmr::memory_resource *scratch)
+{
+    CALC_PROFILE("computeStatistics");
+    if (data.empty())
+        throw std::invalid_argument("Statistics need at least one value");
+
+    StatisticsSummary s;
+    s.count = data.size();
+    s.sum = 0;
+    for (double num : data)
+        s.sum += num;
+    s.mean = s.sum / s.count;
+    s.variance = 0;
+    for (double num : data)
+        s.variance += (num - s.mean) * (num - s.mean);
+    s.variance /= s.count;
+
+    std::pmr::vector<double> sorted(data.begin(), data.end(), scratch);
+    std::sort(sorted.begin(), sorted.end());
+    s.median = (s.count % 2 == 0) ? (sorted[s.count / 2 - 1] + sorted[s.count / 2]) / 2.0 : sorted[s.count / 2];
+    s.minimum = sorted.front();
+    s.maximum = sorted.back();
+
+    // Equal values are adjacent once sorted, so modes come from run lengths;
+    // the first pass counts them so modes is allocated once
+    size_t maxFreq = 0, modeCount = 0;
+    for (size_t i = 0, run; i < s.count; i += run)
+    {
+        run = 1;
+        while (i + run < s.count && sorted[i + run] == sorted[i])
+            run++;
+        if (run > maxFreq)
+        {
+            maxFreq = run;
+            modeCount = 0;
+        }
+        if (run == maxFreq)
+            modeCount++;
+    }
+    s.modes.reserve(modeCount);
+    for (size_t i = 0, run; i < s.count; i += run)
+    {
+        run = 1;
+        while (i + run < s.count && sorted[i + run] == sorted[i])
+            run++;
+        if (run == maxFreq)
+            s.modes.push_back(sorted[i]);
+    }
+    return s;
+}
+
+void accumulate(CompensatedSum &total, const double *values, size_t n, double sign)
+{
+    // Eight totals at once: no element waits for the previous addition, and
+    // the inner loop maps onto SIMD registers
+    const size_t LANES = 8;
+    double sums[LANES] = {0}, errors[LANES] = {0};
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES)
+    {
+        for (size_t k = 0; k < LANES; k++)
+        {
+            double x = sign * values[i + k];
+            double t = sums[k] + x;
+            double z = t - sums[k];
+            errors[k] += (sums[k] - (t - z)) + (x - z);
+            sums[k] = t;
+        }
+    }
+    for (size_t k = 0; k < LANES; k++)
+    {
+        total.add(sums[k]);
+        total.error += errors[k];
+    }
+    for (; i < n; i++)
+        total.add(sign * values[i]);
+}
+
+void accumulateElements(double *sums, double *errors, const double *values, size_t n, double sign)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        double x = sign * values[i];
+        double t = sums[i] + x;
+        double z = t - sums[i];
+        errors[i] += (sums[i] - (t - z)) + (x - z);
+        sums[i] = t;
+    }
+}
+
+LookupTables::LookupTables(unsigned log2Entries, Interpolation interpolation, const double *sinValues,
+                           const double *log2Values)
+    : log2Entries_(log2Entries), entries_(size_t(1) << log2Entries), interpolation_(interpolation), fracScale_(std::ldexp(1.0, static_cast<int>(log2Entries) - 52))
+{
+    if (log2Entries < MIN_LOG2_ENTRIES || log2Entries > MAX_LOG2_ENTRIES)
+        throw std::invalid_argument("Table size must be between 2^4 and 2^20 entries");
+    if (sinValues && log2Values)
+    {
+        sin_.assign(sinValues, sinValues + tableSize());
+        log2_.assign(log2Values, log2Values + tableSize());
+        return;
+    }
+    sin_.resize(tableSize());
+    log2_.resize(tableSize());
+    for (size_t j = 0; j < tableSize(); j++)
+    {
+        double offset = static_cast<double>(j) - 1.0;
+        sin_[j] = std::sin(2.0 * M_PI * offset / entries_);
+        log2_[j] = std::log2(1.0 + offset / entries_);
+    }
+}
+
+std::unique_ptr<const LookupTables> lookupTables;
+
+double backendSin(double x) { return lookupTables ? lookupTables->sin(x) : std::sin(x); }
+double backendCos(double x) { return lookupTables ? lookupTables->cos(x) : std::cos(x); }
+double backendTan(double x) { return lookupTables ? lookupTables->tan(x) : std::tan(x); }
+double backendLn(double x) { return lookupTables ? lookupTables->ln(x) : std::log(x); }
+double backendLog2(double x) { return lookupTables ? lookupTables->log2(x) : std::log2(x); }
+double backendLog10(double x) { return lookupTables ? lookupTables->log10(x) : std::log10(x); }
+
+double add(double a, double b) { return a + b; }
+double subtract(double a, double b) { return a - b; }
+double multiply(double a, double b) { return a * b; }
+
+double divide(double a, double b)
+{
+    if (b == 0)
+        throw std::domain_error("Division by zero is undefined!");
+    return a / b;
+}
+
+double modulus(double a, double b)
+{
+    if (b == 0)
+        throw std::domain_error("Modulus by zero is undefined!");
+    return std::fmod(a, b);
+}
+
+double percentage(double value, double percent) { return (value * percent) / 100.0; }
+
+double cosecant(double angle)
+{
+    double sinVal = backendSin(angle);
+    if (std::abs(sinVal) < 1e-10)
+        throw std::domain_error("Cosecant undefined (sin = 0)");
+    return 1.0 / sinVal;
+}
+
+double secant(double angle)
+{
+    double cosVal = backendCos(angle);
+    if (std::abs(cosVal) < 1e-10)
+        throw std::domain_error("Secant undefined (cos = 0)");
+    return 1.0 / cosVal;
+}
+
+double cotangent(double angle)
+{
+    double tanVal = backendTan(angle);
+    if (std::abs(tanVal) < 1e-10)
+        throw std::domain_error("Cotangent undefined (tan = 0)");
+    return 1.0 / tanVal;
+}
+
+double arcsine(double x)
+{
+    if (x < -1 || x > 1)
+        throw std::domain_error("Input must be between -1 and 1!");
+    return std::asin(x);
+}
+
+double arccosine(double x)
+{
+    if (x < -1 || x > 1)
+        throw std::domain_error("Input must be between -1 and 1!");
+    return std::acos(x);
+}
+
+double naturalLog(double x)
+{
+    if (x <= 0)
+        throw std::domain_error("Logarithm undefined for non-positive numbers!");
+    return backendLn(x);
+}
+
+double log10Func(double x)
+{
+    if (x <= 0)
+        throw std::domain_error("Logarithm undefined for non-positive numbers!");
+    return backendLog10(x);
+}
+
+double log2Func(double x)
+{
+    if (x <= 0)
+        throw std::domain_error("Logarithm undefined for non-positive numbers!");
+    return backendLog2(x);
+}
+
+double logBase(double x, double base)
+{
+    if (x <= 0)
+        throw std::domain_error("Logarithm undefined for non-positive numbers!");
+    if (base <= 0 || base == 1)
+        throw std::domain_error("Base must be positive and not equal to 1!");
+    return backendLn(x) / backendLn(base);
+}
+
+double squareRoot(double x)
+{
+    if (x < 0)
+        throw std::domain_error("Square root of negative number is complex!");
+    return std::sqrt(x);
+}
+
+double nthRoot(double x, double degree)
+{
+    if (degree == 0)
+        throw std::domain_error("Root degree cannot be zero!");
+    return std::pow(x, 1.0 / degree);
+}
+
+LookupTableReport measureLookupTables(unsigned log2Entries, LookupTables::Interpolation interpolation)
+{
+    const size_t SAMPLES = 200000;
+    LookupTables tables(log2Entries, interpolation);
+    LookupTableReport report = {tables.entries(), tables.bytes(), interpolation, 0.0, 0.0, 0.0};
+
+    // Irrational steps so samples fall at every phase between table points
+    for (size_t k = 0; k < SAMPLES; k++)
+    {
+        double x = 2.0 * M_PI * std::fmod(k * 0.6180339887498949, 1.0);
+        report.sinError = std::max(report.sinError, std::fabs(tables.sin(x) - std::sin(x)));
+        double y = std::exp2(16.0 * std::fmod(k * 0.7548776662466927, 1.0) - 8.0);
+        report.logError = std::max(report.logError, std::fabs(tables.log2(y) - std::log2(y)));
+    }
+
+    report.nsPerCall = nsPerSinLog2Call([&tables](double a) { return tables.sin(a); },
+                                        [&tables](double a) { return tables.log2(a); });
+    return report;
+}
+
+void VectorMath::apply(Function f, const double *in, double *out, size_t n, Accuracy accuracy)
+{
+    if (accuracy == STRICT)
+    {
+        applyLibm(f, in, out, n);
+        return;
+    }
+    switch (f)
+    {
+    case SIN:
+        trig<0, false>(in, out, n);
+        break;
+    case COS:
+        trig<1, false>(in, out, n);
+        break;
+    case TAN:
+        trig<0, true>(in, out, n);
+        break;
+    case EXP:
+        exp(in, out, n);
+        break;
+    case LN:
+        log<LN>(in, out, n);
+        break;
+    case LOG2:
+        log<LOG2>(in, out, n);
+        break;
+    case LOG10:
+        log<LOG10>(in, out, n);
+        break;
+    }
+}
+
+void VectorMath::pow(const double *base, double exponent, double *out, size_t n, Accuracy accuracy)
+{
+    if (accuracy == STRICT)
+    {
+        for (size_t i = 0; i < n; i++)
+            out[i] = std::pow(base[i], exponent);
+        return;
+    }
+    uint64_t outliers = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double x = base[i];
+        double t, tail;
+        scaledLog(x, exponent, t, tail);
+        double e = expCore(t);
+        out[i] = e + e * tail;
+        outliers |= notPositiveNormal(x) | outsideExpRange(t);
+    }
+    if (outliers == 0)
+        return;
+    for (size_t i = 0; i < n; i++)
+    {
+        double x = base[i], t, tail;
+        scaledLog(x, exponent, t, tail);
+        if (notPositiveNormal(x) | outsideExpRange(t))
+            out[i] = std::pow(x, exponent);
+    }
+}
+
+void VectorMath::applyLibm(Function f, const double *in, double *out, size_t n)
+{
+    double (*fn)(double) = nullptr;
+    switch (f)
+    {
+    case SIN:
+        fn = std::sin;
+        break;
+    case COS:
+        fn = std::cos;
+        break;
+    case TAN:
+        fn = std::tan;
+        break;
+    case EXP:
+        fn = std::exp;
+        break;
+    case LN:
+        fn = std::log;
+        break;
+    case LOG2:
+        fn = std::log2;
+        break;
+    case LOG10:
+        fn = std::log10;
+        break;
+    }
+    for (size_t i = 0; i < n; i++)
+        out[i] = fn(in[i]);
+}
+
+void VectorMath::exp(const double *in, double *out, size_t n)
+{
+    uint64_t outliers = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i] = expCore(in[i]);
+        outliers |= outsideExpRange(in[i]);
+    }
+    if (outliers == 0)
+        return;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (outsideExpRange(in[i]))
+            out[i] = std::exp(in[i]);
+    }
+}
+
+std::shared_ptr<const std::vector<uint32_t>> PrimeTable::primesUpTo(uint32_t limit)
+{
+    std::lock_guard<std::mutex> lock(mutex());
+    std::shared_ptr<const std::vector<uint32_t>> &table = current();
+    if (!table || limit > tableLimit())
+    {
+        uint32_t newLimit = std::max<uint32_t>(limit, std::min<uint64_t>(2ULL * tableLimit(), UINT32_MAX));
+        table = build(newLimit);
+        tableLimit() = newLimit;
+    }
+    return table;
+}
+
+std::shared_ptr<const std::vector<uint32_t>> PrimeTable::build(uint32_t limit)
+{
+    // Odd-only byte sieve; the table only ever needs to reach sqrt of a query
+    std::shared_ptr<std::vector<uint32_t>> primes = std::make_shared<std::vector<uint32_t>>();
+    if (limit >= 2)
+        primes->push_back(2);
+    uint64_t half = (static_cast<uint64_t>(limit) + 1) / 2;
+    std::vector<uint8_t> composite(half, 0);
+    for (uint64_t i = 1; i < half; i++)
+    {
+        if (composite[i])
+            continue;
+        uint64_t p = 2 * i + 1;
+        primes->push_back(static_cast<uint32_t>(p));
+        for (uint64_t j = p * p / 2; j < half; j += p)
+            composite[j] = 1;
+    }
+    return primes;
+}
+
+uint32_t integerSqrt(uint64_t n)
+{
+    uint64_t r = static_cast<uint64_t>(std::sqrt(static_cast<double>(n)));
+    while (r * r > n)
+        r--;
+    while ((r + 1) * (r + 1) <= n)
+        r++;
+    return static_cast<uint32_t>(r);
+}
+
+BigInt::BigInt(uint64_t value)
+    : negative_(false)
+{
+    while (value)
+    {
+        limbs_.push_back(static_cast<uint32_t>(value % BASE));
+        value /= BASE;
+    }
+}
+
+BigInt BigInt::fromString(const std::string &text)
+{
+    size_t start = 0;
+    bool negative = false;
+    if (start < text.size() && (text[start] == '-' || text[start] == '+'))
+        negative = text[start++] == '-';
+    if (start == text.size())
+        throw std::invalid_argument("Not an integer: '" + text + "'");
+    for (size_t i = start; i < text.size(); i++)
+        if (!std::isdigit(static_cast<unsigned char>(text[i])))
+            throw std::invalid_argument("Not an integer: '" + text + "'");
+
+    BigInt r;
+    for (size_t end = text.size(); end > start;)
+    {
+        size_t begin = end >= start + BASE_DIGITS ? end - BASE_DIGITS : start;
+        uint32_t limb = 0;
+        for (size_t i = begin; i < end; i++)
+            limb = limb * 10 + static_cast<uint32_t>(text[i] - '0');
+        r.limbs_.push_back(limb);
+        end = begin;
+    }
+    r.trim();
+    r.negative_ = negative && !r.isZero();
+    return r;
+}
+
+std::string BigInt::toString() const
+{
+    if (isZero())
+        return "0";
+    std::string out = negative_ ? "-" : "";
+    out += std::to_string(limbs_.back());
+    char buf[16];
+    for (size_t i = limbs_.size() - 1; i-- > 0;)
+    {
+        std::snprintf(buf, sizeof(buf), "%09u", limbs_[i]);
+        out.append(buf, BASE_DIGITS);
+    }
+    return out;
+}
+
+uint64_t BigInt::toUint64() const
+{
+    uint64_t r = 0;
+    for (size_t i = limbs_.size(); i-- > 0;)
+        r = r * BASE + limbs_[i];
+    return r;
+}
+
+bool operator<(const BigInt &a, const BigInt &b)
+{
+    if (a.negative_ != b.negative_)
+        return a.negative_;
+    int c = BigInt::compareMag(a.limbs_, b.limbs_);
+    return a.negative_ ? c > 0 : c < 0;
+}
+
+BigInt operator+(const BigInt &a, const BigInt &b)
+{
+    if (a.negative_ == b.negative_)
+        return BigInt::make(BigInt::addMag(a.limbs_, b.limbs_), a.negative_);
+    if (BigInt::compareMag(a.limbs_, b.limbs_) >= 0)
+        return BigInt::make(BigInt::subMag(a.limbs_, b.limbs_), a.negative_);
+    return BigInt::make(BigInt::subMag(b.limbs_, a.limbs_), b.negative_);
+}
+
+void BigInt::divMod(const BigInt &a, const BigInt &b, BigInt &quotient, BigInt &remainder)
+{
+    if (b.isZero())
+        throw std::domain_error("Division by zero");
+    std::vector<uint32_t> q, r;
+    divModMag(a.limbs_, b.limbs_, q, r);
+    quotient = make(q, a.negative_ != b.negative_);
+    remainder = make(r, a.negative_);
+}
+
+void BigInt::mulSmall(uint32_t m)
+{
+    uint64_t carry = 0;
+    for (size_t i = 0; i < limbs_.size(); i++)
+    {
+        uint64_t cur = static_cast<uint64_t>(limbs_[i]) * m + carry;
+        limbs_[i] = static_cast<uint32_t>(cur % BASE);
+        carry = cur / BASE;
+    }
+    while (carry)
+    {
+        limbs_.push_back(static_cast<uint32_t>(carry % BASE));
+        carry /= BASE;
+    }
+    trim();
+}
+
+uint32_t BigInt::divSmall(uint32_t d)
+{
+    uint64_t rem = 0;
+    for (size_t i = limbs_.size(); i-- > 0;)
+    {
+        uint64_t cur = limbs_[i] + rem * BASE;
+        limbs_[i] = static_cast<uint32_t>(cur / d);
+        rem = cur % d;
+    }
+    trim();
+    return static_cast<uint32_t>(rem);
+}
+
+BigInt BigInt::product(const std::vector<BigInt> &factors)
+{
+    if (factors.empty())
+        return BigInt(1);
+    std::vector<BigInt> level = factors;
+    while (level.size() > 1)
+    {
+        std::vector<BigInt> next;
+        next.reserve((level.size() + 1) / 2);
+        for (size_t i = 0; i + 1 < level.size(); i += 2)
+            next.push_back(level[i] * level[i + 1]);
+        if (level.size() % 2)
+            next.push_back(level.back());
+        level.swap(next);
+    }
+    return level[0];
+}
+
+BigInt BigInt::gcd(BigInt a, BigInt b)
+{
+    a.negative_ = b.negative_ = false;
+    if (compareMag(a.limbs_, b.limbs_) < 0)
+        std::swap(a, b);
+    while (!b.isZero())
+    {
+        if (a.fitsUint64())
+            return BigInt(gcd64Words(a.toUint64(), b.toUint64()));
+
+        size_t h = a.limbs_.size();
+        int64_t u = static_cast<int64_t>(a.limbs_[h - 1]) * BASE + a.limbs_[h - 2];
+        int64_t v = b.limbs_.size() < h - 1 ? 0
+                                            : static_cast<int64_t>(b.limbs_.size() >= h ? b.limbs_[h - 1] : 0) * BASE + b.limbs_[h - 2];
+        int64_t A = 1, B = 0, C = 0, D = 1;
+        while (v + C != 0 && v + D != 0)
+        {
+            int64_t q = (u + A) / (v + C);
+            if (q != (u + B) / (v + D))
+                break;
+            int64_t t = A - q * C;
+            A = C;
+            C = t;
+            t = B - q * D;
+            B = D;
+            D = t;
+            t = u - q * v;
+            u = v;
+            v = t;
+        }
+
+        if (B == 0)
+        {
+            BigInt r = a % b;
+            a.limbs_.swap(b.limbs_);
+            b.limbs_.swap(r.limbs_);
+        }
+        else
+        {
+            std::vector<uint32_t> na = linearCombination(a.limbs_, A, b.limbs_, B);
+            std::vector<uint32_t> nb = linearCombination(a.limbs_, C, b.limbs_, D);
+            a.limbs_.swap(na);
+            b.limbs_.swap(nb);
+        }
+    }
+    return a;
+}
+
+BigInt BigInt::make(std::vector<uint32_t> &&limbs, bool negative)
+{
+    BigInt r;
+    r.limbs_.swap(limbs);
+    r.trim();
+    r.negative_ = negative && !r.isZero();
+    return r;
+}
+
+void BigInt::trim()
+{
+    while (!limbs_.empty() && limbs_.back() == 0)
+        limbs_.pop_back();
+    if (limbs_.empty())
+        negative_ = false;
+}
+
+uint64_t BigInt::gcd64Words(uint64_t a, uint64_t b)
+{
+    while (b)
+    {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+int BigInt::compareMag(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b)
+{
+    if (a.size() != b.size())
+        return a.size() < b.size() ? -1 : 1;
+    for (size_t i = a.size(); i-- > 0;)
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    return 0;
+}
+
+std::vector<uint32_t> BigInt::addMag(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b)
+{
+    const std::vector<uint32_t> &lo = a.size() < b.size() ? a : b;
+    const std::vector<uint32_t> &hi = a.size() < b.size() ? b : a;
+    std::vector<uint32_t> r(hi.size() + 1);
+    uint32_t carry = 0;
+    for (size_t i = 0; i < hi.size(); i++)
+    {
+        uint32_t s = hi[i] + (i < lo.size() ? lo[i] : 0) + carry;
+        carry = s >= BASE;
+        r[i] = carry ? s - BASE : s;
+    }
+    r[hi.size()] = carry;
+    trimMag(r);
+    return r;
+}
+
+std::vector<uint32_t> BigInt::subMag(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b)
+{
+    std::vector<uint32_t> r(a.size());
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        int64_t d = static_cast<int64_t>(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+        borrow = d < 0;
+        r[i] = static_cast<uint32_t>(d < 0 ? d + BASE : d);
+    }
+    trimMag(r);
+    return r;
+}
+
+void BigInt::addShifted(std::vector<uint32_t> &r, const std::vector<uint32_t> &a, size_t offset)
+{
+    if (r.size() < offset + a.size() + 1)
+        r.resize(offset + a.size() + 1, 0);
+    uint32_t carry = 0;
+    size_t i = 0;
+    for (; i < a.size(); i++)
+    {
+        uint32_t s = r[offset + i] + a[i] + carry;
+        carry = s >= BASE;
+        r[offset + i] = carry ? s - BASE : s;
+    }
+    for (size_t k = offset + i; carry; k++)
+    {
+        if (k == r.size())
+            r.push_back(0);
+        uint32_t s = r[k] + carry;
+        carry = s >= BASE;
+        r[k] = carry ? s - BASE : s;
+    }
+}
+
+std::vector<uint32_t> BigInt::mulSchoolbook(const uint32_t *a, size_t n, const uint32_t *b, size_t m)
+{
+    std::vector<uint32_t> r(n + m, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t ai = a[i];
+        if (ai == 0)
+            continue;
+        uint64_t carry = 0;
+        for (size_t j = 0; j < m; j++)
+        {
+            uint64_t cur = r[i + j] + ai * b[j] + carry;
+            carry = cur / BASE;
+            r[i + j] = static_cast<uint32_t>(cur - carry * BASE);
+        }
+        for (size_t k = i + m; carry; k++)
+        {
+            uint64_t cur = r[k] + carry;
+            carry = cur / BASE;
+            r[k] = static_cast<uint32_t>(cur - carry * BASE);
+        }
+    }
+    trimMag(r);
+    return r;
+}
+
+std::vector<uint32_t> BigInt::slice(const std::vector<uint32_t> &v, size_t begin, size_t end)
+{
+    end = std::min(end, v.size());
+    std::vector<uint32_t> r(v.begin() + std::min(begin, end), v.begin() + end);
+    trimMag(r);
+    return r;
+}
+
+std::vector<uint32_t> BigInt::mulMag(const std::vector<uint32_t> &x, const std::vector<uint32_t> &y)
+{
+    const std::vector<uint32_t> &a = x.size() >= y.size() ? x : y;
+    const std::vector<uint32_t> &b = x.size() >= y.size() ? y : x;
+    if (b.empty())
+        return std::vector<uint32_t>();
+    if (b.size() < KARATSUBA_THRESHOLD)
+        return mulSchoolbook(a.data(), a.size(), b.data(), b.size());
+
+    if (2 * b.size() <= a.size())
+    {
+        // Unbalanced: multiply b by b-sized slices of a
+        std::vector<uint32_t> r;
+        for (size_t offset = 0; offset < a.size(); offset += b.size())
+        {
+            std::vector<uint32_t> part = mulMag(slice(a, offset, offset + b.size()), b);
+            addShifted(r, part, offset);
+        }
+        trimMag(r);
+        return r;
+    }
+
+    size_t k = a.size() / 2;
+    std::vector<uint32_t> a0 = slice(a, 0, k), a1 = slice(a, k, a.size());
+    std::vector<uint32_t> b0 = slice(b, 0, k), b1 = slice(b, k, b.size());
+
+    std::vector<uint32_t> z0 = mulMag(a0, b0);
+    std::vector<uint32_t> z2 = mulMag(a1, b1);
+    std::vector<uint32_t> z1 = mulMag(addMag(a0, a1), addMag(b0, b1));
+    z1 = subMag(subMag(z1, z0), z2);
+
+    std::vector<uint32_t> r(z0);
+    addShifted(r, z1, k);
+    addShifted(r, z2, 2 * k);
+    trimMag(r);
+    return r;
+}
+
+void BigInt::divModMag(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b,
+                       std::vector<uint32_t> &q, std::vector<uint32_t> &r)
+{
+    if (compareMag(a, b) < 0)
+    {
+        q.clear();
+        r = a;
+        return;
+    }
+    if (b.size() == 1)
+    {
+        BigInt t = make(a, false);
+        uint32_t rem = t.divSmall(b[0]);
+        q = t.limbs_;
+        r.assign(rem ? 1 : 0, rem);
+        return;
+    }
+
+    // Normalize so the divisor's top limb is at least BASE / 2
+    uint32_t norm = static_cast<uint32_t>(BASE / (static_cast<uint64_t>(b.back()) + 1));
+    BigInt u = make(a, false), v = make(b, false);
+    u.mulSmall(norm);
+    v.mulSmall(norm);
+    std::vector<uint32_t> &un = u.limbs_;
+    const std::vector<uint32_t> &vn = v.limbs_;
+    size_t n = vn.size();
+    size_t m = un.size() - n;
+    un.push_back(0);
+    q.assign(m + 1, 0);
+
+    uint64_t vTop = vn[n - 1], vNext = vn[n - 2];
+    for (size_t j = m + 1; j-- > 0;)
+    {
+        uint64_t num = static_cast<uint64_t>(un[j + n]) * BASE + un[j + n - 1];
+        uint64_t qhat = num / vTop;
+        uint64_t rhat = num % vTop;
+        while (qhat >= BASE || qhat * vNext > rhat * BASE + un[j + n - 2])
+        {
+            qhat--;
+            rhat += vTop;
+            if (rhat >= BASE)
+                break;
+        }
+
+        // un[j..j+n] -= qhat * vn
+        int64_t borrow = 0;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t p = qhat * vn[i] + carry;
+            carry = p / BASE;
+            int64_t t = static_cast<int64_t>(un[i + j]) - static_cast<int64_t>(p % BASE) - borrow;
+            borrow = t < 0;
+            un[i + j] = static_cast<uint32_t>(t < 0 ? t + BASE : t);
+        }
+        int64_t t = static_cast<int64_t>(un[j + n]) - static_cast<int64_t>(carry) - borrow;
+        if (t < 0)
+        {
+            // qhat was one too large: add the divisor back
+            un[j + n] = static_cast<uint32_t>(t + BASE);
+            qhat--;
+            uint32_t c = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                uint32_t s = un[i + j] + vn[i] + c;
+                c = s >= BASE;
+                un[i + j] = c ? s - BASE : s;
+            }
+            un[j + n] = static_cast<uint32_t>((un[j + n] + c) % BASE);
+        }
+        else
+        {
+            un[j + n] = static_cast<uint32_t>(t);
+        }
+        q[j] = static_cast<uint32_t>(qhat);
+    }
+
+    trimMag(q);
+    un.resize(n);
+    BigInt rem = make(un, false);
+    rem.divSmall(norm);
+    r = rem.limbs_;
+}
+
+std::vector<uint32_t> BigInt::linearCombination(const std::vector<uint32_t> &a, int64_t x,
+                                                const std::vector<uint32_t> &b, int64_t y)
+{
+    const int64_t base = BASE;
+    int64_t xLow = x % base, xHigh = x / base, yLow = y % base, yHigh = y / base;
+    std::vector<uint32_t> r(std::max(a.size(), b.size()) + 3, 0);
+    int64_t carry = 0;
+    for (size_t i = 0; i < r.size(); i++)
+    {
+        int64_t cur = carry;
+        if (i < a.size())
+            cur += xLow * a[i];
+        if (i < b.size())
+            cur += yLow * b[i];
+        if (i >= 1 && i - 1 < a.size())
+            cur += xHigh * a[i - 1];
+        if (i >= 1 && i - 1 < b.size())
+            cur += yHigh * b[i - 1];
+        int64_t digit = cur % base;
+        carry = cur / base;
+        if (digit < 0)
+        {
+            digit += base;
+            carry -= 1;
+        }
+        r[i] = static_cast<uint32_t>(digit);
+    }
+    trimMag(r);
+    return r;
+}
+
+BigInt rangeProduct(uint64_t lo, uint64_t hi)
+{
+    if (lo > hi)
+        return BigInt(1);
+    std::vector<BigInt> leaves;
+    uint64_t acc = 1;
+    for (uint64_t i = lo; i <= hi; i++)
+    {
+        if (acc > UINT64_MAX / i)
+        {
+            leaves.push_back(BigInt(acc));
+            acc = 1;
+        }
+        acc *= i;
+    }
+    leaves.push_back(BigInt(acc));
+    return BigInt::product(leaves);
+}
+
+BigInt bigFactorial(uint64_t n)
+{
+    CALC_PROFILE("bigFactorial");
+    return rangeProduct(2, n);
+}
+
+BigInt bigPermutation(uint64_t n, uint64_t r)
+{
+    if (r > n)
+        return BigInt();
+    if (r == 0)
+        return BigInt(1);
+    return rangeProduct(n - r + 1, n);
+}
+
+BigInt bigBinomial(uint64_t n, uint64_t k)
+{
+    if (k > n)
+        return BigInt();
+    k = std::min(k, n - k);
+    if (k == 0)
+        return BigInt(1);
+    if (n > UINT32_MAX)
+        throw std::out_of_range("Binomial n must fit in 32 bits");
+
+    std::shared_ptr<const std::vector<uint32_t>> primes = PrimeTable::primesUpTo(static_cast<uint32_t>(n));
+    std::vector<BigInt> leaves;
+    uint64_t acc = 1;
+    for (size_t i = 0; i < primes->size() && (*primes)[i] <= n; i++)
+    {
+        uint64_t p = (*primes)[i];
+        int exponent = 0;
+        for (uint64_t pk = p; pk <= n; pk *= p)
+        {
+            exponent += static_cast<int>(n / pk - k / pk - (n - k) / pk);
+            if (pk > n / p)
+                break;
+        }
+        for (int e = 0; e < exponent; e++)
+        {
+            if (acc > UINT64_MAX / p)
+            {
+                leaves.push_back(BigInt(acc));
+                acc = 1;
+            }
+            acc *= p;
+        }
+    }
+    leaves.push_back(BigInt(acc));
+    return BigInt::product(leaves);
+}
+
+int gcd(int a, int b)
+{
+    a = std::abs(a);
+    b = std::abs(b);
+    while (b != 0)
+    {
+        int temp = b;
+        b = a % b;
+        a = temp;
+    }
+    return a;
+}
+
+uint64_t PrimeSieve::countPrimes(uint64_t lo, uint64_t hi, unsigned threads)
+{
+    checkRange(hi);
+    if (lo > hi)
+        return 0;
+
+    uint64_t count = 0;
+    for (uint64_t p = 2; p <= 5; p += (p == 2 ? 1 : 2))
+        if (p >= lo && p <= hi)
+            count++;
+
+    uint64_t firstByte = lo / 30;
+    uint64_t lastByte = hi / 30;
+    uint64_t totalBytes = lastByte - firstByte + 1;
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t segments = (totalBytes + SEGMENT_BYTES - 1) / SEGMENT_BYTES;
+    if (threads > segments)
+        threads = static_cast<unsigned>(segments);
+
+    if (threads <= 1)
+        return count + countBytes(firstByte, lastByte + 1, lo, hi);
+
+    // Whole segments per thread; each worker keeps its own sieving state
+    uint64_t perThread = (segments + threads - 1) / threads * SEGMENT_BYTES;
+    std::vector<uint64_t> partial(threads, 0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+    {
+        uint64_t begin = firstByte + t * perThread;
+        uint64_t end = std::min(lastByte + 1, begin + perThread);
+        if (begin >= end)
+            break;
+        workers.push_back(std::thread([&partial, t, begin, end, lo, hi]()
+                                      { partial[t] = countBytes(begin, end, lo, hi); }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+    for (size_t t = 0; t < partial.size(); t++)
+        count += partial[t];
+    return count;
+}
+
+std::vector<uint64_t> PrimeSieve::primesInRange(uint64_t lo, uint64_t hi)
+{
+    std::vector<uint64_t> primes;
+    forEachPrime(lo, hi, [&primes](uint64_t p)
+                 { primes.push_back(p); });
+    return primes;
+}
+
+uint64_t PrimeSieve::countBytes(uint64_t begin, uint64_t end, uint64_t lo, uint64_t hi)
+{
+    Segmenter sieve(begin, end, hi);
+    uint64_t count = 0;
+    while (sieve.next())
+    {
+        const uint8_t *bits = sieve.bits();
+        size_t len = sieve.segmentLength();
+        size_t b = 0;
+        for (; b + 8 <= len; b += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, bits + b, sizeof(word));
+            count += static_cast<uint64_t>(popCount(word));
+        }
+        for (; b < len; b++)
+            count += static_cast<uint64_t>(popCount(bits[b]));
+
+        // Remove wheel slots outside [lo, hi] in the edge bytes
+        uint64_t first = sieve.segmentStart();
+        uint64_t last = first + len - 1;
+        if (first <= lo / 30)
+            count -= edgeBits(bits[lo / 30 - first], lo / 30, lo, hi);
+        if (last >= hi / 30 && hi / 30 != lo / 30)
+            count -= edgeBits(bits[hi / 30 - first], hi / 30, lo, hi);
+    }
+    return count;
+}
+
+uint64_t PrimeSieve::edgeBits(uint8_t byte, uint64_t index, uint64_t lo, uint64_t hi)
+{
+    uint64_t outside = 0;
+    for (int c = 0; c < 8; c++)
+    {
+        uint64_t n = 30 * index + WHEEL30_RESIDUES[c];
+        if ((byte >> c & 1) && (n < lo || n > hi))
+            outside++;
+    }
+    return outside;
+}
+
+Montgomery64::Montgomery64(uint64_t n)
+    : n_(n)
+{
+    // Newton iteration for n^-1 mod 2^64; each step doubles the correct bits
+    uint64_t inv = n;
+    for (int i = 0; i < 5; i++)
+        inv *= 2 - n * inv;
+    nInv_ = inv;
+    one_ = (0 - n) % n;
+    // 2^128 mod n by doubling 2^64 mod n 64 times, without a 128-bit division
+    r2_ = one_;
+    for (int i = 0; i < 64; i++)
+        r2_ = add(r2_, r2_);
+}
+
+uint64_t Montgomery64::pow(uint64_t base, uint64_t exponent) const
+{
+    uint64_t result = one_;
+    while (exponent)
+    {
+        if (exponent & 1)
+            result = mul(result, base);
+        base = mul(base, base);
+        exponent >>= 1;
+    }
+    return result;
+}
+
+bool millerRabinRound(const Montgomery64 &mont, uint64_t base, uint64_t d, int s)
+{
+    uint64_t n = mont.modulus();
+    base %= n;
+    if (base == 0)
+        return true;
+    uint64_t minusOne = n - mont.one();
+    uint64_t x = mont.pow(mont.toMont(base), d);
+    if (x == mont.one() || x == minusOne)
+        return true;
+    for (int r = 1; r < s; r++)
+    {
+        x = mont.mul(x, x);
+        if (x == minusOne)
+            return true;
+        if (x == mont.one())
+            return false;
+    }
+    return false;
+}
+
+bool isPrime(uint64_t n)
+{
+    if (n < 2)
+        return false;
+    static const uint32_t SMALL_PRIMES[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    for (size_t i = 0; i < sizeof(SMALL_PRIMES) / sizeof(SMALL_PRIMES[0]); i++)
+    {
+        if (n == SMALL_PRIMES[i])
+            return true;
+        if (n % SMALL_PRIMES[i] == 0)
+            return false;
+    }
+    if (n < 37 * 37)
+        return true;
+
+    uint64_t d = n - 1;
+    int s = countTrailingZeros(d);
+    d >>= s;
+    Montgomery64 mont(n);
+
+    if (n < (1ULL << 32))
+    {
+        static const uint64_t BASES32[] = {2, 7, 61};
+        for (size_t i = 0; i < 3; i++)
+            if (!millerRabinRound(mont, BASES32[i], d, s))
+                return false;
+        return true;
+    }
+
+    static const uint64_t BASES64[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+    for (size_t i = 0; i < 7; i++)
+        if (!millerRabinRound(mont, BASES64[i], d, s))
+            return false;
+    return true;
+}
+
+void isPrimeBatch(const uint64_t *values, size_t count, uint8_t *out, unsigned threads)
+{
+    CALC_PROFILE("isPrimeBatch");
+    const size_t MIN_PER_THREAD = 1 << 14;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, (count + MIN_PER_THREAD - 1) / MIN_PER_THREAD));
+
+    if (threads <= 1)
+    {
+        for (size_t i = 0; i < count; i++)
+            out[i] = isPrime(values[i]);
+        return;
+    }
+
+    size_t chunk = (count + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+    {
+        size_t begin = t * chunk;
+        size_t end = std::min(count, begin + chunk);
+        workers.push_back(std::thread([values, out, begin, end]()
+                                      {
+                                          for (size_t i = begin; i < end; i++)
+                                              out[i] = isPrime(values[i]);
+                                      }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+}
+
+uint64_t gcd64(uint64_t a, uint64_t b)
+{
+    if (a == 0)
+        return b;
+    if (b == 0)
+        return a;
+    int shift = countTrailingZeros(a | b);
+    a >>= countTrailingZeros(a);
+    while (b)
+    {
+        b >>= countTrailingZeros(b);
+        if (a > b)
+            std::swap(a, b);
+        b -= a;
+    }
+    return a << shift;
+}
+
+uint64_t pollardBrent(uint64_t n)
+{
+    const uint64_t BLOCK = 128;
+    Montgomery64 mont(n);
+    for (uint64_t c = 1;; c++)
+    {
+        uint64_t cm = mont.toMont(c);
+        uint64_t y = mont.toMont(2), x = y, ys = y, q = mont.one();
+        uint64_t g = 1;
+        for (uint64_t r = 1; g == 1; r <<= 1)
+        {
+            x = y;
+            for (uint64_t i = 0; i < r; i++)
+                y = mont.add(mont.mul(y, y), cm);
+            for (uint64_t k = 0; k < r && g == 1; k += BLOCK)
+            {
+                ys = y;
+                uint64_t steps = std::min(BLOCK, r - k);
+                for (uint64_t i = 0; i < steps; i++)
+                {
+                    y = mont.add(mont.mul(y, y), cm);
+                    q = mont.mul(q, x > y ? x - y : y - x);
+                }
+                g = gcd64(q, n);
+            }
+        }
+        if (g == n)
+        {
+            // The batched product hit zero; step back one value at a time
+            do
+            {
+                ys = mont.add(mont.mul(ys, ys), cm);
+                g = gcd64(x > ys ? x - ys : ys - x, n);
+            } while (g == 1);
+        }
+        if (g != n)
+            return g;
+    }
+}
+
+void factorInto(uint64_t n, std::vector<uint64_t> &primes)
+{
+    if (n == 1)
+        return;
+    if (isPrime(n))
+    {
+        primes.push_back(n);
+        return;
+    }
+    uint64_t d = pollardBrent(n);
+    factorInto(d, primes);
+    factorInto(n / d, primes);
+}
+
+std::vector<std::pair<uint64_t, int>> primeFactorization(uint64_t n)
+{
+    CALC_PROFILE("primeFactorization");
+    std::vector<std::pair<uint64_t, int>> factors;
+    if (n < 2)
+        return factors;
+
+    std::shared_ptr<const std::vector<uint32_t>> table = PrimeTable::primesUpTo(1 << 10);
+    for (size_t i = 0; i < table->size() && (*table)[i] <= (1u << 10); i++)
+    {
+        uint64_t p = (*table)[i];
+        if (p * p > n)
+            break;
+        if (n % p != 0)
+            continue;
+        int exponent = 0;
+        while (n % p == 0)
+        {
+            n /= p;
+            exponent++;
+        }
+        factors.push_back(std::make_pair(p, exponent));
+    }
+
+    std::vector<uint64_t> large;
+    factorInto(n, large);
+    std::sort(large.begin(), large.end());
+    for (size_t i = 0; i < large.size(); i++)
+    {
+        if (!factors.empty() && factors.back().first == large[i])
+            factors.back().second++;
+        else
+            factors.push_back(std::make_pair(large[i], 1));
+    }
+    return factors;
+}
+
+std::vector<uint64_t> divisorsFromFactors(const std::vector<std::pair<uint64_t, int>> &factors)
+{
+    std::vector<uint64_t> divisors(1, 1);
+    for (size_t i = 0; i < factors.size(); i++)
+    {
+        size_t count = divisors.size();
+        uint64_t power = 1;
+        for (int e = 0; e < factors[i].second; e++)
+        {
+            power *= factors[i].first;
+            for (size_t k = 0; k < count; k++)
+                divisors.push_back(divisors[k] * power);
+        }
+    }
+    std::sort(divisors.begin(), divisors.end());
+    return divisors;
+}
+
+std::vector<std::complex<double>> PolynomialSolver::roots(std::vector<double> c)
+{
+    typedef std::complex<double> Complex;
+    size_t lead = 0;
+    while (lead < c.size() && c[lead] == 0.0)
+        lead++;
+    if (lead == c.size())
+        throw std::invalid_argument("Polynomial is identically zero");
+    c.erase(c.begin(), c.begin() + lead);
+
+    std::vector<Complex> result;
+    while (c.size() > 1 && c.back() == 0.0)
+    {
+        result.push_back(Complex(0.0, 0.0));
+        c.pop_back();
+    }
+    const size_t n = c.size() - 1;
+    for (size_t k = 1; k <= n; k++)
+        c[k] /= c[0];
+    c[0] = 1.0;
+
+    if (n == 1)
+    {
+        result.push_back(Complex(0.0 - c[1], 0.0));
+    }
+    else if (n == 2)
+    {
+        double r1, i1, r2, i2;
+        quadraticCore(1.0, c[1], c[2], r1, i1, r2, i2);
+        result.push_back(Complex(r1, i1));
+        result.push_back(Complex(r2, i2));
+    }
+    else if (n > 2)
+    {
+        std::vector<Complex> z = aberth(c);
+        result.insert(result.end(), z.begin(), z.end());
+    }
+    std::sort(result.begin(), result.end(), [](const Complex &a, const Complex &b)
+              { return a.real() != b.real() ? a.real() < b.real() : a.imag() < b.imag(); });
+    return result;
+}
+
+void PolynomialSolver::solve(PolynomialBatch &batch, unsigned threads)
+{
+    const size_t MIN_PER_THREAD = 1 << 14;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, (batch.count + MIN_PER_THREAD - 1) / MIN_PER_THREAD));
+    if (threads <= 1)
+    {
+        solveRange(batch, 0, batch.count);
+        return;
+    }
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back([&batch, t, threads]()
+                          { solveRange(batch, batch.count * t / threads, batch.count * (t + 1) / threads); });
+    solveRange(batch, 0, batch.count / threads);
+    for (std::thread &worker : pool)
+        worker.join();
+}
+
+void PolynomialSolver::solveOne(PolynomialBatch &batch, size_t i)
+{
+    // Zero leading coefficients lower the degree, and the closed form of the
+    // lower degree is tried before Aberth: a x^2 + b x + c with a = 0 is -c / b
+    unsigned lead = 0;
+    while (lead < batch.degree && batch.coeff[lead][i] == 0.0)
+        lead++;
+    const unsigned lowered = batch.degree - lead;
+    std::vector<Complex> z;
+    if (lead > 0 && lowered >= 1 && lowered <= 4)
+    {
+        double m[4], re[4], im[4];
+        double inverse = 1.0 / batch.coeff[lead][i];
+        for (unsigned k = 0; k < lowered; k++)
+            m[k] = batch.coeff[lead + 1 + k][i] * inverse;
+        uint64_t bad;
+        switch (lowered)
+        {
+        case 1:
+            re[0] = 0.0 - m[0];
+            im[0] = 0.0;
+            bad = nonFiniteMask(re[0]);
+            break;
+        case 2:
+            bad = closedForm<2>(m, re, im);
+            break;
+        case 3:
+            bad = closedForm<3>(m, re, im);
+            break;
+        default:
+            bad = closedForm<4>(m, re, im);
+            break;
+        }
+        if (bad == 0)
+        {
+            for (unsigned k = 0; k < lowered; k++)
+                z.push_back(Complex(re[k], im[k]));
+        }
+    }
+    if (z.empty())
+    {
+        std::vector<double> c(batch.degree + 1);
+        for (unsigned k = 0; k <= batch.degree; k++)
+            c[k] = batch.coeff[k][i];
+        try
+        {
+            z = roots(c);
+        }
+        catch (const std::invalid_argument &)
+        {
+        }
+    }
+    // Equations of lower effective degree report NaN for the missing roots
+    for (unsigned k = 0; k < batch.degree; k++)
+    {
+        Complex root = k < z.size() ? z[k] : Complex(NAN, NAN);
+        batch.re[k][i] = root.real();
+        batch.im[k][i] = root.imag();
+    }
+}
+
+void PolynomialSolver::solveRange(PolynomialBatch &batch, size_t begin, size_t end)
+{
+    switch (batch.degree)
+    {
+    case 2:
+        solveClosedForm<2>(batch, begin, end);
+        break;
+    case 3:
+        solveClosedForm<3>(batch, begin, end);
+        break;
+    case 4:
+        solveClosedForm<4>(batch, begin, end);
+        break;
+    default:
+        for (size_t i = begin; i < end; i++)
+            solveOne(batch, i);
+        break;
+    }
+}
+
+std::vector<PolynomialSolver::Complex> PolynomialSolver::aberth(const std::vector<double> &c)
+{
+    const size_t n = c.size() - 1;
+    const int MAX_ITERATIONS = 500;
+    double radius = 0.0;
+    for (size_t k = 1; k <= n; k++)
+    {
+        double term = std::pow(std::fabs(c[k]) / (k == n ? 2.0 : 1.0), 1.0 / static_cast<double>(k));
+        radius = std::max(radius, 2.0 * term);
+    }
+    if (radius == 0.0)
+        radius = 1.0;
+
+    std::vector<Complex> z(n);
+    std::vector<bool> done(n, false);
+    for (size_t k = 0; k < n; k++)
+        z[k] = std::polar(radius, 2.0 * M_PI * static_cast<double>(k) / static_cast<double>(n) + 0.4);
+
+    for (int iteration = 0; iteration < MAX_ITERATIONS; iteration++)
+    {
+        bool converged = true;
+        for (size_t k = 0; k < n; k++)
+        {
+            if (done[k])
+                continue;
+            Complex p = 1.0, dp = 0.0;
+            double bound = 1.0, modulus = std::abs(z[k]);
+            for (size_t j = 1; j <= n; j++)
+            {
+                dp = dp * z[k] + p;
+                p = p * z[k] + c[j];
+                bound = bound * modulus + std::fabs(c[j]);
+            }
+            if (std::abs(p) <= 4.0 * std::numeric_limits<double>::epsilon() * bound)
+            {
+                done[k] = true;
+                continue;
+            }
+            converged = false;
+            Complex ratio = p / dp, repulsion = 0.0;
+            for (size_t j = 0; j < n; j++)
+            {
+                if (j != k)
+                    repulsion += 1.0 / (z[k] - z[j]);
+            }
+            z[k] -= ratio / (1.0 - ratio * repulsion);
+        }
+        if (converged)
+            break;
+    }
+    // Real roots keep an imaginary part at rounding level
+    for (Complex &root : z)
+    {
+        if (std::fabs(root.imag()) <= 8.0 * std::numeric_limits<double>::epsilon() * std::abs(root))
+            root.imag(0.0);
+    }
+    return z;
+}
+
+char *RadixConverter::formatUnsigned(uint64_t value, int base, char *bufEnd)
+{
+    char *p = bufEnd;
+    if (value == 0)
+    {
+        *--p = '0';
+        return p;
+    }
+    if ((base & (base - 1)) == 0)
+    {
+        int shift = countTrailingZeros(static_cast<uint64_t>(base));
+        uint64_t mask = static_cast<uint64_t>(base) - 1;
+        while (value)
+        {
+            *--p = RADIX_DIGITS[value & mask];
+            value >>= shift;
+        }
+        return p;
+    }
+    if (base == 10)
+    {
+        const char *pairs = decimalPairs();
+        while (value >= 100)
+        {
+            uint64_t pair = value % 100;
+            value /= 100;
+            p -= 2;
+            std::memcpy(p, pairs + 2 * pair, 2);
+        }
+        if (value >= 10)
+        {
+            p -= 2;
+            std::memcpy(p, pairs + 2 * value, 2);
+        }
+        else
+        {
+            *--p = static_cast<char>('0' + value);
+        }
+        return p;
+    }
+    while (value)
+    {
+        *--p = RADIX_DIGITS[value % base];
+        value /= base;
+    }
+    return p;
+}
+
+char *RadixConverter::formatSigned(int64_t value, int base, char *bufEnd)
+{
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    char *p = formatUnsigned(magnitude, base, bufEnd);
+    if (value < 0)
+        *--p = '-';
+    return p;
+}
+
+std::string RadixConverter::toString(int64_t value, int base)
+{
+    checkBase(base);
+    char buf[MAX_DIGITS];
+    char *end = buf + sizeof(buf);
+    return std::string(formatSigned(value, base, end), end);
+}
+
+std::string RadixConverter::toString(const BigInt &value, int base)
+{
+    checkBase(base);
+    if (base == 10)
+        return value.toString();
+    if (value.fitsUint64())
+    {
+        char buf[MAX_DIGITS];
+        char *end = buf + sizeof(buf);
+        return std::string(formatUnsigned(value.toUint64(), base, end), end);
+    }
+
+    // Powers up to the first whose square exceeds value
+    std::vector<BigInt> powers = chunkPowers(base);
+    while (2 * powers.back().limbs().size() - 2 < value.limbs().size())
+        powers.push_back(powers.back() * powers.back());
+    std::string out = value.isNegative() ? "-" : "";
+    appendBig(value.abs(), base, powers, static_cast<int>(powers.size()) - 1, false, out);
+    return out;
+}
+
+int64_t RadixConverter::parseSigned(const char *begin, const char *end, int base)
+{
+    checkBase(base);
+    bool negative = begin < end && *begin == '-';
+    if (begin < end && (*begin == '-' || *begin == '+'))
+        begin++;
+    uint64_t magnitude = parseUnsigned(begin, end, base);
+    uint64_t limit = negative ? (1ULL << 63) : (1ULL << 63) - 1;
+    if (magnitude > limit)
+        throw std::out_of_range("Value does not fit in 64 bits");
+    return negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+}
+
+uint64_t RadixConverter::parseUnsigned(const char *begin, const char *end, int base)
+{
+    checkBase(base);
+    if (begin == end)
+        throw std::invalid_argument("Empty number");
+    const uint8_t *values = digitValues();
+    uint64_t result = 0;
+    for (const char *p = begin; p < end; p++)
+    {
+        uint8_t d = values[static_cast<unsigned char>(*p)];
+        if (d >= base)
+            throw std::invalid_argument(std::string("Invalid digit '") + *p + "' for base " + std::to_string(base));
+        if (result > (UINT64_MAX - d) / base)
+            throw std::out_of_range("Value does not fit in 64 bits");
+        result = result * base + d;
+    }
+    return result;
+}
+
+BigInt RadixConverter::parseBig(const std::string &text, int base)
+{
+    checkBase(base);
+    size_t start = 0;
+    bool negative = !text.empty() && text[0] == '-';
+    if (!text.empty() && (text[0] == '-' || text[0] == '+'))
+        start = 1;
+    if (start == text.size())
+        throw std::invalid_argument("Empty number");
+    if (base == 10)
+        return BigInt::fromString(text);
+
+    const char *digits = text.c_str() + start;
+    size_t length = text.size() - start;
+    std::vector<BigInt> powers = chunkPowers(base);
+    for (size_t span = chunkDigits(base); span * 2 < length; span *= 2)
+        powers.push_back(powers.back() * powers.back());
+    BigInt value = parseRange(digits, length, base, powers);
+    return negative ? BigInt() - value : value;
+}
+
+void RadixConverter::formatBatch(const int64_t *values, size_t count, int base, char separator, std::string &out)
+{
+    checkBase(base);
+    char buf[MAX_DIGITS];
+    char *end = buf + sizeof(buf);
+    size_t width = base >= 16 ? 17 : (base >= 8 ? 23 : 66);
+    out.reserve(out.size() + count * width / 2);
+    for (size_t i = 0; i < count; i++)
+    {
+        char *p = formatSigned(values[i], base, end);
+        out.append(p, end);
+        out += separator;
+    }
+}
+
+size_t RadixConverter::parseBatch(const char *text, size_t length, int base, std::vector<int64_t> &out)
+{
+    checkBase(base);
+    const char *p = text, *end = text + length;
+    size_t before = out.size();
+    while (p < end)
+    {
+        while (p < end && isBatchSeparator(*p))
+            p++;
+        const char *tokenStart = p;
+        while (p < end && !isBatchSeparator(*p))
+            p++;
+        if (p == tokenStart)
+            break;
+        try
+        {
+            out.push_back(parseSigned(tokenStart, p, base));
+        }
+        catch (const std::invalid_argument &e)
+        {
+            throw std::invalid_argument("Value " + std::to_string(out.size() - before + 1) + " '" +
+                                        std::string(tokenStart, p) + "': " + e.what());
+        }
+    }
+    return out.size() - before;
+}
+
+const char *RadixConverter::decimalPairs()
+{
+    static const std::string pairs = []()
+    {
+        std::string s;
+        for (int i = 0; i < 100; i++)
+        {
+            s += static_cast<char>('0' + i / 10);
+            s += static_cast<char>('0' + i % 10);
+        }
+        return s;
+    }();
+    return pairs.data();
+}
+
+const uint8_t *RadixConverter::digitValues()
+{
+    static const std::vector<uint8_t> table = []()
+    {
+        std::vector<uint8_t> t(256, RADIX_INVALID);
+        for (int i = 0; i < 36; i++)
+        {
+            t[static_cast<unsigned char>(RADIX_DIGITS[i])] = static_cast<uint8_t>(i);
+            t[static_cast<unsigned char>(std::tolower(RADIX_DIGITS[i]))] = static_cast<uint8_t>(i);
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+int RadixConverter::chunkDigits(int base)
+{
+    int k = 0;
+    for (uint64_t p = 1; p <= 1000000000000000000ULL / base; p *= base)
+        k++;
+    return k;
+}
+
+std::vector<BigInt> RadixConverter::chunkPowers(int base)
+{
+    uint64_t chunk = 1;
+    for (int i = 0, k = chunkDigits(base); i < k; i++)
+        chunk *= base;
+    return std::vector<BigInt>(1, BigInt(chunk));
+}
+
+void RadixConverter::appendBig(const BigInt &value, int base, const std::vector<BigInt> &powers,
+                               int level, bool pad, std::string &out)
+{
+    if (level < 0)
+    {
+        char buf[MAX_DIGITS];
+        char *end = buf + sizeof(buf);
+        char *p = formatUnsigned(value.toUint64(), base, end);
+        if (pad)
+            out.append(static_cast<size_t>(chunkDigits(base)) - (end - p), '0');
+        out.append(p, end);
+        return;
+    }
+    if (!pad && value < powers[level])
+    {
+        appendBig(value, base, powers, level - 1, false, out);
+        return;
+    }
+    BigInt high, low;
+    BigInt::divMod(value, powers[level], high, low);
+    appendBig(high, base, powers, level - 1, pad, out);
+    appendBig(low, base, powers, level - 1, true, out);
+}
+
+BigInt RadixConverter::parseRange(const char *digits, size_t length, int base, const std::vector<BigInt> &powers)
+{
+    size_t chunk = static_cast<size_t>(chunkDigits(base));
+    if (length <= chunk)
+        return BigInt(parseUnsigned(digits, digits + length, base));
+
+    // Split so the low part is a whole power-of-two number of chunks
+    int level = 0;
+    while ((chunk << (level + 1)) < length)
+        level++;
+    size_t lowLength = chunk << level;
+    BigInt high = parseRange(digits, length - lowLength, base, powers);
+    BigInt low = parseRange(digits + length - lowLength, lowLength, base, powers);
+    return high * powers[level] + low;
+}
+
+const UnitConversion &unitConversion(size_t from, size_t to)
+{
+    if (from >= UNIT_COUNT || to >= UNIT_COUNT || !UNIT_CONVERSIONS[from][to].valid)
+        throw std::invalid_argument("Units measure different quantities");
+    return UNIT_CONVERSIONS[from][to];
+}
+
+double convertUnit(double value, size_t from, size_t to)
+{
+    const UnitConversion &c = unitConversion(from, to);
+    return (value - c.zeroFrom) * c.factor + c.zeroTo;
+}
+
+void convertUnitArray(const double *in, double *out, size_t count, size_t from, size_t to)
+{
+    const UnitConversion &c = unitConversion(from, to);
+    const double zeroFrom = c.zeroFrom, factor = c.factor, zeroTo = c.zeroTo;
+    for (size_t i = 0; i < count; i++)
+        out[i] = (in[i] - zeroFrom) * factor + zeroTo;
+}
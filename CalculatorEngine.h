@@ -0,0 +1,3277 @@
+// Calculator engine
+// The computational kernels behind the calculator, free of console I/O:
+// number types (BigFloat, DoubleDouble, Interval), the expression compiler
+// with automatic differentiation, complex and FFT kernels, matrices, vector
+// math, big integers and primes, polynomial roots, radix and unit
+// conversion. Calculator.cpp is the interactive front end; other programs
+// link the engine directly, e.g. as a static library:
+//
+//   g++ -std=c++17 -pthread -O2 -c CalculatorEngine.cpp
+//   ar rcs libcalculatorengine.a CalculatorEngine.o
+//
+// Errors are reported by exceptions, never printed. Shared caches (FFT plans,
+// prime tables, ln 2) are guarded by mutexes and scratch buffers are
+// thread_local, so kernels may be called from several threads at once with
+// one exception: two process-wide settings are plain unsynchronized globals.
+// lookupTables selects the backend of the scalar trig and log kernels and
+// BigFloat::defaultPrecision the precision of BigFloats built without one;
+// both are read on every such call, so changing either while another thread
+// runs those kernels changes (or, for lookupTables, frees) what it is using.
+// Set them while no other thread calls into the engine. The scalar kernels
+// never allocate; batch kernels write into caller buffers.
+#ifndef CALCULATOR_ENGINE_H
+#define CALCULATOR_ENGINE_H
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <charconv>
+#include <array>
+#include <complex>
+#include <sstream>
+#include <fstream>
+#include <cctype>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <ctime>
+#include <chrono>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#ifdef CALC_INSTRUMENT
+#include <atomic>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+// Compiler portability
+// GCC and Clang builtins, MSVC intrinsics, and portable C++ for anything else
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CALC_ALWAYS_INLINE __forceinline
+#define CALC_NOINLINE __declspec(noinline)
+#else
+#define CALC_ALWAYS_INLINE __attribute__((always_inline)) inline
+#define CALC_NOINLINE __attribute__((noinline))
+#endif
+
+// MSVC's <cmath> only defines these with _USE_MATH_DEFINES
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#ifndef M_PI_2
+#define M_PI_2 1.57079632679489661923
+#endif
+#ifndef M_LN2
+#define M_LN2 0.693147180559945309417
+#endif
+#ifndef M_LN10
+#define M_LN10 2.30258509299404568402
+#endif
+
+// Index of the lowest set bit; x must not be 0
+inline int countTrailingZeros(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<int>(index);
+#else
+    int n = 0;
+    for (; !(x & 1); x >>= 1)
+        n++;
+    return n;
+#endif
+}
+
+// Index of the highest set bit, floor(log2 x); x must not be 0
+inline int highestSetBit(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(x);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return static_cast<int>(index);
+#else
+    int n = 0;
+    while (x >>= 1)
+        n++;
+    return n;
+#endif
+}
+
+inline int popCount(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#else
+    // Bit counts of 2, 4 and 8 bits side by side, then summed by one multiply
+    x -= (x >> 1) & 0x5555555555555555ULL;
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return static_cast<int>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// High 64 bits of the 128-bit product a * b
+inline uint64_t mulHigh(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 uint128_t;
+    return static_cast<uint64_t>((static_cast<uint128_t>(a) * b) >> 64);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    return __umulh(a, b);
+#else
+    // Schoolbook on 32-bit halves; mid cannot overflow
+    uint64_t aLo = a & 0xffffffffULL, aHi = a >> 32, bLo = b & 0xffffffffULL, bHi = b >> 32;
+    uint64_t lowLow = aLo * bLo, lowHigh = aLo * bHi, highLow = aHi * bLo;
+    uint64_t mid = (lowLow >> 32) + (lowHigh & 0xffffffffULL) + (highLow & 0xffffffffULL);
+    return aHi * bHi + (lowHigh >> 32) + (highLow >> 32) + (mid >> 32);
+#endif
+}
+
+// File helpers
+// Reads a whole file with one call; returns false if it cannot be opened
+bool readFileContents(const std::string &filename, std::string &text);
+
+// Every number in text, skipping separators and anything strtod cannot read
+std::vector<double> parseNumbers(const std::string &text);
+
+// Replaces filename with the parts written back to back. They go to a
+// temporary file beside it that is synced and renamed over the old one, so a
+// reader or a crash sees the old file or the new one, never a partial one
+void writeFileAtomically(const std::string &filename, const std::vector<std::string_view> &parts);
+
+// Read-only view of a whole file. On POSIX the file is mapped; elsewhere it
+// is read into memory. The data is aligned for doubles.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &filename);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    std::vector<double> buffer_;
+#endif
+};
+
+// Memory arena
+// Bump allocator for the temporaries of one command, one expression or one
+// batch item, usable by any std::pmr container. Allocating moves a pointer,
+// deallocating does nothing, and reset() recycles everything at once. Blocks
+// are kept across resets, so a warm arena does not call malloc at all; an
+// arena that grew past RETAINED_BYTES gives the extra blocks back on reset.
+// Not synchronized, and everything allocated must be dead before reset().
+class Arena : public std::pmr::memory_resource
+{
+public:
+    static constexpr size_t RETAINED_BYTES = 1 << 20;
+
+    explicit Arena(size_t blockSize = 16 * 1024) : blockSize(blockSize) {}
+    ~Arena() override;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void reset();
+
+    // Bytes held in blocks, in use or not
+    size_t capacity() const { return heldBytes; }
+
+private:
+    struct Block
+    {
+        char *begin;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0; // Block that next points into
+    char *next = nullptr;
+    char *end = nullptr;
+    size_t blockSize;
+    size_t heldBytes = 0;
+
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(next) + alignment - 1) & ~uintptr_t(alignment - 1);
+        if (next && p + bytes <= reinterpret_cast<uintptr_t>(end))
+        {
+            next = reinterpret_cast<char *>(p + bytes);
+            return reinterpret_cast<void *>(p);
+        }
+        return allocateFromNextBlock(bytes, alignment);
+    }
+
+    void do_deallocate(void *, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+    void *allocateFromNextBlock(size_t bytes, size_t alignment);
+};
+
+// Number formatting
+// Every result that is printed or saved goes through formatNumber, which uses
+// std::to_chars: SHORTEST gives the fewest digits that read back as the same
+// double, FIXED and SCIENTIFIC take a digit count like printf. It is several
+// times faster than iostreams or printf and never allocates.
+enum class NumberStyle
+{
+    SHORTEST,
+    FIXED,
+    SCIENTIFIC
+};
+
+struct NumberFormat
+{
+    NumberStyle style = NumberStyle::SHORTEST;
+    int precision = 6; // Digits after the point for FIXED and SCIENTIFIC
+};
+
+constexpr int MAX_FORMAT_PRECISION = 30;
+constexpr size_t MAX_FORMATTED_LENGTH = 352; // Fixed -1.8e308 with MAX_FORMAT_PRECISION digits
+
+// Writes value to out, which must have room for MAX_FORMATTED_LENGTH chars,
+// and returns the length; precision is clamped to 0..MAX_FORMAT_PRECISION
+size_t formatNumber(char *out, double value, NumberFormat format = NumberFormat());
+
+inline void appendNumber(std::string &out, double value, NumberFormat format = NumberFormat())
+{
+    char buffer[MAX_FORMATTED_LENGTH];
+    out.append(buffer, formatNumber(buffer, value, format));
+}
+
+// std::cout << formatted(x, format) prints through formatNumber; setw still applies
+struct FormattedNumber
+{
+    double value;
+    NumberFormat format;
+};
+
+inline FormattedNumber formatted(double value, NumberFormat format = NumberFormat())
+{
+    return FormattedNumber{value, format};
+}
+
+inline std::ostream &operator<<(std::ostream &out, const FormattedNumber &number)
+{
+    char buffer[MAX_FORMATTED_LENGTH];
+    return out << std::string_view(buffer, formatNumber(buffer, number.value, number.format));
+}
+
+// Instrumentation
+// Built only with -DCALC_INSTRUMENT; otherwise CALC_PROFILE expands to nothing
+// and nothing below exists. Each thread counts into its own thread_local
+// block, so recording an operation costs two rdtsc reads and a few relaxed
+// stores with no locking. Latencies are kept as log2 histograms of ticks.
+// Allocated bytes are counted only if the program routes operator new through
+// instrument::recordAllocation (Calculator.cpp does).
+#ifdef CALC_INSTRUMENT
+namespace instrument
+{
+constexpr size_t MAX_OPERATIONS = 128;
+constexpr size_t LATENCY_BUCKETS = 64; // Bucket i holds latencies of [2^i, 2^(i+1)) ticks
+
+// Written only by the owning thread; atomics so other threads may read them
+struct OperationCounters
+{
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> ticks{0};
+    std::atomic<uint64_t> maxTicks{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> allocations{0};
+    std::array<std::atomic<uint64_t>, LATENCY_BUCKETS> histogram{};
+};
+
+// Allocated on a thread's first recorded call; folded into the totals of
+// exited threads when the thread ends
+struct ThreadCounters
+{
+    std::array<OperationCounters, MAX_OPERATIONS> operations;
+
+    ThreadCounters();
+    ~ThreadCounters();
+};
+
+// Plain thread-locals so operator new can bump them without initialisation
+inline thread_local uint64_t allocatedBytes = 0;
+inline thread_local uint64_t allocationCount = 0;
+
+inline void recordAllocation(size_t size)
+{
+    allocatedBytes += size;
+    allocationCount++;
+}
+
+CALC_ALWAYS_INLINE uint64_t ticks()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// Id of a named operation, registering it on first use; the name must outlive
+// the program (a string literal). Past MAX_OPERATIONS names share "other".
+size_t operationId(const char *name);
+
+ThreadCounters &threadCounters();
+
+inline void bump(std::atomic<uint64_t> &counter, uint64_t amount)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+// Records one call of an operation from construction to destruction
+class Scope
+{
+public:
+    explicit Scope(size_t id)
+        : counters(threadCounters().operations[id]), bytes(allocatedBytes), allocations(allocationCount), start(ticks())
+    {
+    }
+
+    ~Scope()
+    {
+        uint64_t elapsed = ticks() - start;
+        bump(counters.calls, 1);
+        bump(counters.ticks, elapsed);
+        if (elapsed > counters.maxTicks.load(std::memory_order_relaxed))
+            counters.maxTicks.store(elapsed, std::memory_order_relaxed);
+        bump(counters.bytes, allocatedBytes - bytes);
+        bump(counters.allocations, allocationCount - allocations);
+        bump(counters.histogram[highestSetBit(elapsed | 1)], 1);
+    }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    OperationCounters &counters;
+    uint64_t bytes, allocations, start;
+};
+
+// Totals over all threads, live and exited, converted to nanoseconds
+struct OperationStats
+{
+    std::string name;
+    uint64_t calls;
+    double totalNs, meanNs, p50Ns, p99Ns, maxNs;
+    uint64_t bytes, allocations;
+};
+
+// Operations with at least one call, slowest total first
+std::vector<OperationStats> collectStats();
+
+// Zeroes every counter; updates racing with the reset may survive it
+void resetStats();
+
+// Writes collectStats() as a tab-separated table; false if it cannot be opened
+bool dumpStats(const std::string &filename);
+}
+
+#define CALC_PROFILE_JOIN2(a, b) a##b
+#define CALC_PROFILE_JOIN(a, b) CALC_PROFILE_JOIN2(a, b)
+#define CALC_PROFILE(name)                                                                   \
+    static const size_t CALC_PROFILE_JOIN(calcProfileId, __LINE__) = instrument::operationId(name); \
+    instrument::Scope CALC_PROFILE_JOIN(calcProfileScope, __LINE__)(CALC_PROFILE_JOIN(calcProfileId, __LINE__))
+#else
+#define CALC_PROFILE(name) ((void)0)
+#endif
+
+// Extended precision arithmetic
+// Arbitrary-precision binary floating point in the style of MPFR: the value is
+// (-1)^negative * mantissa * 2^exponent, where the mantissa is an integer of
+// limbs.size() 32-bit limbs (least significant first) with its top bit set, or
+// all zero for zero. Results are rounded to nearest-even at the precision of
+// the wider operand; precisions are rounded up to whole limbs.
+class BigFloat
+{
+public:
+    static constexpr unsigned MIN_PRECISION = 64;
+    static constexpr unsigned MAX_PRECISION = 8192;
+    // Not synchronized, see the top of this file
+    static inline unsigned defaultPrecision = 256;
+
+    explicit BigFloat(double value = 0.0, unsigned bits = defaultPrecision)
+        : negative(std::signbit(value)), exponent(0), limbs(limbCount(bits), 0)
+    {
+        if (!std::isfinite(value))
+            throw std::invalid_argument("Cannot represent inf or nan");
+        if (value == 0.0)
+            return;
+        int binaryExponent;
+        uint64_t mantissa = static_cast<uint64_t>(std::ldexp(std::fabs(std::frexp(value, &binaryExponent)), 53));
+        *this = rounded({static_cast<uint32_t>(mantissa), static_cast<uint32_t>(mantissa >> 32)},
+                        binaryExponent - 53, negative, limbs.size(), false);
+    }
+
+    // Digits with an optional decimal point, as produced by the expression tokenizer
+    static BigFloat fromString(const std::string &text, unsigned bits = defaultPrecision)
+    {
+        std::vector<uint32_t> digits(1, 0);
+        size_t fractionDigits = 0, digitCount = 0;
+        bool seenPoint = false;
+        for (char ch : text)
+        {
+            if (ch == '.')
+            {
+                if (seenPoint)
+                    break;
+                seenPoint = true;
+                continue;
+            }
+            if (!std::isdigit(static_cast<unsigned char>(ch)))
+                break;
+            multiplyAdd(digits, 10, static_cast<uint32_t>(ch - '0'));
+            digitCount++;
+            if (seenPoint)
+                fractionDigits++;
+        }
+        if (digitCount == 0)
+            throw std::invalid_argument("Invalid number: " + text);
+
+        std::vector<uint32_t> scale(1, 1);
+        for (size_t i = 0; i < fractionDigits; i++)
+            multiplyAdd(scale, 10, 0);
+        return quotient(digits, 0, scale, 0, false, limbCount(bits));
+    }
+
+    unsigned precision() const { return static_cast<unsigned>(limbs.size() * 32); }
+    bool isZero() const { return limbs.back() == 0; }
+    bool isNegative() const { return negative && !isZero(); }
+
+    bool isInteger() const
+    {
+        if (isZero() || exponent >= 0)
+            return true;
+        return -exponent < static_cast<int64_t>(limbs.size()) * 32 && !anyBitBelow(limbs, -exponent);
+    }
+
+    double toDouble() const;
+
+    // Shortest decimal form with the given number of significant digits
+    // (0 = every digit the precision supports)
+    std::string toString(int significant = 0) const;
+
+    BigFloat operator-() const
+    {
+        BigFloat result = *this;
+        result.negative = !negative;
+        return result;
+    }
+
+    BigFloat abs() const
+    {
+        BigFloat result = *this;
+        result.negative = false;
+        return result;
+    }
+
+    friend BigFloat operator+(const BigFloat &a, const BigFloat &b) { return sum(a, b, false); }
+    friend BigFloat operator-(const BigFloat &a, const BigFloat &b) { return sum(a, b, true); }
+
+    friend BigFloat operator*(const BigFloat &a, const BigFloat &b);
+
+    friend BigFloat operator/(const BigFloat &a, const BigFloat &b);
+
+    // e^x, correctly rounded in all but rare near-halfway cases
+    static BigFloat exp(const BigFloat &x);
+
+    // Natural logarithm of a positive value, by Halley iteration on e^y = x
+    static BigFloat log(const BigFloat &x);
+
+    // a^b; integral exponents use binary powering, so negative bases are allowed there
+    static BigFloat pow(const BigFloat &base, const BigFloat &power);
+
+private:
+    bool negative;
+    int64_t exponent;
+    std::vector<uint32_t> limbs;
+
+    static size_t limbCount(unsigned bits)
+    {
+        bits = std::min(std::max(bits, MIN_PRECISION), MAX_PRECISION);
+        return (bits + 31) / 32;
+    }
+
+    static BigFloat zero(size_t n, bool sign)
+    {
+        BigFloat result(0.0, static_cast<unsigned>(n * 32));
+        result.negative = sign;
+        return result;
+    }
+
+    // Position just above the most significant bit: 2^(topBit - 1) <= |x| < 2^topBit
+    int64_t topBit() const { return exponent + 32 * static_cast<int64_t>(limbs.size()); }
+
+    BigFloat withLimbs(size_t n) const;
+
+    // Integer part of a non-negative value below 2^32
+    uint32_t integerPart() const;
+
+    uint64_t toUnsigned() const
+    {
+        std::vector<uint32_t> whole = shifted(limbs, exponent, 2);
+        return (static_cast<uint64_t>(whole[1]) << 32) | whole[0];
+    }
+
+    BigFloat multipliedBy(uint32_t factor) const;
+
+    BigFloat dividedBy(uint32_t divisor) const;
+
+    static BigFloat integerPower(BigFloat base, uint64_t count);
+
+    // ln 2 = 2 atanh(1/3) = 2 sum 1 / ((2k + 1) 3^(2k + 1)), cached at the widest precision seen
+    static BigFloat ln2(unsigned bits);
+
+    // magnitude = magnitude * factor + addend
+    static void multiplyAdd(std::vector<uint32_t> &magnitude, uint32_t factor, uint32_t addend);
+
+    static size_t bitLength(const std::vector<uint32_t> &magnitude);
+
+    static bool anyBitBelow(const std::vector<uint32_t> &magnitude, int64_t bit);
+
+    // magnitude * 2^left truncated to size limbs (left may be negative)
+    static std::vector<uint32_t> shifted(const std::vector<uint32_t> &magnitude, int64_t left, size_t size);
+
+    // Rounds magnitude * 2^scale (plus a sticky amount below its last bit) to n limbs
+    static BigFloat rounded(const std::vector<uint32_t> &magnitude, int64_t scale, bool sign, size_t n, bool sticky);
+
+    // (numerator * 2^numeratorScale) / (denominator * 2^denominatorScale) rounded to n limbs
+    static BigFloat quotient(const std::vector<uint32_t> &numerator, int64_t numeratorScale,
+                             const std::vector<uint32_t> &denominator, int64_t denominatorScale, bool sign, size_t n);
+
+    // Schoolbook long division of magnitudes (Knuth's algorithm D with 32-bit digits);
+    // sticky reports a nonzero remainder
+    static std::vector<uint32_t> divideMagnitudes(std::vector<uint32_t> u, const std::vector<uint32_t> &v, bool &sticky);
+
+    // a + b or a - b, exact before the final rounding except for a sticky bit
+    static BigFloat sum(const BigFloat &a, const BigFloat &b, bool subtract);
+
+    BigFloat withSign(bool sign) const
+    {
+        BigFloat result = *this;
+        result.negative = sign;
+        return result;
+    }
+};
+
+// Double-double arithmetic: an unevaluated sum hi + lo with |lo| <= ulp(hi) / 2,
+// about 106 bits (~32 digits). Every operation is a handful of error-free
+// double transforms, so it runs a few times slower than double instead of the
+// hundreds of times of a software multiprecision type.
+struct DoubleDouble
+{
+    double hi;
+    double lo;
+
+    DoubleDouble(double value = 0.0) : hi(value), lo(0.0) {}
+    DoubleDouble(double high, double low) : hi(high), lo(low) {}
+
+    static DoubleDouble fromString(const std::string &text)
+    {
+        BigFloat value = BigFloat::fromString(text, 192);
+        double high = value.toDouble();
+        return DoubleDouble(high, (value - BigFloat(high, 192)).toDouble());
+    }
+
+    std::string toString(int significant = 32) const
+    {
+        if (!std::isfinite(hi))
+            return std::isnan(hi) ? "nan" : (hi > 0 ? "inf" : "-inf");
+        return (BigFloat(hi, 192) + BigFloat(lo, 192)).toString(significant);
+    }
+
+    double toDouble() const { return hi + lo; }
+
+    // a + b = s + e exactly
+    static DoubleDouble twoSum(double a, double b)
+    {
+        double s = a + b;
+        double v = s - a;
+        return DoubleDouble(s, (a - (s - v)) + (b - v));
+    }
+
+    // Same for |a| >= |b|
+    static DoubleDouble quickTwoSum(double a, double b)
+    {
+        double s = a + b;
+        return DoubleDouble(s, b - (s - a));
+    }
+
+    // a * b = p + e exactly (Dekker's splitting unless the target has fused multiply-add)
+    static DoubleDouble twoProduct(double a, double b)
+    {
+        double p = a * b;
+#ifdef __FMA__
+        return DoubleDouble(p, std::fma(a, b, -p));
+#else
+        const double SPLIT = 134217729.0; // 2^27 + 1
+        double ta = SPLIT * a, tb = SPLIT * b;
+        double aHi = ta - (ta - a), bHi = tb - (tb - b);
+        double aLo = a - aHi, bLo = b - bHi;
+        return DoubleDouble(p, ((aHi * bHi - p) + aHi * bLo + aLo * bHi) + aLo * bLo);
+#endif
+    }
+
+    DoubleDouble operator-() const { return DoubleDouble(-hi, -lo); }
+
+    friend DoubleDouble operator+(const DoubleDouble &a, const DoubleDouble &b)
+    {
+        DoubleDouble s = twoSum(a.hi, b.hi);
+        if (!std::isfinite(s.hi))
+            return DoubleDouble(s.hi);
+        DoubleDouble t = twoSum(a.lo, b.lo);
+        s = quickTwoSum(s.hi, s.lo + t.hi);
+        return quickTwoSum(s.hi, s.lo + t.lo);
+    }
+
+    friend DoubleDouble operator-(const DoubleDouble &a, const DoubleDouble &b) { return a + -b; }
+
+    friend DoubleDouble operator*(const DoubleDouble &a, const DoubleDouble &b)
+    {
+        DoubleDouble p = twoProduct(a.hi, b.hi);
+        if (!std::isfinite(p.hi))
+            return DoubleDouble(p.hi);
+        return quickTwoSum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+    }
+
+    friend DoubleDouble operator*(const DoubleDouble &a, double b)
+    {
+        DoubleDouble p = twoProduct(a.hi, b);
+        if (!std::isfinite(p.hi))
+            return DoubleDouble(p.hi);
+        return quickTwoSum(p.hi, p.lo + a.lo * b);
+    }
+
+    // q1 = a / b in double, then one correction from the remainder a - q1 b,
+    // whose leading part a.hi - q1 b.hi is exact by the product transform
+    friend DoubleDouble operator/(const DoubleDouble &a, const DoubleDouble &b)
+    {
+        double q1 = a.hi / b.hi;
+        if (!std::isfinite(q1))
+            return DoubleDouble(q1);
+        DoubleDouble p = twoProduct(q1, b.hi);
+        double remainder = (((a.hi - p.hi) - p.lo) + a.lo) - q1 * b.lo;
+        return quickTwoSum(q1, remainder / b.hi);
+    }
+
+    static DoubleDouble ldexp(const DoubleDouble &a, int e) { return DoubleDouble(std::ldexp(a.hi, e), std::ldexp(a.lo, e)); }
+
+    // e^a = 2^k (e^(r / 16))^16 with r = a - k ln2 and a Taylor series for the inner power
+    static DoubleDouble exp(const DoubleDouble &a);
+
+    // One Newton step on e^y = a from the double logarithm doubles its 53 bits
+    static DoubleDouble log(const DoubleDouble &a);
+
+    // Integral exponents use binary powering; others follow std::pow's domain
+    static DoubleDouble pow(const DoubleDouble &base, const DoubleDouble &power);
+};
+
+// Interval arithmetic with outward rounding. Rather than switching the FPU
+// rounding mode (which also forces -frounding-math on the whole program),
+// every bound is computed in round-to-nearest and the sign of its exact
+// rounding error, from an error-free transform, decides whether to step one
+// ulp outward. That is exactly directed rounding, it never touches the
+// rounding mode, and it is branch-free so batch loops vectorize.
+class IntervalMath
+{
+public:
+    // Next double toward +inf; +inf and NaN are returned unchanged
+    CALC_ALWAYS_INLINE static double nextUp(double x)
+    {
+        uint64_t bits = toBits(x);
+        uint64_t negative = 0 - (bits >> 63);
+        uint64_t next = bits + (1 | negative);
+        next = select(zeroMask(x), 1, next);
+        return fromBits(select(nonFiniteMask(x) & ~negative, bits, next));
+    }
+
+    CALC_ALWAYS_INLINE static double nextDown(double x) { return -nextUp(-x); }
+
+    // Bounds on a + b: down <= a + b <= up, each the adjacent double
+    CALC_ALWAYS_INLINE static void sumBounds(double a, double b, double &down, double &up)
+    {
+        double s = a + b;
+        double v = s - a;
+        double error = (a - (s - v)) + (b - v);
+        outward(s, error, nonFiniteMask(error), down, up);
+    }
+
+    CALC_ALWAYS_INLINE static void productBounds(double a, double b, double &down, double &up)
+    {
+        double p = a * b;
+        double error = productError(a, b, p);
+        // 0 * inf is 0 for interval endpoints; tiny products may have an inexact error term
+        uint64_t zeroFactor = zeroMask(a) | zeroMask(b);
+        p = fromBits(select(zeroFactor, 0, toBits(p)));
+        uint64_t unknown = (tinyMask(p) | nonFiniteMask(error)) & ~zeroFactor;
+        outward(p, fromBits(toBits(error) & ~zeroFactor), unknown, down, up);
+    }
+
+    // Bounds on a / b for b != 0; a - q b is exact, and its sign times the
+    // sign of b says on which side of q the true quotient lies
+    CALC_ALWAYS_INLINE static void quotientBounds(double a, double b, double &down, double &up)
+    {
+        double q = a / b;
+        double remainder = -productError(q, b, q * b) + (a - q * b);
+        uint64_t sign = (toBits(remainder) ^ toBits(b)) & 0x8000000000000000ULL;
+        double direction = fromBits((toBits(remainder) & ~0x8000000000000000ULL) | sign);
+        uint64_t unknown = tinyMask(q) | tinyMask(a) | nonFiniteMask(q) | nonFiniteMask(remainder);
+        unknown &= ~zeroMask(a);
+        outward(q, direction, unknown, down, up);
+    }
+
+    CALC_ALWAYS_INLINE static void add(double aLo, double aHi, double bLo, double bHi, double &lo, double &hi)
+    {
+        double unused;
+        sumBounds(aLo, bLo, lo, unused);
+        sumBounds(aHi, bHi, unused, hi);
+    }
+
+    CALC_ALWAYS_INLINE static void subtract(double aLo, double aHi, double bLo, double bHi, double &lo, double &hi)
+    {
+        add(aLo, aHi, -bHi, -bLo, lo, hi);
+    }
+
+    CALC_ALWAYS_INLINE static void multiply(double aLo, double aHi, double bLo, double bHi, double &lo, double &hi)
+    {
+        double d1, u1, d2, u2, d3, u3, d4, u4;
+        productBounds(aLo, bLo, d1, u1);
+        productBounds(aLo, bHi, d2, u2);
+        productBounds(aHi, bLo, d3, u3);
+        productBounds(aHi, bHi, d4, u4);
+        lo = minimum(minimum(d1, d2), minimum(d3, d4));
+        hi = maximum(maximum(u1, u2), maximum(u3, u4));
+    }
+
+    // A divisor containing zero gives the whole real line
+    CALC_ALWAYS_INLINE static void divide(double aLo, double aHi, double bLo, double bHi, double &lo, double &hi)
+    {
+        double d1, u1, d2, u2, d3, u3, d4, u4;
+        quotientBounds(aLo, bLo, d1, u1);
+        quotientBounds(aLo, bHi, d2, u2);
+        quotientBounds(aHi, bLo, d3, u3);
+        quotientBounds(aHi, bHi, d4, u4);
+        uint64_t spansZero = (signMask(bLo) | zeroMask(bLo)) & ~(signMask(bHi) & ~zeroMask(bHi));
+        lo = fromBits(select(spansZero, toBits(-HUGE_VAL), toBits(minimum(minimum(d1, d2), minimum(d3, d4)))));
+        hi = fromBits(select(spansZero, toBits(HUGE_VAL), toBits(maximum(maximum(u1, u2), maximum(u3, u4)))));
+    }
+
+private:
+    static uint64_t toBits(double x)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        return bits;
+    }
+
+    static double fromBits(uint64_t bits)
+    {
+        double x;
+        std::memcpy(&x, &bits, sizeof(x));
+        return x;
+    }
+
+    static uint64_t select(uint64_t mask, uint64_t ifSet, uint64_t ifClear) { return (ifSet & mask) | (ifClear & ~mask); }
+
+    // All ones when the sign bit of x is set
+    static uint64_t signMask(double x) { return 0 - (toBits(x) >> 63); }
+
+    // All ones when x is +0 or -0
+    static uint64_t zeroMask(double x)
+    {
+        uint64_t magnitude = toBits(x) & ~0x8000000000000000ULL;
+        return ((magnitude | (0 - magnitude)) >> 63) - 1;
+    }
+
+    // All ones when x is infinite or NaN
+    static uint64_t nonFiniteMask(double x)
+    {
+        uint64_t magnitude = toBits(x) & ~0x8000000000000000ULL;
+        return 0 - ((0x7fefffffffffffffULL - magnitude) >> 63);
+    }
+
+    // All ones when |x| < 2^-968, where the error terms of products stop being exact
+    static uint64_t tinyMask(double x)
+    {
+        uint64_t magnitude = toBits(x) & ~0x8000000000000000ULL;
+        return 0 - ((magnitude - 0x0370000000000000ULL) >> 63);
+    }
+
+    // x - y's sign decides; same-sign infinities are equal, so either pick is right
+    static double minimum(double x, double y) { return fromBits(select(signMask(x - y), toBits(x), toBits(y))); }
+    static double maximum(double x, double y) { return fromBits(select(signMask(x - y), toBits(y), toBits(x))); }
+
+    // a * b - p exactly (Dekker's splitting unless the target has fused multiply-add)
+    CALC_ALWAYS_INLINE static double productError(double a, double b, double p)
+    {
+#ifdef __FMA__
+        return std::fma(a, b, -p);
+#else
+        const double SPLIT = 134217729.0; // 2^27 + 1
+        double ta = SPLIT * a, tb = SPLIT * b;
+        double aHi = ta - (ta - a), bHi = tb - (tb - b);
+        double aLo = a - aHi, bLo = b - bHi;
+        return ((aHi * bHi - p) + aHi * bLo + aLo * bHi) + aLo * bLo;
+#endif
+    }
+
+    // The true value is rounded + error: step outward on the error's side,
+    // or on both sides when the error is unknown
+    CALC_ALWAYS_INLINE static void outward(double rounded, double error, uint64_t unknown, double &down, double &up)
+    {
+        uint64_t zero = zeroMask(error);
+        uint64_t below = (signMask(error) & ~zero) | unknown;
+        uint64_t above = (~signMask(error) & ~zero) | unknown;
+        down = fromBits(select(below, toBits(nextDown(rounded)), toBits(rounded)));
+        up = fromBits(select(above, toBits(nextUp(rounded)), toBits(rounded)));
+    }
+};
+
+// A closed interval [lo, hi] of doubles guaranteed to contain the exact result
+struct Interval
+{
+    double lo;
+    double hi;
+
+    Interval(double value = 0.0) : lo(value), hi(value) {}
+    Interval(double low, double high) : lo(low), hi(high) {}
+
+    // The adjacent doubles around the decimal, or a point when it is exact.
+    // Up to 19 digits and 22 decimals, d * 10^k is compared with the digit
+    // integer M in double-double; longer literals are compared in BigFloat.
+    static Interval fromString(const std::string &text);
+
+    bool containsZero() const { return lo <= 0.0 && hi >= 0.0; }
+    bool contains(double x) const { return lo <= x && x <= hi; }
+    double width() const { return hi - lo; }
+    double midpoint() const { return 0.5 * lo + 0.5 * hi; }
+
+    Interval operator-() const { return Interval(-hi, -lo); }
+
+    friend Interval operator+(const Interval &a, const Interval &b)
+    {
+        Interval r;
+        IntervalMath::add(a.lo, a.hi, b.lo, b.hi, r.lo, r.hi);
+        return r;
+    }
+
+    friend Interval operator-(const Interval &a, const Interval &b)
+    {
+        Interval r;
+        IntervalMath::subtract(a.lo, a.hi, b.lo, b.hi, r.lo, r.hi);
+        return r;
+    }
+
+    friend Interval operator*(const Interval &a, const Interval &b)
+    {
+        Interval r;
+        IntervalMath::multiply(a.lo, a.hi, b.lo, b.hi, r.lo, r.hi);
+        return r;
+    }
+
+    friend Interval operator/(const Interval &a, const Interval &b)
+    {
+        Interval r;
+        IntervalMath::divide(a.lo, a.hi, b.lo, b.hi, r.lo, r.hi);
+        return r;
+    }
+
+    // Integral point exponents use exact even/odd power rules; anything else
+    // needs a non-negative base and takes the extremes of x^y at the corners,
+    // widened by two ulps to cover libm's exp/log/pow error
+    static Interval pow(const Interval &base, const Interval &power);
+
+    std::string toString() const;
+
+private:
+    // Binary powering of a non-negative or single-signed interval
+    static Interval integerPower(Interval base, uint64_t count);
+};
+
+// Interval buffers stored as separate lower and upper bound arrays
+struct IntervalArray
+{
+    std::vector<double> lo;
+    std::vector<double> hi;
+
+    size_t size() const { return lo.size(); }
+    void resize(size_t n)
+    {
+        lo.resize(n);
+        hi.resize(n);
+    }
+};
+
+// Batch interval kernels: straight loops over the IntervalMath bounds, which
+// vectorize at -O3 like the complex kernels. The bounds are forced inline
+// since a call left in the loop body stops vectorization
+class IntervalBatch
+{
+public:
+    static void add(const IntervalArray &a, const IntervalArray &b, IntervalArray &out)
+    {
+        apply(a, b, out, [](double aLo, double aHi, double bLo, double bHi, double &lo, double &hi)
+              { IntervalMath::add(aLo, aHi, bLo, bHi, lo, hi); });
+    }
+
+    static void subtract(const IntervalArray &a, const IntervalArray &b, IntervalArray &out)
+    {
+        apply(a, b, out, [](double aLo, double aHi, double bLo, double bHi, double &lo, double &hi)
+              { IntervalMath::subtract(aLo, aHi, bLo, bHi, lo, hi); });
+    }
+
+    static void multiply(const IntervalArray &a, const IntervalArray &b, IntervalArray &out)
+    {
+        apply(a, b, out, [](double aLo, double aHi, double bLo, double bHi, double &lo, double &hi)
+              { IntervalMath::multiply(aLo, aHi, bLo, bHi, lo, hi); });
+    }
+
+    static void divide(const IntervalArray &a, const IntervalArray &b, IntervalArray &out)
+    {
+        apply(a, b, out, [](double aLo, double aHi, double bLo, double bHi, double &lo, double &hi)
+              { IntervalMath::divide(aLo, aHi, bLo, bHi, lo, hi); });
+    }
+
+    // Element by element; this one is not vectorized
+    static void power(const IntervalArray &a, const IntervalArray &b, IntervalArray &out)
+    {
+        size_t n = checkSizes(a, b, out);
+        for (size_t i = 0; i < n; i++)
+        {
+            Interval r(NAN);
+            try
+            {
+                r = Interval::pow(Interval(a.lo[i], a.hi[i]), Interval(b.lo[i], b.hi[i]));
+            }
+            catch (const std::runtime_error &)
+            {
+            }
+            out.lo[i] = r.lo;
+            out.hi[i] = r.hi;
+        }
+    }
+
+private:
+    template <typename Kernel>
+    static void apply(const IntervalArray &a, const IntervalArray &b, IntervalArray &out, Kernel kernel)
+    {
+        size_t n = checkSizes(a, b, out);
+        const double *aLo = a.lo.data(), *aHi = a.hi.data(), *bLo = b.lo.data(), *bHi = b.hi.data();
+        double *outLo = out.lo.data(), *outHi = out.hi.data();
+        for (size_t i = 0; i < n; i++)
+        {
+            double lo, hi;
+            kernel(aLo[i], aHi[i], bLo[i], bHi[i], lo, hi);
+            outLo[i] = lo;
+            outHi[i] = hi;
+        }
+    }
+
+    static size_t checkSizes(const IntervalArray &a, const IntervalArray &b, IntervalArray &out)
+    {
+        if (a.size() != b.size())
+            throw std::invalid_argument("Interval arrays differ in length");
+        out.resize(a.size());
+        return a.size();
+    }
+};
+
+
+// Expression Parser
+// Number types the expression engine can evaluate in: parsing of literals,
+// the ^ operator and the zero test behind the division check
+template <typename T>
+struct ExpressionArithmetic;
+
+template <>
+struct ExpressionArithmetic<double>
+{
+    static double parse(const std::string &text) { return std::stod(text); }
+    static double power(double a, double b) { return std::pow(a, b); }
+    static bool isZero(double value) { return value == 0; }
+};
+
+template <>
+struct ExpressionArithmetic<DoubleDouble>
+{
+    static DoubleDouble parse(const std::string &text) { return DoubleDouble::fromString(text); }
+    static DoubleDouble power(const DoubleDouble &a, const DoubleDouble &b) { return DoubleDouble::pow(a, b); }
+    static bool isZero(const DoubleDouble &value) { return value.hi == 0; }
+};
+
+template <>
+struct ExpressionArithmetic<BigFloat>
+{
+    static BigFloat parse(const std::string &text) { return BigFloat::fromString(text); }
+    static BigFloat power(const BigFloat &a, const BigFloat &b) { return BigFloat::pow(a, b); }
+    static bool isZero(const BigFloat &value) { return value.isZero(); }
+};
+
+// An interval divisor is rejected when it may be zero
+template <>
+struct ExpressionArithmetic<Interval>
+{
+    static Interval parse(const std::string &text) { return Interval::fromString(text); }
+    static Interval power(const Interval &a, const Interval &b) { return Interval::pow(a, b); }
+    static bool isZero(const Interval &value) { return value.containsZero(); }
+};
+
+int getPrecedence(char op);
+
+template <typename T>
+T applyOperation(const T &a, const T &b, char op)
+{
+    switch (op)
+    {
+    case '+':
+        return a + b;
+    case '-':
+        return a - b;
+    case '*':
+        return a * b;
+    case '/':
+        if (ExpressionArithmetic<T>::isZero(b))
+            throw std::runtime_error("Division by zero");
+        return a / b;
+    case '^':
+        return ExpressionArithmetic<T>::power(a, b);
+    default:
+        return T(0.0);
+    }
+}
+
+// An expression parsed once by the shunting-yard rules into postfix form, so
+// it can be evaluated repeatedly and in any number type. Names such as x or
+// rate_2 are variables whose values are supplied at evaluation time. The
+// program, literals and parse temporaries live in memory, e.g. an Arena for
+// an expression evaluated once; copies always go to the default heap, but a
+// moved expression keeps its memory and must not outlive it.
+class CompiledExpression
+{
+public:
+    explicit CompiledExpression(std::string_view expr, std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+
+    // Literal values in type T, parsed once and reused across evaluations
+    template <typename T>
+    std::vector<T> literalValues() const
+    {
+        std::vector<T> values;
+        values.reserve(literals.size());
+        for (const std::pmr::string &text : literals)
+            values.push_back(ExpressionArithmetic<T>::parse(std::string(text)));
+        return values;
+    }
+
+    // Variable names in order of first use; variable values follow this order
+    const std::vector<std::string> &variableNames() const { return variables; }
+
+    template <typename T>
+    T evaluate(const std::vector<T> &values, const std::vector<T> &variableValues = {}) const
+    {
+        return evaluate(values, variableValues, [](const T &a, const T &b, char op) { return applyOperation(a, b, op); });
+    }
+
+    // Evaluation with a custom apply(a, b, op), e.g. whole columns of values at once
+    template <typename T, typename Apply>
+    T evaluate(const std::vector<T> &values, const std::vector<T> &variableValues, Apply apply) const
+    {
+        CALC_PROFILE("CompiledExpression::evaluate");
+        checkVariables(variableValues.size());
+        // Reused across calls so repeated evaluation does not allocate
+        thread_local std::vector<T> stack;
+        stack.clear();
+        for (const Instruction &step : program)
+        {
+            if (step.op == LITERAL)
+            {
+                stack.push_back(values[step.index]);
+            }
+            else if (step.op == VARIABLE)
+            {
+                stack.push_back(variableValues[step.index]);
+            }
+            else
+            {
+                T b = std::move(stack.back());
+                stack.pop_back();
+                stack.back() = apply(stack.back(), b, step.op);
+            }
+        }
+        return std::move(stack.back());
+    }
+
+    // One-off evaluation; the literal values go to a reused buffer like the stack
+    template <typename T>
+    T evaluate() const
+    {
+        thread_local std::vector<T> values;
+        values.clear();
+        for (const std::pmr::string &text : literals)
+            values.push_back(ExpressionArithmetic<T>::parse(std::string(text)));
+        return evaluate(values);
+    }
+
+    // The operator sequence with literals as '#': expressions of the same
+    // shape differ only in their literal values
+    std::string shape() const;
+
+    // Reverse-mode automatic differentiation: the postfix program is the
+    // tape. A forward pass keeps every node's value, then one backward pass
+    // carries adjoints from the result to the variables, so the whole
+    // gradient costs a few evaluations however many variables there are.
+    // Returns the value and fills gradient in variableNames() order.
+    double gradient(const std::vector<double> &values, const std::vector<double> &variableValues,
+                    std::vector<double> &gradient) const;
+
+    // Forward-mode automatic differentiation with dual numbers carrying one
+    // tangent per variable, so the gradient also comes out of a single pass.
+    // Each operation updates a whole tangent row, making the cost grow with
+    // the number of variables; gradient() is the better choice beyond a few
+    double gradientForward(const std::vector<double> &values, const std::vector<double> &variableValues,
+                           std::vector<double> &gradient) const;
+
+private:
+    // LITERAL and VARIABLE push literals[index] or variables[index]; any
+    // other op combines the top two values
+    static const char LITERAL = 0;
+    static const char VARIABLE = 1;
+
+    struct Instruction
+    {
+        char op;
+        uint32_t index;
+    };
+
+    std::pmr::vector<std::pmr::string> literals;
+    std::vector<std::string> variables;
+    std::pmr::vector<Instruction> program;
+
+    void pushLiteral(std::string_view text, size_t &depth)
+    {
+        program.push_back({LITERAL, static_cast<uint32_t>(literals.size())});
+        literals.emplace_back(text);
+        depth++;
+    }
+
+    void pushVariable(std::string_view name, size_t &depth);
+
+    void checkVariables(size_t supplied) const
+    {
+        if (supplied < variables.size())
+            throw std::runtime_error("Unknown variable: " + variables[supplied]);
+    }
+
+    // d(a op b)/da and d(a op b)/db at a, b with result r. For ^ a zero
+    // exponent or zero result drops the term whose log or power would be
+    // undefined while its true contribution is zero
+    static void partials(char op, double a, double b, double r, double &dLeft, double &dRight);
+
+    void pushOperator(char op, size_t &depth);
+};
+
+double evaluateExpression(const std::string &expr);
+
+// Compiled expressions by source text with their literal values parsed, so a
+// repeated expression costs one hash lookup before evaluation. The least
+// recently used entry is dropped when full. Not synchronized: give each
+// thread its own cache.
+class ExpressionCache
+{
+public:
+    struct Entry
+    {
+        CompiledExpression expression;
+        std::vector<double> literals;
+    };
+
+    explicit ExpressionCache(size_t capacity = 4096) : capacity(std::max<size_t>(capacity, 1)) {}
+
+    // Throws like CompiledExpression if text does not compile; failures are not cached
+    const Entry &get(std::string_view text);
+
+    size_t size() const { return entries.size(); }
+    uint64_t hits() const { return hitCount; }
+    uint64_t misses() const { return missCount; }
+
+private:
+    typedef std::list<std::pair<std::string, Entry>> EntryList;
+
+    size_t capacity;
+    EntryList entries; // Most recently used first
+    std::unordered_map<std::string_view, EntryList::iterator> index; // Keys view the strings in entries
+    uint64_t hitCount = 0, missCount = 0;
+};
+
+// Batch complex kernels
+// Complex buffers are stored as separate real and imaginary arrays (structure
+// of arrays) so every kernel is a straight loop over contiguous doubles that
+// the compiler turns into SIMD code at -O3 (loops calling sqrt also need
+// -fno-math-errno, otherwise each call keeps a branch for setting errno).
+struct ComplexArray
+{
+    std::vector<double> re;
+    std::vector<double> im;
+
+    size_t size() const { return re.size(); }
+    void resize(size_t n)
+    {
+        re.resize(n);
+        im.resize(n);
+    }
+};
+
+class ComplexBatch
+{
+public:
+    // Largest error of fastPhase against std::atan2, in radians
+    static constexpr double PHASE_MAX_ERROR = 4e-8;
+
+    static void add(const ComplexArray &a, const ComplexArray &b, ComplexArray &out);
+
+    static void multiply(const ComplexArray &a, const ComplexArray &b, ComplexArray &out);
+
+    // out = in * (cr + ci i)
+    static void scale(const ComplexArray &in, std::complex<double> c, ComplexArray &out);
+
+    static void conjugate(const ComplexArray &in, ComplexArray &out);
+
+    // |z| as sqrt(re^2 + im^2), which vectorizes; the rare elements whose
+    // squares overflow or lose precision to underflow are redone with std::hypot.
+    static void magnitude(const ComplexArray &in, double *out);
+
+    // arg(z) from a degree-15 odd minimax polynomial for atan on [0, 1]
+    // (Abramowitz & Stegun 4.4.49) with octant folding. Error <= PHASE_MAX_ERROR.
+    static void phase(const ComplexArray &in, double *out)
+    {
+        const double *inRe = in.re.data(), *inIm = in.im.data();
+        for (size_t i = 0, n = in.size(); i < n; i++)
+            out[i] = fastPhase(inRe[i], inIm[i]);
+    }
+
+    static double fastPhase(double x, double y)
+    {
+        double ax = std::fabs(x), ay = std::fabs(y);
+        double mx = ax > ay ? ax : ay, mn = ax > ay ? ay : ax;
+        // Divide by 1 instead of 0 at the origin without branching
+        double a = mn / (mx + (mx == 0.0 ? 1.0 : 0.0));
+        double s = a * a;
+        double r = ((((((( -0.0040540580 * s + 0.0218612288) * s - 0.0559098861) * s + 0.0964200441) * s -
+                        0.1390853351) * s + 0.1994653599) * s - 0.3332985605) * s + 0.9999993329) * a;
+        // Octant fix-ups as r = offset +/- r; selecting between r and an
+        // expression of r would need a branch to avoid evaluating both
+        r = (ay > ax ? M_PI_2 : 0.0) + (ay > ax ? -1.0 : 1.0) * r;
+        r = (x < 0.0 ? M_PI : 0.0) + (x < 0.0 ? -1.0 : 1.0) * r;
+        return std::copysign(r, y);
+    }
+
+private:
+    // 1 when the larger of |re|, |im| is above 1e150 (or inf/NaN) or a nonzero
+    // value below 1e-150. Tested on the bit patterns, which order like the
+    // magnitudes, because double compares here would keep the loop scalar.
+    static uint64_t needsHypot(double re, double im)
+    {
+        const uint64_t TOO_LARGE_BITS = 0x5f138d352e5096afULL; // 1e150
+        const uint64_t TOO_SMALL_BITS = 0x20ca2fe76a3f9475ULL; // 1e-150
+        double ar = std::fabs(re), ai = std::fabs(im);
+        double larger = ar > ai ? ar : ai;
+        uint64_t big;
+        std::memcpy(&big, &larger, sizeof(big));
+        uint64_t nonzero = (big | (0 - big)) >> 63;
+        return ((TOO_LARGE_BITS - big) >> 63) | (((big - TOO_SMALL_BITS) >> 63) & nonzero);
+    }
+
+    static size_t checkSizes(const ComplexArray &a, const ComplexArray &b, ComplexArray &out);
+};
+
+// Fast Fourier Transform
+// A plan holds everything that depends only on the transform length: the
+// radix factorization, the twiddle table and, for lengths with a large prime
+// factor, the Bluestein chirp. Plans are immutable once built and are shared
+// through a size-keyed cache, so repeated transforms of one length pay setup once.
+template <typename Plan>
+std::shared_ptr<const Plan> cachedFftPlan(size_t n)
+{
+    static std::mutex mutex;
+    static std::map<size_t, std::shared_ptr<const Plan>> cache;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        typename std::map<size_t, std::shared_ptr<const Plan>>::iterator it = cache.find(n);
+        if (it != cache.end())
+            return it->second;
+    }
+    // Built outside the lock: a Bluestein plan asks the cache for its inner plan
+    std::shared_ptr<const Plan> plan = std::make_shared<const Plan>(n);
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.emplace(n, plan).first->second;
+}
+
+class FftPlan
+{
+public:
+    typedef std::complex<double> Complex;
+
+    // Prime factors above this are handled by Bluestein's algorithm instead
+    // of an O(p^2) generic butterfly
+    static const size_t MAX_DIRECT_RADIX = 61;
+    // Smallest transform worth splitting across threads
+    static const size_t PARALLEL_MIN = 1 << 15;
+
+    static std::shared_ptr<const FftPlan> get(size_t n) { return cachedFftPlan<FftPlan>(n); }
+
+    explicit FftPlan(size_t n);
+
+    size_t size() const { return length; }
+    bool usesBluestein() const { return !chirp.empty(); }
+
+    // out[k] = sum_j in[j] e^(-2 pi i jk/n). in and out must not overlap.
+    // threads == 0 picks a thread count from the length.
+    void forward(const Complex *in, Complex *out, unsigned threads = 0) const;
+
+    // Unnormalized inverse (sign +); divide by n to undo forward()
+    void inverse(const Complex *in, Complex *out, unsigned threads = 0) const;
+
+private:
+    size_t length;
+    std::vector<size_t> radices;
+    std::vector<Complex> twiddles;
+    // Bluestein state: chirp e^(-i pi k^2/n) and the spectrum of its
+    // conjugate, pre-scaled by 1/m, for a power-of-two inner transform
+    std::vector<Complex> chirp;
+    std::vector<Complex> chirpSpectrum;
+    std::shared_ptr<const FftPlan> inner;
+
+    unsigned resolveThreads(unsigned threads) const;
+
+    void initBluestein();
+
+    void bluestein(const Complex *in, Complex *out, unsigned threads) const;
+
+    // Recursive mixed-radix decimation in time: the p sub-transforms of
+    // stride fstride*p are written to consecutive blocks of out and then
+    // combined by radix-p butterflies.
+    void transform(Complex *out, const Complex *in, size_t inStride, size_t fstride, size_t stage,
+                   unsigned threads) const;
+
+    void butterfly(Complex *out, size_t fstride, size_t p, size_t m, size_t begin, size_t end) const;
+};
+
+// Real-input transform of even length n, computed as a complex transform of
+// length n/2 over the interleaved samples plus an O(n) split step.
+class RealFftPlan
+{
+public:
+    typedef std::complex<double> Complex;
+
+    static std::shared_ptr<const RealFftPlan> get(size_t n) { return cachedFftPlan<RealFftPlan>(n); }
+
+    explicit RealFftPlan(size_t n);
+
+    size_t size() const { return length; }
+
+    // Writes the n/2 + 1 non-redundant bins of the spectrum of in[0..n)
+    void forward(const double *in, Complex *out, unsigned threads = 0) const;
+
+    // Unnormalized inverse from n/2 + 1 bins; divide by n to undo forward()
+    void inverse(const Complex *in, double *out, unsigned threads = 0) const;
+
+private:
+    size_t length;
+    std::shared_ptr<const FftPlan> half;
+    std::vector<Complex> twiddles;
+};
+
+// Spectrum bins 0..n/2 of real samples; odd lengths use the complex transform
+std::vector<std::complex<double>> realSpectrum(const std::vector<double> &samples, unsigned threads = 0);
+
+// Linear convolution through zero-padded power-of-two real transforms
+std::vector<double> fftConvolve(const std::vector<double> &a, const std::vector<double> &b, unsigned threads = 0);
+
+// Expression templates for elementwise matrix arithmetic
+// Operators on matrices build lightweight expression nodes instead of result
+// matrices; the whole chain is evaluated element by element in one pass when
+// it is assigned to a Matrix, so A + B - 2 * C allocates nothing but the result.
+template <typename E>
+struct MatrixExpr
+{
+    const E &self() const { return static_cast<const E &>(*this); }
+    size_t rows() const { return self().rows(); }
+    size_t cols() const { return self().cols(); }
+    double at(size_t k) const { return self().at(k); }
+};
+
+class Matrix;
+
+// Matrices are held by reference inside expressions, nested nodes by value
+template <typename E>
+struct MatrixOperand
+{
+    typedef const E type;
+};
+
+template <>
+struct MatrixOperand<Matrix>
+{
+    typedef const Matrix &type;
+};
+
+// Dense matrix storage (row-major, contiguous)
+class Matrix : public MatrixExpr<Matrix>
+{
+public:
+    Matrix() : rows_(0), cols_(0) {}
+    Matrix(size_t rows, size_t cols, double fill = 0.0)
+        : rows_(rows), cols_(cols), data_(rows * cols, fill) {}
+
+    template <typename E>
+    Matrix(const MatrixExpr<E> &expr)
+        : rows_(expr.rows()), cols_(expr.cols()), data_(expr.rows() * expr.cols())
+    {
+        assign(expr.self());
+    }
+
+    template <typename E>
+    Matrix &operator=(const MatrixExpr<E> &expr)
+    {
+        // Elementwise nodes only read index k when writing index k, so
+        // assigning an expression that refers to *this is safe.
+        if (rows_ != expr.rows() || cols_ != expr.cols())
+        {
+            if (data_.size() != expr.rows() * expr.cols())
+            {
+                std::vector<double> fresh(expr.rows() * expr.cols());
+                double *out = fresh.data();
+                const E &e = expr.self();
+                for (size_t k = 0, n = fresh.size(); k < n; k++)
+                    out[k] = e.at(k);
+                data_.swap(fresh);
+                rows_ = expr.rows();
+                cols_ = expr.cols();
+                return *this;
+            }
+            rows_ = expr.rows();
+            cols_ = expr.cols();
+        }
+        assign(expr.self());
+        return *this;
+    }
+
+    template <typename E>
+    Matrix &operator+=(const MatrixExpr<E> &expr)
+    {
+        checkSameShape(expr.rows(), expr.cols());
+        double *out = data();
+        const E &e = expr.self();
+        for (size_t k = 0, n = size(); k < n; k++)
+            out[k] += e.at(k);
+        return *this;
+    }
+
+    template <typename E>
+    Matrix &operator-=(const MatrixExpr<E> &expr)
+    {
+        checkSameShape(expr.rows(), expr.cols());
+        double *out = data();
+        const E &e = expr.self();
+        for (size_t k = 0, n = size(); k < n; k++)
+            out[k] -= e.at(k);
+        return *this;
+    }
+
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    size_t size() const { return data_.size(); }
+    bool empty() const { return data_.empty(); }
+
+    double &operator()(size_t i, size_t j) { return data_[i * cols_ + j]; }
+    double operator()(size_t i, size_t j) const { return data_[i * cols_ + j]; }
+    double at(size_t k) const { return data_[k]; }
+
+    double *data() { return data_.data(); }
+    const double *data() const { return data_.data(); }
+
+private:
+    template <typename E>
+    void assign(const E &e)
+    {
+        double *out = data();
+        for (size_t k = 0, n = size(); k < n; k++)
+            out[k] = e.at(k);
+    }
+
+    void checkSameShape(size_t rows, size_t cols) const
+    {
+        if (rows != rows_ || cols != cols_)
+            throw std::invalid_argument("Matrix dimensions do not match");
+    }
+
+    size_t rows_;
+    size_t cols_;
+    std::vector<double> data_;
+};
+
+struct MatrixAddOp
+{
+    static double apply(double a, double b) { return a + b; }
+};
+
+struct MatrixSubOp
+{
+    static double apply(double a, double b) { return a - b; }
+};
+
+struct MatrixMulOp
+{
+    static double apply(double a, double b) { return a * b; }
+};
+
+template <typename L, typename R, typename Op>
+class MatrixBinaryExpr : public MatrixExpr<MatrixBinaryExpr<L, R, Op> >
+{
+public:
+    MatrixBinaryExpr(const L &lhs, const R &rhs) : lhs_(lhs), rhs_(rhs)
+    {
+        if (lhs.rows() != rhs.rows() || lhs.cols() != rhs.cols())
+            throw std::invalid_argument("Matrix dimensions do not match");
+    }
+
+    size_t rows() const { return lhs_.rows(); }
+    size_t cols() const { return lhs_.cols(); }
+    double at(size_t k) const { return Op::apply(lhs_.at(k), rhs_.at(k)); }
+
+private:
+    typename MatrixOperand<L>::type lhs_;
+    typename MatrixOperand<R>::type rhs_;
+};
+
+// expr * scale + offset, which covers negation, scalar multiply/divide and scalar add
+template <typename E>
+class MatrixAffineExpr : public MatrixExpr<MatrixAffineExpr<E> >
+{
+public:
+    MatrixAffineExpr(const E &expr, double scale, double offset)
+        : expr_(expr), scale_(scale), offset_(offset) {}
+
+    size_t rows() const { return expr_.rows(); }
+    size_t cols() const { return expr_.cols(); }
+    double at(size_t k) const { return expr_.at(k) * scale_ + offset_; }
+
+private:
+    typename MatrixOperand<E>::type expr_;
+    double scale_;
+    double offset_;
+};
+
+template <typename L, typename R>
+MatrixBinaryExpr<L, R, MatrixAddOp> operator+(const MatrixExpr<L> &lhs, const MatrixExpr<R> &rhs)
+{
+    return MatrixBinaryExpr<L, R, MatrixAddOp>(lhs.self(), rhs.self());
+}
+
+template <typename L, typename R>
+MatrixBinaryExpr<L, R, MatrixSubOp> operator-(const MatrixExpr<L> &lhs, const MatrixExpr<R> &rhs)
+{
+    return MatrixBinaryExpr<L, R, MatrixSubOp>(lhs.self(), rhs.self());
+}
+
+// Elementwise (Hadamard) product; operator* between matrices is left free for
+// the algebraic product.
+template <typename L, typename R>
+MatrixBinaryExpr<L, R, MatrixMulOp> hadamard(const MatrixExpr<L> &lhs, const MatrixExpr<R> &rhs)
+{
+    return MatrixBinaryExpr<L, R, MatrixMulOp>(lhs.self(), rhs.self());
+}
+
+template <typename E>
+MatrixAffineExpr<E> operator-(const MatrixExpr<E> &expr)
+{
+    return MatrixAffineExpr<E>(expr.self(), -1.0, 0.0);
+}
+
+template <typename E>
+MatrixAffineExpr<E> operator*(double scale, const MatrixExpr<E> &expr)
+{
+    return MatrixAffineExpr<E>(expr.self(), scale, 0.0);
+}
+
+template <typename E>
+MatrixAffineExpr<E> operator*(const MatrixExpr<E> &expr, double scale)
+{
+    return MatrixAffineExpr<E>(expr.self(), scale, 0.0);
+}
+
+template <typename E>
+MatrixAffineExpr<E> operator/(const MatrixExpr<E> &expr, double divisor)
+{
+    return MatrixAffineExpr<E>(expr.self(), 1.0 / divisor, 0.0);
+}
+
+template <typename E>
+MatrixAffineExpr<E> operator+(const MatrixExpr<E> &expr, double offset)
+{
+    return MatrixAffineExpr<E>(expr.self(), 1.0, offset);
+}
+
+template <typename E>
+MatrixAffineExpr<E> operator-(const MatrixExpr<E> &expr, double offset)
+{
+    return MatrixAffineExpr<E>(expr.self(), 1.0, -offset);
+}
+
+// Matrix product in i-k-j order, which walks both operands row-wise
+Matrix matrixProduct(const Matrix &a, const Matrix &b);
+
+Matrix transposed(const Matrix &m);
+
+// Binary matrix file format (.cmat)
+// A fixed 64-byte header followed by the raw row-major payload. The payload
+// starts on an aligned offset so a mapped file can be used in place.
+const char MATRIX_FILE_MAGIC[8] = {'C', 'A', 'L', 'C', 'M', 'A', 'T', '\0'};
+const uint32_t MATRIX_FILE_VERSION = 1;
+const uint32_t MATRIX_DTYPE_FLOAT64 = 1;
+const uint32_t MATRIX_FILE_ALIGNMENT = 64;
+const uint32_t MATRIX_ENDIAN_TAG = 0x01020304;
+
+struct MatrixFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t dataOffset; // byte offset of payload, multiple of alignment
+    uint32_t alignment;
+    uint32_t endianTag; // written in native order, checked on load
+    uint8_t reserved[16];
+};
+static_assert(sizeof(MatrixFileHeader) == MATRIX_FILE_ALIGNMENT, "matrix header must fill one aligned block");
+
+MatrixFileHeader makeMatrixHeader(size_t rows, size_t cols);
+
+// Throws if the header does not describe a matrix we can read from a file of fileSize bytes
+void validateMatrixHeader(const MatrixFileHeader &header, uint64_t fileSize);
+
+// Writes header and payload through writeFileAtomically, so a failed save
+// leaves any previous file in place
+void saveMatrixBinary(const Matrix &matrix, const std::string &filename);
+
+// Read-only view of a binary matrix file. On POSIX the file is mapped and
+// elements are read in place; elsewhere the payload is read into memory.
+class MappedMatrix
+{
+public:
+    explicit MappedMatrix(const std::string &filename);
+
+    ~MappedMatrix() { release(); }
+
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    const double *data() const { return values_; }
+    double operator()(size_t i, size_t j) const { return values_[i * cols_ + j]; }
+
+    Matrix toMatrix() const;
+
+private:
+    MappedMatrix(const MappedMatrix &);
+    MappedMatrix &operator=(const MappedMatrix &);
+
+    void release();
+
+    void *base_;
+    size_t length_;
+    size_t rows_;
+    size_t cols_;
+    const double *values_;
+#ifdef _WIN32
+    std::vector<double> buffer_;
+#endif
+};
+
+bool isBinaryMatrixFile(const std::string &filename);
+
+// Text matrix loader for interchange. Accepts the "Matrix (RxC)" files written by
+// saveMatrixToFile as well as plain whitespace-separated rows. The whole file is
+// read with one call and parsed in place with strtod.
+Matrix loadMatrixText(const std::string &filename);
+
+// Loads either format, detected by the file magic
+Matrix loadMatrixFromFile(const std::string &filename);
+
+// Summary statistics of a data set (population variance). modes holds every
+// value of the highest frequency, so it equals the data size when all differ
+struct StatisticsSummary
+{
+    size_t count;
+    double sum;
+    double mean;
+    double median;
+    double minimum;
+    double maximum;
+    double variance;
+    std::vector<double> modes;
+};
+
+// The sorted copy of data is taken from scratch
+StatisticsSummary computeStatistics(const std::vector<double> &data,
+                                    std::pmr::memory_resource *scratch = std::pmr::get_default_resource());
+
+// Compensated summation
+// A running total kept as its double sum plus the rounding error the sum has
+// lost so far (Knuth's TwoSum, exact in binary floating point), so adding
+// millions of values stays accurate to about one rounding of the true total.
+// The bulk kernels are branch-free loops the compiler vectorizes at -O3;
+// -ffast-math would reassociate the error terms away and must not be used.
+struct CompensatedSum
+{
+    double sum = 0.0;
+    double error = 0.0;
+
+    double value() const { return sum + error; }
+
+    void add(double x)
+    {
+        double t = sum + x;
+        double z = t - sum;
+        error += (sum - (t - z)) + (x - z);
+        sum = t;
+    }
+};
+
+// total += sign * (values[0] + ... + values[n - 1]), summed in independent
+// lanes that are folded into total at the end
+void accumulate(CompensatedSum &total, const double *values, size_t n, double sign = 1.0);
+
+// sums[i] += sign * values[i] for i < n, each with its own error term errors[i]
+void accumulateElements(double *sums, double *errors, const double *values, size_t n, double sign = 1.0);
+
+// Lookup-table backend for sin/cos/tan and ln/log2/log10
+// One table holds a full period of sin (cos reads it a quarter period ahead),
+// the other log2 over the mantissa range [1, 2]; the exponent bits supply the
+// integer part of log2. Both carry a guard point on each side so linear and
+// 4-point cubic (Lagrange) interpolation never wrap inside a lookup.
+class LookupTables
+{
+public:
+    enum Interpolation
+    {
+        LINEAR,
+        CUBIC
+    };
+
+    static const unsigned MIN_LOG2_ENTRIES = 4;
+    static const unsigned MAX_LOG2_ENTRIES = 20;
+    // Angles beyond this lose phase accuracy in the index computation
+    static constexpr double MAX_ANGLE = 1048576.0;
+
+    // The tables are computed, or copied from sinValues and log2Values when
+    // both are given: tableSize() values each, saved from tables of the same size
+    LookupTables(unsigned log2Entries, Interpolation interpolation, const double *sinValues = nullptr,
+                 const double *log2Values = nullptr);
+
+    unsigned log2Entries() const { return log2Entries_; }
+    size_t entries() const { return entries_; }
+    // Stored values per table: entries plus the points interpolation reads past either end
+    size_t tableSize() const { return entries_ + 3; }
+    const double *sinValues() const { return sin_.data(); }
+    const double *log2Values() const { return log2_.data(); }
+    size_t bytes() const { return (sin_.size() + log2_.size()) * sizeof(double); }
+    Interpolation interpolation() const { return interpolation_; }
+
+    double sin(double x) const { return periodic(x, 0); }
+    double cos(double x) const { return periodic(x, entries_ / 4); }
+    double tan(double x) const { return sin(x) / cos(x); }
+
+    double log2(double x) const
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        // Zero, negative, subnormal, infinite and NaN arguments go to libm
+        if (bits - 0x0010000000000000ULL >= 0x7fe0000000000000ULL)
+            return std::log2(x);
+        // Top mantissa bits pick the table point, the rest is the fraction between points
+        const unsigned fracBits = 52 - log2Entries_;
+        uint64_t mantissa = bits & 0x000fffffffffffffULL;
+        double exponent = static_cast<double>(static_cast<int>(bits >> 52) - 1023);
+        double frac = static_cast<double>(static_cast<int64_t>(mantissa & ((uint64_t(1) << fracBits) - 1))) * fracScale_;
+        return exponent + interpolate(log2_.data(), mantissa >> fracBits, frac);
+    }
+
+    double ln(double x) const { return log2(x) * M_LN2; }
+    double log10(double x) const { return log2(x) * (M_LN2 / M_LN10); }
+
+private:
+    unsigned log2Entries_;
+    size_t entries_;
+    Interpolation interpolation_;
+    double fracScale_;
+    std::vector<double> sin_;
+    std::vector<double> log2_;
+
+    double periodic(double x, size_t shift) const
+    {
+        if (!(std::fabs(x) <= MAX_ANGLE))
+            return shift ? std::cos(x) : std::sin(x);
+        double t = x * (entries_ / (2.0 * M_PI));
+        // floor without a libm call: truncate, then step down for negative t
+        int64_t whole = static_cast<int64_t>(t);
+        whole -= t < static_cast<double>(whole);
+        size_t index = (static_cast<size_t>(whole) + shift) & (entries_ - 1);
+        return interpolate(sin_.data(), index, t - static_cast<double>(whole));
+    }
+
+    // Value between point i and i + 1 of a table stored with one leading guard point
+    double interpolate(const double *table, size_t i, double t) const
+    {
+        const double *p = table + i;
+        if (interpolation_ == LINEAR)
+            return p[1] + t * (p[2] - p[1]);
+        // Lagrange polynomial through points i - 1 .. i + 2, in Horner form
+        double c1 = p[2] - (1.0 / 3.0) * p[0] - 0.5 * p[1] - (1.0 / 6.0) * p[3];
+        double c2 = 0.5 * (p[0] + p[2]) - p[1];
+        double c3 = 0.5 * (p[1] - p[2]) + (1.0 / 6.0) * (p[3] - p[0]);
+        return p[1] + t * (c1 + t * (c2 + t * c3));
+    }
+};
+
+// Active backend for the scalar trig and log functions; null means libm.
+// Not synchronized: replace it only while no other thread uses the backend
+extern std::unique_ptr<const LookupTables> lookupTables;
+
+double backendSin(double x);
+double backendCos(double x);
+double backendTan(double x);
+double backendLn(double x);
+double backendLog2(double x);
+double backendLog10(double x);
+
+// Scalar kernels behind the menu functions. Invalid arguments throw
+// std::domain_error carrying the message the menu shows. The trig and log
+// kernels go through the active lookupTables backend.
+double add(double a, double b);
+double subtract(double a, double b);
+double multiply(double a, double b);
+double divide(double a, double b);
+double modulus(double a, double b);
+double percentage(double value, double percent);
+double cosecant(double angle);
+double secant(double angle);
+double cotangent(double angle);
+double arcsine(double x);
+double arccosine(double x);
+double naturalLog(double x);
+double log10Func(double x);
+double log2Func(double x);
+double logBase(double x, double base);
+double squareRoot(double x);
+double nthRoot(double x, double degree);
+
+// Accuracy and speed of one table configuration
+struct LookupTableReport
+{
+    size_t entries;
+    size_t bytes;
+    LookupTables::Interpolation interpolation;
+    double sinError; // max absolute error over one period
+    double logError; // max absolute error of log2 over [2^-8, 2^8]
+    double nsPerCall;
+};
+
+// Average time of one sin or log2 call over arguments in (0, 10]
+template <typename SinFn, typename LogFn>
+double nsPerSinLog2Call(SinFn sinFn, LogFn logFn)
+{
+    std::vector<double> args(4096);
+    for (size_t k = 0; k < args.size(); k++)
+        args[k] = 0.001 + 10.0 * k / args.size();
+    const int ROUNDS = 64;
+    volatile double sink = 0.0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        double sum = 0.0;
+        for (double a : args)
+            sum += sinFn(a) + logFn(a);
+        sink = sink + sum;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / (2.0 * ROUNDS * args.size());
+}
+
+LookupTableReport measureLookupTables(unsigned log2Entries, LookupTables::Interpolation interpolation);
+
+// Vectorized elementary functions
+// Array versions of sin, cos, tan, exp, ln, log2, log10 and pow. Each fast
+// kernel is one branch-free loop of polynomial code over doubles and 64-bit
+// integers, which the compiler vectorizes; inputs outside the polynomial's
+// range (huge angles, overflow, zero, negatives, NaN, subnormals) are flagged
+// in the same loop and recomputed with libm afterwards. The loops only
+// vectorize at -O3 (or -O2 -ftree-vectorize). Maximum errors measured over
+// 10^7 random arguments against long double references:
+//   sin, cos        1.6 ULP for |x| <= 2^20 (libm above)
+//   tan             3.7 ULP for |x| <= 2^20
+//   exp             1.2 ULP for -708 <= x <= 709 (libm outside, incl. subnormals)
+//   ln              0.9 ULP for positive normal x
+//   log2, log10     2.6 ULP
+//   pow(x, y)       2.3 ULP for |y| <= 20, then about |y| / 10 ULP
+// STRICT accuracy runs the plain libm loop instead.
+class VectorMath
+{
+public:
+    enum Function
+    {
+        SIN,
+        COS,
+        TAN,
+        EXP,
+        LN,
+        LOG2,
+        LOG10
+    };
+
+    enum Accuracy
+    {
+        FAST,
+        STRICT
+    };
+
+    static void apply(Function f, const double *in, double *out, size_t n, Accuracy accuracy = FAST);
+
+    // out[i] = base[i]^exponent
+    static void pow(const double *base, double exponent, double *out, size_t n, Accuracy accuracy = FAST);
+
+    static void applyLibm(Function f, const double *in, double *out, size_t n);
+
+    // Unchecked scalar kernels, also used inside other vectorized loops
+    // sin and cos on [-pi/4, pi/4] (Cephes minimax coefficients)
+    static double sinPoly(double y)
+    {
+        double z = y * y;
+        double p = ((((1.58962301576546568060e-10 * z - 2.50507477628578072866e-8) * z + 2.75573136213857245213e-6) * z -
+                     1.98412698295895385996e-4) * z + 8.33333333332211858878e-3) * z - 1.66666666666666307295e-1;
+        return y + y * z * p;
+    }
+
+    static double cosPoly(double y)
+    {
+        double z = y * y;
+        double p = ((((-1.13585365213876817300e-11 * z + 2.08757008419747316778e-9) * z - 2.75573141792967388112e-7) * z +
+                     2.48015872888517045348e-5) * z - 1.38888888888730564116e-3) * z + 4.16666666666665929218e-2;
+        return 1.0 - 0.5 * z + z * z * p;
+    }
+
+    // e^x = 2^j * e^r with r = x - j ln2, |r| <= ln2/2; Taylor polynomial to r^13
+    static double expCore(double x)
+    {
+        const double LOG2E = 1.44269504088896338700;
+        const double LN2_HI = 6.93147180369123816490e-01;
+        const double LN2_LO = 1.90821492927058770002e-10;
+        double shifted = x * LOG2E + ROUND_MAGIC;
+        double j = shifted - ROUND_MAGIC;
+        double r = (x - j * LN2_HI) - j * LN2_LO;
+        double p = 1.0 / 6227020800.0;
+        p = p * r + 1.0 / 479001600.0;
+        p = p * r + 1.0 / 39916800.0;
+        p = p * r + 1.0 / 3628800.0;
+        p = p * r + 1.0 / 362880.0;
+        p = p * r + 1.0 / 40320.0;
+        p = p * r + 1.0 / 5040.0;
+        p = p * r + 1.0 / 720.0;
+        p = p * r + 1.0 / 120.0;
+        p = p * r + 1.0 / 24.0;
+        p = p * r + 1.0 / 6.0;
+        p = p * r + 0.5;
+        p = p * r + 1.0;
+        p = p * r + 1.0;
+        uint64_t scale = (toBits(shifted) - ROUND_MAGIC_BITS + 1023) << 52;
+        return p * fromBits(scale);
+    }
+
+    // x = 2^k * m with m in [sqrt(2)/2, sqrt(2)), all in integer arithmetic;
+    // log(m) = f - f^2/2 + s (f^2/2 + R(s^2)) with f = m - 1, s = f / (2 + f)
+    // (fdlibm's minimax R). Only valid for positive normal x.
+    template <Function Base>
+    static double logCore(double x)
+    {
+        const double LN2_HI = 6.93147180369123816490e-01;
+        const double LN2_LO = 1.90821492927058770002e-10;
+        const double INV_LN2 = 1.44269504088896338700;
+        const double LOG10_2_HI = 3.01029995663611771306e-01;
+        const double LOG10_2_LO = 3.69423907715893078616e-13;
+        const double INV_LN10 = 4.34294481903251816668e-01;
+        const uint64_t SQRT_HALF_BITS = 0x3fe6a09e667f3bcdULL;
+
+        uint64_t bits = toBits(x) + (0x3ff0000000000000ULL - SQRT_HALF_BITS);
+        uint64_t k = (bits >> 52) - 1023;
+        double m = fromBits((bits & 0x000fffffffffffffULL) + SQRT_HALF_BITS);
+        double dk = fromBits(ROUND_MAGIC_BITS + k) - ROUND_MAGIC;
+
+        double f = m - 1.0;
+        double hfsq = 0.5 * f * f;
+        double s = f / (2.0 + f);
+        double z = s * s, w = z * z;
+        double t1 = w * (3.999999999940941908e-01 + w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+        double t2 = z * (6.666666666666735130e-01 +
+                         w * (2.857142874366239149e-01 + w * (1.818357216161805012e-01 + w * 1.479819860511658591e-01)));
+        double r = t1 + t2;
+        switch (Base)
+        {
+        case LOG2:
+            return dk + (f - hfsq + s * (hfsq + r)) * INV_LN2;
+        case LOG10:
+            return dk * LOG10_2_HI + (dk * LOG10_2_LO + (f - hfsq + s * (hfsq + r)) * INV_LN10);
+        default:
+            return dk * LN2_HI - ((hfsq - (s * (hfsq + r) + dk * LN2_LO)) - f);
+        }
+    }
+
+private:
+    // Adding and subtracting 1.5 * 2^52 rounds to the nearest integer, and the
+    // low bits of the sum hold that integer in two's complement
+    static constexpr double ROUND_MAGIC = 6755399441055744.0;
+    static constexpr uint64_t ROUND_MAGIC_BITS = 0x4338000000000000ULL;
+    static constexpr uint64_t SIGN_BIT = 0x8000000000000000ULL;
+    // Bit patterns of the fast-path bounds: 2^20, 708, 709, DBL_MIN and DBL_MAX
+    static constexpr uint64_t TRIG_LIMIT_BITS = 0x4130000000000000ULL;
+    static constexpr uint64_t EXP_MIN_BITS = 0x4086200000000000ULL;
+    static constexpr uint64_t EXP_MAX_BITS = 0x4086280000000000ULL;
+    static constexpr uint64_t MIN_NORMAL_BITS = 0x0010000000000000ULL;
+    static constexpr uint64_t MAX_FINITE_BITS = 0x7fefffffffffffffULL;
+
+    static uint64_t toBits(double x)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        return bits;
+    }
+
+    static double fromBits(uint64_t bits)
+    {
+        double x;
+        std::memcpy(&x, &bits, sizeof(x));
+        return x;
+    }
+
+    // Range checks are done on the bit patterns and return 0 or 1: compares on
+    // doubles would stop the loops from vectorizing. (a - b) >> 63 is 1 exactly
+    // when b > a for values below 2^63; NaN patterns sort above infinity.
+    static uint64_t aboveTrigLimit(double x)
+    {
+        return (TRIG_LIMIT_BITS - (toBits(x) & ~SIGN_BIT)) >> 63;
+    }
+
+    // Outside [-708, 709], or NaN
+    static uint64_t outsideExpRange(double x)
+    {
+        uint64_t bits = toBits(x);
+        uint64_t negative = 0 - (bits >> 63);
+        uint64_t limit = EXP_MAX_BITS ^ (negative & (EXP_MAX_BITS ^ EXP_MIN_BITS));
+        return (limit - (bits & ~SIGN_BIT)) >> 63;
+    }
+
+    // Zero, negative, subnormal, infinite or NaN
+    static uint64_t notPositiveNormal(double x)
+    {
+        uint64_t bits = toBits(x);
+        return ((bits - MIN_NORMAL_BITS) >> 63) | ((MAX_FINITE_BITS - bits) >> 63);
+    }
+
+    // Reduces x by the nearest multiple j of pi/2 (three-part Cody-Waite
+    // constant, exact for |j| < 2^29) and picks the polynomial by quadrant.
+    // QuadrantShift is 1 for cos(x) = sin(x + pi/2).
+    template <uint64_t QuadrantShift, bool Tangent>
+    static void trig(const double *in, double *out, size_t n)
+    {
+        const double TWO_OVER_PI = 0.63661977236758134308;
+        const double PIO2_1 = 1.57079625129699707031e+00;
+        const double PIO2_2 = 7.54978941586159635336e-08;
+        const double PIO2_3 = 5.39030285815811905290e-15;
+        uint64_t outliers = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            double x = in[i];
+            double shifted = x * TWO_OVER_PI + ROUND_MAGIC;
+            double j = shifted - ROUND_MAGIC;
+            uint64_t quadrant = toBits(shifted) + QuadrantShift;
+            double y = ((x - j * PIO2_1) - j * PIO2_2) - j * PIO2_3;
+
+            uint64_t s = toBits(sinPoly(y)), c = toBits(cosPoly(y));
+            uint64_t odd = 0 - (quadrant & 1);
+            if (Tangent)
+            {
+                // tan = sin/cos on even quadrants, -cos/sin on odd ones
+                double num = fromBits((c & odd) | (s & ~odd));
+                double den = fromBits((s & odd) | (c & ~odd));
+                out[i] = fromBits(toBits(num / den) ^ (odd & SIGN_BIT));
+            }
+            else
+            {
+                uint64_t r = (c & odd) | (s & ~odd);
+                out[i] = fromBits(r ^ ((quadrant & 2) << 62));
+            }
+            outliers |= aboveTrigLimit(x);
+        }
+        if (outliers == 0)
+            return;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (aboveTrigLimit(in[i]))
+                out[i] = Tangent ? std::tan(in[i]) : (QuadrantShift ? std::cos(in[i]) : std::sin(in[i]));
+        }
+    }
+
+    static void exp(const double *in, double *out, size_t n);
+
+    // Error-free transformations: a + b = sum + err and a * b = prod + err exactly
+    static void twoSum(double a, double b, double &sum, double &err)
+    {
+        sum = a + b;
+        double bv = sum - a;
+        err = (a - (sum - bv)) + (b - bv);
+    }
+
+    static void twoProduct(double a, double b, double &prod, double &err)
+    {
+        const double SPLIT = 134217729.0; // 2^27 + 1
+        double ca = SPLIT * a, cb = SPLIT * b;
+        double aHi = ca - (ca - a), aLo = a - aHi;
+        double bHi = cb - (cb - b), bLo = b - bHi;
+        prod = a * b;
+        err = ((aHi * bHi - prod) + aHi * bLo + aLo * bHi) + aLo * bLo;
+    }
+
+    // y * ln(x) as t + tail, with ln(x) carried in double-double so pow does
+    // not inherit the full rounding error of ln(x) multiplied by y
+    static void scaledLog(double x, double y, double &t, double &tail)
+    {
+        const double LN2_HI = 6.93147180369123816490e-01;
+        const double LN2_LO = 1.90821492927058770002e-10;
+        const uint64_t SQRT_HALF_BITS = 0x3fe6a09e667f3bcdULL;
+
+        uint64_t bits = toBits(x) + (0x3ff0000000000000ULL - SQRT_HALF_BITS);
+        uint64_t k = (bits >> 52) - 1023;
+        double m = fromBits((bits & 0x000fffffffffffffULL) + SQRT_HALF_BITS);
+        double dk = fromBits(ROUND_MAGIC_BITS + k) - ROUND_MAGIC;
+
+        double f = m - 1.0;
+        double square, squareErr;
+        twoProduct(f, f, square, squareErr);
+        double hfsq = 0.5 * square;
+        double s = f / (2.0 + f);
+        double z = s * s, w = z * z;
+        double t1 = w * (3.999999999940941908e-01 + w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+        double t2 = z * (6.666666666666735130e-01 +
+                         w * (2.857142874366239149e-01 + w * (1.818357216161805012e-01 + w * 1.479819860511658591e-01)));
+        double small = s * (hfsq + t1 + t2) - 0.5 * squareErr + dk * LN2_LO;
+
+        // dk * LN2_HI is exact; f and hfsq are added without rounding loss
+        double hi, lo, err1, err2;
+        twoSum(dk * LN2_HI, f, hi, err1);
+        twoSum(hi, -hfsq, hi, err2);
+        lo = err1 + err2 + small;
+
+        double prod, prodErr;
+        twoProduct(y, hi, prod, prodErr);
+        twoSum(prod, prodErr + y * lo, t, tail);
+    }
+
+    template <Function Base>
+    static void log(const double *in, double *out, size_t n)
+    {
+        uint64_t outliers = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            out[i] = logCore<Base>(in[i]);
+            outliers |= notPositiveNormal(in[i]);
+        }
+        if (outliers == 0)
+            return;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (notPositiveNormal(in[i]))
+                out[i] = Base == LN ? std::log(in[i]) : (Base == LOG2 ? std::log2(in[i]) : std::log10(in[i]));
+        }
+    }
+};
+
+// Cached table of small primes, shared by the sieve and later prime queries.
+// Snapshots are immutable, so readers never race with a table that is growing.
+class PrimeTable
+{
+public:
+    static std::shared_ptr<const std::vector<uint32_t>> primesUpTo(uint32_t limit);
+
+    // Membership test for n within the cached range
+    static bool contains(const std::vector<uint32_t> &primes, uint64_t n)
+    {
+        return std::binary_search(primes.begin(), primes.end(), n);
+    }
+
+private:
+    static std::shared_ptr<const std::vector<uint32_t>> build(uint32_t limit);
+
+    static std::mutex &mutex()
+    {
+        static std::mutex m;
+        return m;
+    }
+
+    static std::shared_ptr<const std::vector<uint32_t>> &current()
+    {
+        static std::shared_ptr<const std::vector<uint32_t>> table;
+        return table;
+    }
+
+    static uint32_t &tableLimit()
+    {
+        static uint32_t limit = 0;
+        return limit;
+    }
+};
+
+uint32_t integerSqrt(uint64_t n);
+
+// Arbitrary-precision integers
+// Magnitudes are little-endian vectors of base-10^9 limbs, so decimal output is
+// a direct dump and limb products (< 10^18) fit in 64 bits. Zero has no limbs.
+class BigInt
+{
+public:
+    static const uint32_t BASE = 1000000000;
+    static const int BASE_DIGITS = 9;
+
+    BigInt() : negative_(false) {}
+    BigInt(uint64_t value);
+
+    static BigInt fromInt64(long long value)
+    {
+        BigInt r(value < 0 ? 0ULL - static_cast<uint64_t>(value) : static_cast<uint64_t>(value));
+        r.negative_ = value < 0;
+        return r;
+    }
+
+    // Parses an optionally signed decimal string; throws std::invalid_argument
+    static BigInt fromString(const std::string &text);
+
+    std::string toString() const;
+
+    size_t digitCount() const
+    {
+        if (isZero())
+            return 1;
+        return (limbs_.size() - 1) * BASE_DIGITS + std::to_string(limbs_.back()).size();
+    }
+
+    // Correctly rounded double; +-inf when the value exceeds the double range
+    double toDouble() const
+    {
+        if (limbs_.size() > 35)
+            return negative_ ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+        return std::strtod(toString().c_str(), nullptr);
+    }
+
+    bool fitsUint64() const
+    {
+        return !negative_ && (limbs_.size() <= 2 || (limbs_.size() == 3 && limbs_[2] < 18));
+    }
+
+    uint64_t toUint64() const;
+
+    bool isZero() const { return limbs_.empty(); }
+    bool isNegative() const { return negative_; }
+    BigInt abs() const
+    {
+        BigInt r = *this;
+        r.negative_ = false;
+        return r;
+    }
+
+    const std::vector<uint32_t> &limbs() const { return limbs_; }
+
+    friend bool operator==(const BigInt &a, const BigInt &b)
+    {
+        return a.negative_ == b.negative_ && a.limbs_ == b.limbs_;
+    }
+    friend bool operator!=(const BigInt &a, const BigInt &b) { return !(a == b); }
+    friend bool operator<(const BigInt &a, const BigInt &b);
+
+    friend BigInt operator+(const BigInt &a, const BigInt &b);
+
+    friend BigInt operator-(const BigInt &a, const BigInt &b)
+    {
+        BigInt nb = b;
+        nb.negative_ = !b.negative_ && !b.isZero();
+        return a + nb;
+    }
+
+    friend BigInt operator*(const BigInt &a, const BigInt &b)
+    {
+        return make(mulMag(a.limbs_, b.limbs_), a.negative_ != b.negative_);
+    }
+
+    // Truncating division (quotient rounds toward zero, remainder takes the dividend's sign)
+    static void divMod(const BigInt &a, const BigInt &b, BigInt &quotient, BigInt &remainder);
+
+    friend BigInt operator/(const BigInt &a, const BigInt &b)
+    {
+        BigInt q, r;
+        divMod(a, b, q, r);
+        return q;
+    }
+
+    friend BigInt operator%(const BigInt &a, const BigInt &b)
+    {
+        BigInt q, r;
+        divMod(a, b, q, r);
+        return r;
+    }
+
+    // In-place multiply by m < 2^32
+    void mulSmall(uint32_t m);
+
+    // In-place divide by d < 2^32, returns the remainder of the magnitude
+    uint32_t divSmall(uint32_t d);
+
+    // Product of an arbitrary list of factors, multiplied as a balanced tree so
+    // the large multiplications happen between operands of similar size.
+    static BigInt product(const std::vector<BigInt> &factors);
+
+    // Lehmer's gcd (Knuth, Algorithm 4.5.2L): most steps run on the leading
+    // two limbs in machine words and are applied to the full numbers as one
+    // linear combination; a full division is only needed when the leading
+    // quotients disagree.
+    static BigInt gcd(BigInt a, BigInt b);
+
+private:
+    static const size_t KARATSUBA_THRESHOLD = 40;
+
+    static BigInt make(std::vector<uint32_t> &&limbs, bool negative);
+
+    static BigInt make(const std::vector<uint32_t> &limbs, bool negative)
+    {
+        std::vector<uint32_t> copy = limbs;
+        return make(std::move(copy), negative);
+    }
+
+    void trim();
+
+    static void trimMag(std::vector<uint32_t> &v)
+    {
+        while (!v.empty() && v.back() == 0)
+            v.pop_back();
+    }
+
+    static uint64_t gcd64Words(uint64_t a, uint64_t b);
+
+    static int compareMag(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b);
+
+    static std::vector<uint32_t> addMag(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b);
+
+    // |a| - |b| for |a| >= |b|
+    static std::vector<uint32_t> subMag(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b);
+
+    // r[offset..] += a
+    static void addShifted(std::vector<uint32_t> &r, const std::vector<uint32_t> &a, size_t offset);
+
+    static std::vector<uint32_t> mulSchoolbook(const uint32_t *a, size_t n, const uint32_t *b, size_t m);
+
+    static std::vector<uint32_t> slice(const std::vector<uint32_t> &v, size_t begin, size_t end);
+
+    // Karatsuba: three half-size products instead of four, recursively
+    static std::vector<uint32_t> mulMag(const std::vector<uint32_t> &x, const std::vector<uint32_t> &y);
+
+    // Knuth, Algorithm 4.3.1D in base 10^9
+    static void divModMag(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b,
+                          std::vector<uint32_t> &q, std::vector<uint32_t> &r);
+
+    // x*a + y*b for word-sized signed cofactors; the result must be non-negative.
+    // Lehmer's cofactors stay below BASE^2 in magnitude, so each is split into
+    // two base-BASE digits and every partial product fits in 64 bits: limb i
+    // takes xLow*a[i] + xHigh*a[i-1] and the same for y, four terms below 10^18
+    static std::vector<uint32_t> linearCombination(const std::vector<uint32_t> &a, int64_t x,
+                                                   const std::vector<uint32_t> &b, int64_t y);
+
+    std::vector<uint32_t> limbs_;
+    bool negative_;
+};
+
+// Product lo * (lo + 1) * ... * hi by binary splitting; runs of factors are
+// multiplied in a 64-bit register before touching big integers.
+BigInt rangeProduct(uint64_t lo, uint64_t hi);
+
+BigInt bigFactorial(uint64_t n);
+
+// n! / (n - r)!, or 0 when r > n
+BigInt bigPermutation(uint64_t n, uint64_t r);
+
+// C(n, k) from its prime factorization: by Legendre's formula the exponent of
+// p is the number of borrows when subtracting k from n in base p. The prime
+// powers are then multiplied as a product tree.
+BigInt bigBinomial(uint64_t n, uint64_t k);
+
+// GCD and LCM
+int gcd(int a, int b);
+
+// Prime sieve engine
+// Segmented Sieve of Eratosthenes over a mod-30 wheel: every byte covers 30
+// consecutive integers and its 8 bits mark the residues coprime to 30, so
+// multiples of 2, 3 and 5 never take space. Multiples of 7, 11 and 13 are
+// removed by copying a precomputed 1001-byte pattern; larger sieving primes
+// cross off one residue class at a time with a byte stride equal to p, and
+// primes larger than a segment are kept in per-segment buckets.
+const uint32_t WHEEL30_RESIDUES[8] = {1, 7, 11, 13, 17, 19, 23, 29};
+const int8_t WHEEL30_BIT[30] = {-1, 0, -1, -1, -1, -1, -1, 1, -1, -1,
+                                -1, 2, -1, 3, -1, -1, -1, 4, -1, 5,
+                                -1, -1, -1, 6, -1, -1, -1, -1, -1, 7};
+const uint32_t SIEVE_PRESIEVE_BYTES = 7 * 11 * 13;
+const uint64_t SIEVE_MAX_LIMIT = 1ULL << 62;
+
+class PrimeSieve
+{
+public:
+    // Bytes of sieve per segment (~2M integers); sized to stay resident in L2
+    static constexpr size_t SEGMENT_BYTES = 64 * 1024;
+
+    // Number of primes in [lo, hi]; threads == 0 uses every hardware thread
+    static uint64_t countPrimes(uint64_t lo, uint64_t hi, unsigned threads = 0);
+
+    // Calls f(prime) for every prime in [lo, hi] in increasing order
+    template <typename F>
+    static void forEachPrime(uint64_t lo, uint64_t hi, F f)
+    {
+        checkRange(hi);
+        for (uint64_t p = 2; p <= 5; p += (p == 2 ? 1 : 2))
+            if (p >= lo && p <= hi)
+                f(p);
+        if (lo > hi)
+            return;
+
+        Segmenter sieve(lo / 30, hi / 30 + 1, hi);
+        while (sieve.next())
+        {
+            const uint8_t *bits = sieve.bits();
+            uint64_t base = sieve.segmentStart() * 30;
+            for (size_t b = 0; b < sieve.segmentLength(); b++)
+            {
+                unsigned byte = bits[b];
+                while (byte)
+                {
+                    unsigned bit = static_cast<unsigned>(countTrailingZeros(byte));
+                    byte &= byte - 1;
+                    uint64_t n = base + 30 * b + WHEEL30_RESIDUES[bit];
+                    if (n >= lo && n <= hi)
+                        f(n);
+                }
+            }
+        }
+    }
+
+    static std::vector<uint64_t> primesInRange(uint64_t lo, uint64_t hi);
+
+private:
+    struct SievingPrime
+    {
+        uint32_t prime;
+        uint8_t mask[8];
+        uint64_t next[8]; // absolute byte index of the next multiple per residue class
+    };
+
+    // Walks byte range [begin, end) one segment at a time
+    class Segmenter
+    {
+    public:
+        Segmenter(uint64_t begin, uint64_t end, uint64_t hi)
+            : begin_(begin), end_(end), segStart_(begin), segLength_(0), buffer_(SEGMENT_BYTES)
+        {
+            std::shared_ptr<const std::vector<uint32_t>> table = PrimeTable::primesUpTo(integerSqrt(hi) + 1);
+            primesHold_ = table;
+            uint32_t limit = integerSqrt(hi);
+            uint64_t buckets = 0;
+            for (size_t i = 0; i < table->size() && (*table)[i] <= limit; i++)
+            {
+                uint32_t p = (*table)[i];
+                if (p < 17)
+                    continue;
+                SievingPrime sp;
+                sp.prime = p;
+                // First multiple p*q >= max(p*p, 30*begin) in each q residue class
+                uint64_t minQ = std::max<uint64_t>(p, (30 * begin + p - 1) / p);
+                for (int c = 0; c < 8; c++)
+                {
+                    uint64_t q = minQ - minQ % 30 + WHEEL30_RESIDUES[c];
+                    if (q < minQ)
+                        q += 30;
+                    uint64_t m = static_cast<uint64_t>(p) * q;
+                    sp.next[c] = m / 30;
+                    sp.mask[c] = static_cast<uint8_t>(~(1u << WHEEL30_BIT[m % 30]));
+                }
+                if (p < SEGMENT_BYTES)
+                {
+                    primes_.push_back(sp);
+                    continue;
+                }
+
+                // Large primes hit a segment at most once per class, so they
+                // wait in the bucket of the segment holding their next multiple
+                // instead of being scanned every segment.
+                if (buckets == 0)
+                {
+                    buckets = limit / SEGMENT_BYTES + 2;
+                    buckets_.resize(static_cast<size_t>(buckets));
+                }
+                for (int c = 0; c < 8; c++)
+                    if (sp.next[c] < end_)
+                        bucketFor(sp.next[c]).push_back(BucketEntry(sp.next[c], p, sp.mask[c]));
+            }
+            pattern_ = presievePattern();
+        }
+
+        bool next()
+        {
+            segStart_ += segLength_;
+            if (segStart_ >= end_)
+                return false;
+            segLength_ = static_cast<size_t>(std::min<uint64_t>(SEGMENT_BYTES, end_ - segStart_));
+            uint8_t *seg = buffer_.data();
+
+            // Pre-sieved pattern for 7, 11, 13
+            size_t offset = static_cast<size_t>(segStart_ % SIEVE_PRESIEVE_BYTES);
+            size_t filled = 0;
+            while (filled < segLength_)
+            {
+                size_t chunk = std::min<size_t>(SIEVE_PRESIEVE_BYTES - offset, segLength_ - filled);
+                std::memcpy(seg + filled, pattern_ + offset, chunk);
+                filled += chunk;
+                offset = 0;
+            }
+            if (segStart_ == 0)
+            {
+                seg[0] &= static_cast<uint8_t>(~1u); // 1 is not prime
+                seg[0] |= 0x0E;                      // 7, 11, 13 are
+            }
+
+            uint64_t segEnd = segStart_ + segLength_;
+            for (size_t i = 0; i < primes_.size(); i++)
+            {
+                SievingPrime &sp = primes_[i];
+                uint64_t step = sp.prime;
+                for (int c = 0; c < 8; c++)
+                {
+                    uint64_t b = sp.next[c];
+                    uint8_t mask = sp.mask[c];
+                    for (; b < segEnd; b += step)
+                        seg[b - segStart_] &= mask;
+                    sp.next[c] = b;
+                }
+            }
+
+            if (!buckets_.empty())
+            {
+                std::vector<BucketEntry> &due = bucketFor(segStart_);
+                current_.swap(due);
+                due.clear();
+                for (size_t i = 0; i < current_.size(); i++)
+                {
+                    BucketEntry e = current_[i];
+                    if (e.next >= segEnd)
+                    {
+                        // First multiple lies more than one bucket ring ahead
+                        bucketFor(e.next).push_back(e);
+                        continue;
+                    }
+                    seg[e.next - segStart_] &= e.mask;
+                    e.next += e.prime;
+                    if (e.next < end_)
+                        bucketFor(e.next).push_back(e);
+                }
+                current_.clear();
+            }
+            return true;
+        }
+
+        const uint8_t *bits() const { return buffer_.data(); }
+        uint64_t segmentStart() const { return segStart_; }
+        size_t segmentLength() const { return segLength_; }
+
+    private:
+        static const uint8_t *presievePattern()
+        {
+            static const std::vector<uint8_t> pattern = buildPattern();
+            return pattern.data();
+        }
+
+        static std::vector<uint8_t> buildPattern()
+        {
+            std::vector<uint8_t> pattern(SIEVE_PRESIEVE_BYTES, 0xFF);
+            const uint32_t small[3] = {7, 11, 13};
+            for (uint32_t b = 0; b < SIEVE_PRESIEVE_BYTES; b++)
+                for (int c = 0; c < 8; c++)
+                {
+                    uint32_t n = 30 * b + WHEEL30_RESIDUES[c];
+                    for (int k = 0; k < 3; k++)
+                        if (n % small[k] == 0)
+                            pattern[b] &= static_cast<uint8_t>(~(1u << c));
+                }
+            return pattern;
+        }
+
+        struct BucketEntry
+        {
+            BucketEntry(uint64_t n, uint32_t p, uint8_t m) : next(n), prime(p), mask(m) {}
+            uint64_t next;
+            uint32_t prime;
+            uint8_t mask;
+        };
+
+        std::vector<BucketEntry> &bucketFor(uint64_t byteIndex)
+        {
+            return buckets_[static_cast<size_t>((byteIndex - begin_) / SEGMENT_BYTES % buckets_.size())];
+        }
+
+        uint64_t begin_;
+        uint64_t end_;
+        uint64_t segStart_;
+        size_t segLength_;
+        std::vector<uint8_t> buffer_;
+        std::vector<SievingPrime> primes_;
+        std::vector<std::vector<BucketEntry>> buckets_;
+        std::vector<BucketEntry> current_;
+        std::shared_ptr<const std::vector<uint32_t>> primesHold_;
+        const uint8_t *pattern_;
+    };
+
+    static void checkRange(uint64_t hi)
+    {
+        if (hi >= SIEVE_MAX_LIMIT)
+            throw std::out_of_range("Sieve limit must be below 2^62");
+    }
+
+    // Counts primes >= 7 in byte range [begin, end), clipped to [lo, hi]
+    static uint64_t countBytes(uint64_t begin, uint64_t end, uint64_t lo, uint64_t hi);
+
+    static uint64_t edgeBits(uint8_t byte, uint64_t index, uint64_t lo, uint64_t hi);
+};
+
+// NEW: Prime number checker
+// 64-bit Montgomery arithmetic modulo an odd n. Values are kept in Montgomery
+// form (a * 2^64 mod n) so every modular multiply is two 64x64->128 multiplies
+// (mulHigh for the upper halves) instead of a 128-bit division.
+class Montgomery64
+{
+public:
+    explicit Montgomery64(uint64_t n);
+
+    uint64_t modulus() const { return n_; }
+    uint64_t one() const { return one_; }
+    uint64_t toMont(uint64_t a) const { return mul(a % n_, r2_); }
+    uint64_t fromMont(uint64_t a) const { return reduce(0, a); }
+
+    // (hi * 2^64 + lo) / 2^64 mod n
+    uint64_t reduce(uint64_t hi, uint64_t lo) const
+    {
+        uint64_t m = lo * nInv_;
+        uint64_t mnHi = mulHigh(m, n_);
+        return hi >= mnHi ? hi - mnHi : hi - mnHi + n_;
+    }
+
+    uint64_t mul(uint64_t a, uint64_t b) const
+    {
+        return reduce(mulHigh(a, b), a * b);
+    }
+
+    uint64_t add(uint64_t a, uint64_t b) const
+    {
+        uint64_t s = a + b;
+        return (s >= n_ || s < a) ? s - n_ : s;
+    }
+
+    uint64_t pow(uint64_t base, uint64_t exponent) const;
+
+private:
+    uint64_t n_;
+    uint64_t nInv_;
+    uint64_t one_;
+    uint64_t r2_;
+};
+
+// One Miller-Rabin round for odd n > 2 with n - 1 = d * 2^s
+bool millerRabinRound(const Montgomery64 &mont, uint64_t base, uint64_t d, int s);
+
+// Deterministic for every 64-bit n: below 2^32 the bases {2, 7, 61} suffice,
+// above it the seven bases found by Jim Sinclair cover the whole range.
+bool isPrime(uint64_t n);
+
+// Primality of values[0..count) into out[]; large batches are split across threads
+void isPrimeBatch(const uint64_t *values, size_t count, uint8_t *out, unsigned threads = 0);
+
+uint64_t gcd64(uint64_t a, uint64_t b);
+
+// Pollard-Brent rho: returns a non-trivial factor of odd composite n
+uint64_t pollardBrent(uint64_t n);
+
+void factorInto(uint64_t n, std::vector<uint64_t> &primes);
+
+// Prime factorization as (prime, exponent) pairs: small primes are divided out
+// from the cached table, the cofactor is split with Pollard-Brent.
+std::vector<std::pair<uint64_t, int>> primeFactorization(uint64_t n);
+
+// All divisors in increasing order, generated from the factorization
+std::vector<uint64_t> divisorsFromFactors(const std::vector<std::pair<uint64_t, int>> &factors);
+
+// Polynomial root solvers
+// Coefficients and roots of many polynomials of one degree, stored as
+// structure of arrays: coeff[k][i] multiplies x^(degree - k) in equation i,
+// and root k of equation i is (re[k][i], im[k][i]). An equation whose
+// leading coefficients are zero is solved at its lower degree: its roots fill
+// the first slots and the missing ones are NaN.
+struct PolynomialBatch
+{
+    unsigned degree;
+    size_t count;
+    std::vector<std::vector<double>> coeff;
+    std::vector<std::vector<double>> re;
+    std::vector<std::vector<double>> im;
+
+    PolynomialBatch(unsigned polynomialDegree, size_t equations)
+        : degree(polynomialDegree), count(equations),
+          coeff(polynomialDegree + 1, std::vector<double>(equations)),
+          re(polynomialDegree, std::vector<double>(equations)),
+          im(polynomialDegree, std::vector<double>(equations))
+    {
+    }
+};
+
+// Degrees 2-4 are solved with closed forms evaluated branch-free, so a batch
+// loop runs across equations in SIMD lanes: the stable quadratic formula,
+// the trigonometric/Cardano cubic and Ferrari's quartic via its resolvent
+// cubic. Every root is then polished with guarded Newton steps, and any
+// equation whose roots are not finite or leave a residual above
+// RESIDUAL_TOLERANCE times the evaluation bound is re-solved with Aberth's
+// method, which also handles every other degree.
+class PolynomialSolver
+{
+public:
+    static constexpr double RESIDUAL_TOLERANCE = 1e-12;
+
+    // Roots of c[0] x^n + ... + c[n], leading zeros ignored
+    static std::vector<std::complex<double>> roots(std::vector<double> c);
+
+    // Solves every equation in the batch; large batches are split across threads
+    static void solve(PolynomialBatch &batch, unsigned threads = 0);
+
+    // Roots of a x^2 + b x + c without cancellation: the larger root comes
+    // from q = -(b + sign(b) sqrt(D)) / 2 and the other from c / q.
+    static void quadraticCore(double a, double b, double c, double &re1, double &im1, double &re2, double &im2)
+    {
+        double d = b * b - 4.0 * a * c;
+        double s = std::sqrt(std::fabs(d));
+        double q = -0.5 * (b + std::copysign(s, b));
+        double realRoot1 = q / a;
+        double realRoot2 = blend(zeroMask(q), 0.0, c / q);
+        double centre = 0.0 - 0.5 * b / a;
+        double spread = std::fabs(0.5 * s / a);
+        uint64_t complexRoots = signMask(d);
+        re1 = blend(complexRoots, centre, realRoot1);
+        im1 = blend(complexRoots, spread, 0.0);
+        re2 = blend(complexRoots, centre, realRoot2);
+        im2 = blend(complexRoots, -spread, 0.0);
+    }
+
+private:
+    typedef std::complex<double> Complex;
+
+    // Selections are done on bit patterns: a double compare feeding a select,
+    // or an arithmetic result used on one side only, keeps GCC from
+    // vectorizing the loop under the default -ftrapping-math.
+    static uint64_t toBits(double x)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        return bits;
+    }
+
+    static double fromBits(uint64_t bits)
+    {
+        double x;
+        std::memcpy(&x, &bits, sizeof(x));
+        return x;
+    }
+
+    // All ones when the sign bit of x is set (x < 0, or -0)
+    static uint64_t signMask(double x) { return 0 - (toBits(x) >> 63); }
+
+    // All ones when x is +0 or -0
+    static uint64_t zeroMask(double x)
+    {
+        uint64_t magnitude = toBits(x) & ~0x8000000000000000ULL;
+        return ((magnitude | (0 - magnitude)) >> 63) - 1;
+    }
+
+    // All ones when x is infinite or NaN
+    static uint64_t nonFiniteMask(double x)
+    {
+        uint64_t magnitude = toBits(x) & ~0x8000000000000000ULL;
+        return 0 - ((0x7fefffffffffffffULL - magnitude) >> 63);
+    }
+
+    static double blend(uint64_t mask, double ifSet, double ifClear)
+    {
+        return fromBits((toBits(ifSet) & mask) | (toBits(ifClear) & ~mask));
+    }
+
+    // Roots of the monic cubic x^3 + a x^2 + b x + c. Three real roots use
+    // the trigonometric form with acos(t) = atan2(sqrt(1 - t^2), t); one real
+    // root uses Cardano with cbrt = exp(ln / 3) plus a Newton step. Accuracy
+    // is only ~1e-8 before polishing. Returns all ones for three real roots.
+    CALC_ALWAYS_INLINE static uint64_t cubicCore(double a, double b, double c, double re[3], double im[3])
+    {
+        const double SQRT3_2 = 0.86602540378443864676;
+        double shift = a * (1.0 / 3.0);
+        double q = (a * a - 3.0 * b) * (1.0 / 9.0);
+        double r = (2.0 * a * a * a - 9.0 * a * b + 27.0 * c) * (1.0 / 54.0);
+        double q3 = q * q * q, r2 = r * r;
+        uint64_t threeReal = signMask(r2 - q3);
+
+        // Three real roots: x_k = -2 sqrt(q) cos((theta + 2 pi k) / 3) - a/3
+        double sqrtQ = std::sqrt(std::fabs(q));
+        double t = r / (sqrtQ * sqrtQ * sqrtQ + blend(zeroMask(q), 1.0, 0.0));
+        t = blend(signMask(1.0 - t), 1.0, t);
+        t = blend(signMask(t + 1.0), -1.0, t);
+        double phi = ComplexBatch::fastPhase(t, std::sqrt(std::fabs(1.0 - t * t))) * (1.0 / 3.0);
+        // phi is in [0, pi/3]; evaluate around pi/6 to stay inside the polynomials' range
+        double sinShifted = VectorMath::sinPoly(phi - M_PI / 6.0), cosShifted = VectorMath::cosPoly(phi - M_PI / 6.0);
+        double cosPhi = cosShifted * SQRT3_2 - sinShifted * 0.5;
+        double sinPhi = sinShifted * SQRT3_2 + cosShifted * 0.5;
+        double trig0 = -2.0 * sqrtQ * cosPhi - shift;
+        double trig1 = -2.0 * sqrtQ * (-0.5 * cosPhi - SQRT3_2 * sinPhi) - shift;
+        double trig2 = -2.0 * sqrtQ * (-0.5 * cosPhi + SQRT3_2 * sinPhi) - shift;
+
+        // One real root and a complex pair
+        double v = std::fabs(r) + std::sqrt(std::fabs(r2 - q3));
+        double root = VectorMath::expCore(VectorMath::logCore<VectorMath::LN>(v) * (1.0 / 3.0));
+        root = blend(zeroMask(v), 0.0, root - (root * root * root - v) / (3.0 * root * root));
+        double big = -std::copysign(root, r);
+        double small = blend(zeroMask(big), 0.0, q / big);
+        double real = big + small - shift;
+        double pairRe = -0.5 * (big + small) - shift;
+        double pairIm = SQRT3_2 * std::fabs(big - small);
+
+        re[0] = blend(threeReal, trig0, real);
+        re[1] = blend(threeReal, trig1, pairRe);
+        re[2] = blend(threeReal, trig2, pairRe);
+        im[0] = 0.0;
+        im[1] = blend(threeReal, 0.0, pairIm);
+        im[2] = blend(threeReal, 0.0, -pairIm);
+        return threeReal;
+    }
+
+    // Roots of the monic quartic x^4 + a x^3 + b x^2 + c x + d (Ferrari)
+    CALC_ALWAYS_INLINE static void quarticCore(double a, double b, double c, double d, double re[4], double im[4])
+    {
+        // Depressed quartic y^4 + p y^2 + q y + r with x = y - a/4
+        double a2 = a * a;
+        double p = b - 0.375 * a2;
+        double q = c - 0.5 * a * b + 0.125 * a2 * a;
+        double r = d - 0.25 * a * c + 0.0625 * a2 * b - (3.0 / 256.0) * a2 * a2;
+
+        // Largest real root z of the resolvent z^3 + 2p z^2 + (p^2 - 4r) z - q^2;
+        // then y^4 + p y^2 + q y + r = (y^2 + s y + t)(y^2 - s y + u) with s^2 = z
+        double zr[3], zi[3];
+        double rc1 = 2.0 * p, rc2 = p * p - 4.0 * r, rc3 = -q * q;
+        uint64_t threeReal = cubicCore(rc1, rc2, rc3, zr, zi);
+        double z01 = blend(signMask(zr[0] - zr[1]), zr[1], zr[0]);
+        double z012 = blend(signMask(z01 - zr[2]), zr[2], z01);
+        double z = blend(threeReal, z012, zr[0]);
+        #pragma GCC unroll 4
+        for (int step = 0; step < 2; step++)
+        {
+            double value = ((z + rc1) * z + rc2) * z + rc3;
+            double slope = (3.0 * z + 2.0 * rc1) * z + rc2;
+            double next = z - value / slope;
+            double nextValue = ((next + rc1) * next + rc2) * next + rc3;
+            uint64_t better = signMask(std::fabs(nextValue) - std::fabs(value)) & ~nonFiniteMask(next);
+            z = blend(better, next, z);
+        }
+        z = blend(signMask(z), 0.0, z);
+
+        double s = std::sqrt(z);
+        double qs = blend(zeroMask(s), 0.0, q / s);
+        double t = 0.5 * (p + z - qs), u = 0.5 * (p + z + qs);
+        quadraticCore(1.0, s, t, re[0], im[0], re[1], im[1]);
+        quadraticCore(1.0, -s, u, re[2], im[2], re[3], im[3]);
+        double shift = 0.25 * a;
+        #pragma GCC unroll 4
+        for (int k = 0; k < 4; k++)
+            re[k] -= shift;
+    }
+
+    // Complex Newton steps on the monic polynomial x^N + m[0] x^(N-1) + ... + m[N-1],
+    // each kept only if it lowers |p(x)|. Returns all ones if the root is not
+    // finite or its residual exceeds RESIDUAL_TOLERANCE times the evaluation bound.
+    template <unsigned N>
+    static uint64_t polish(const double *m, double &xr, double &xi)
+    {
+        double pr, pi, dr, di;
+        evaluate<N>(m, xr, xi, pr, pi, dr, di);
+        #pragma GCC unroll 4
+        for (int step = 0; step < 2; step++)
+        {
+            double den = dr * dr + di * di;
+            double nr = xr - (pr * dr + pi * di) / den;
+            double ni = xi - (pi * dr - pr * di) / den;
+            double qr, qi, qdr, qdi;
+            evaluate<N>(m, nr, ni, qr, qi, qdr, qdi);
+            uint64_t better = signMask((qr * qr + qi * qi) - (pr * pr + pi * pi)) & ~nonFiniteMask(nr) & ~nonFiniteMask(ni);
+            xr = blend(better, nr, xr);
+            xi = blend(better, ni, xi);
+            pr = blend(better, qr, pr);
+            pi = blend(better, qi, pi);
+            dr = blend(better, qdr, dr);
+            di = blend(better, qdi, di);
+        }
+
+        double modulus = std::sqrt(xr * xr + xi * xi);
+        double bound = 1.0;
+        #pragma GCC unroll 4
+        for (unsigned k = 0; k < N; k++)
+            bound = bound * modulus + std::fabs(m[k]);
+        double residual = std::sqrt(pr * pr + pi * pi);
+        return signMask(RESIDUAL_TOLERANCE * bound - residual) | nonFiniteMask(residual) | nonFiniteMask(bound);
+    }
+
+    // p(x) and p'(x) for the monic polynomial by complex Horner
+    template <unsigned N>
+    static void evaluate(const double *m, double xr, double xi, double &pr, double &pi, double &dr, double &di)
+    {
+        pr = 1.0;
+        pi = 0.0;
+        dr = 0.0;
+        di = 0.0;
+        #pragma GCC unroll 4
+        for (unsigned k = 0; k < N; k++)
+        {
+            double ndr = dr * xr - di * xi + pr, ndi = dr * xi + di * xr + pi;
+            double npr = pr * xr - pi * xi + m[k], npi = pr * xi + pi * xr;
+            dr = ndr;
+            di = ndi;
+            pr = npr;
+            pi = npi;
+        }
+    }
+
+    // Closed-form roots of the monic polynomial with Newton polishing for
+    // degrees 3 and 4; returns all ones if the roots need the Aberth fallback
+    template <unsigned N>
+    CALC_ALWAYS_INLINE static uint64_t closedForm(const double *m, double re[N], double im[N])
+    {
+        if constexpr (N == 2)
+        {
+            quadraticCore(1.0, m[0], m[1], re[0], im[0], re[1], im[1]);
+            return nonFiniteMask(re[0]) | nonFiniteMask(re[1]) | nonFiniteMask(im[0]);
+        }
+        else
+        {
+            if constexpr (N == 3)
+                cubicCore(m[0], m[1], m[2], re, im);
+            else
+                quarticCore(m[0], m[1], m[2], m[3], re, im);
+            uint64_t bad = 0;
+            #pragma GCC unroll 4
+            for (unsigned k = 0; k < N; k++)
+                bad |= polish<N>(m, re[k], im[k]);
+            return bad;
+        }
+    }
+
+    // Closed-form roots of equations [begin, end) of a degree-N batch, then
+    // Aberth for the flagged ones. The equation loop vectorizes only when its
+    // body has no calls and no loops left, hence the forced inlining of the
+    // cores and the unroll pragmas; ivdep drops the runtime overlap checks
+    // between the 3N + 1 coefficient and root streams, which are separate vectors.
+    template <unsigned N>
+    static void solveClosedForm(PolynomialBatch &batch, size_t begin, size_t end)
+    {
+        const double *coeff[N + 1];
+        double *outRe[N], *outIm[N];
+        #pragma GCC unroll 5
+        for (unsigned k = 0; k <= N; k++)
+            coeff[k] = batch.coeff[k].data();
+        #pragma GCC unroll 5
+        for (unsigned k = 0; k < N; k++)
+        {
+            outRe[k] = batch.re[k].data();
+            outIm[k] = batch.im[k].data();
+        }
+
+        uint64_t anyFlagged = 0;
+        std::vector<uint64_t> flagged(end - begin);
+        #pragma GCC ivdep
+        for (size_t i = begin; i < end; i++)
+        {
+            double m[N], re[N], im[N];
+            double inverse = 1.0 / coeff[0][i];
+            #pragma GCC unroll 4
+            for (unsigned k = 0; k < N; k++)
+                m[k] = coeff[k + 1][i] * inverse;
+            // A zero leading coefficient makes inverse infinite, so solveOne
+            // gets the equation and solves it at the lower degree
+            uint64_t bad = closedForm<N>(m, re, im) | nonFiniteMask(inverse);
+            #pragma GCC unroll 4
+            for (unsigned k = 0; k < N; k++)
+            {
+                outRe[k][i] = re[k];
+                outIm[k][i] = im[k];
+            }
+            flagged[i - begin] = bad;
+            anyFlagged |= bad;
+        }
+        if (anyFlagged == 0)
+            return;
+        for (size_t i = begin; i < end; i++)
+        {
+            if (flagged[i - begin])
+                solveOne(batch, i);
+        }
+    }
+
+    static void solveOne(PolynomialBatch &batch, size_t i);
+
+    static void solveRange(PolynomialBatch &batch, size_t begin, size_t end);
+
+    // Aberth-Ehrlich simultaneous iteration for a monic polynomial of degree
+    // n >= 3, started on a circle of the Fujiwara radius
+    static std::vector<Complex> aberth(const std::vector<double> &c);
+};
+
+// Radix conversion engine
+// Digits are written backwards into a caller buffer, so no string is ever
+// prepended to. Power-of-two bases use shifts and masks, base 10 emits two
+// digits per division, and big integers are split in halves by powers of
+// the base (divide and conquer) until the pieces fit in a machine word.
+const char RADIX_DIGITS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+const uint8_t RADIX_INVALID = 0xFF;
+
+class RadixConverter
+{
+public:
+    // Longest uint64_t in base 2 plus a sign
+    static const size_t MAX_DIGITS = 65;
+
+    static bool validBase(int base) { return base >= 2 && base <= 36; }
+
+    // Writes value so that it ends just before bufEnd; returns the first character
+    static char *formatUnsigned(uint64_t value, int base, char *bufEnd);
+
+    static char *formatSigned(int64_t value, int base, char *bufEnd);
+
+    static std::string toString(int64_t value, int base);
+
+    static std::string toString(const BigInt &value, int base);
+
+    // Parses [begin, end) with an optional sign; throws std::invalid_argument
+    // on a bad digit and std::out_of_range when the value needs more than 64 bits
+    static int64_t parseSigned(const char *begin, const char *end, int base);
+
+    static uint64_t parseUnsigned(const char *begin, const char *end, int base);
+
+    // Parses an integer of any length
+    static BigInt parseBig(const std::string &text, int base);
+
+    // Appends every value in base, each followed by separator, to out
+    static void formatBatch(const int64_t *values, size_t count, int base, char separator, std::string &out);
+
+    // Parses whitespace/comma separated integers; returns how many were appended.
+    // A token with any other byte in it ("1.5", "0x1F") throws std::invalid_argument
+    static size_t parseBatch(const char *text, size_t length, int base, std::vector<int64_t> &out);
+
+private:
+    static void checkBase(int base)
+    {
+        if (!validBase(base))
+            throw std::invalid_argument("Base must be between 2 and 36");
+    }
+
+    static bool isBatchSeparator(char c)
+    {
+        return c == ' ' || c == ',' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+    }
+
+    static const char *decimalPairs();
+
+    static const uint8_t *digitValues();
+
+    // Digits per machine-word chunk: base^k stays below 10^18 so chunks convert
+    // to BigInt limbs without overflow
+    static int chunkDigits(int base);
+
+    // powers[0] = base^chunkDigits; callers square it up to the level they need
+    static std::vector<BigInt> chunkPowers(int base);
+
+    // Emits value < powers[level + 1] in base; padded to the full width of
+    // that level when it is the low half of a larger number
+    static void appendBig(const BigInt &value, int base, const std::vector<BigInt> &powers,
+                          int level, bool pad, std::string &out);
+
+    static BigInt parseRange(const char *digits, size_t length, int base, const std::vector<BigInt> &powers);
+};
+
+// Unit Conversions
+// Every unit is one table row: value_in_base = (value - zero) * scale / per,
+// where the base unit of each dimension has scale 1 and zero is where the
+// unit puts the dimension's reference point (0 except for temperatures, whose
+// reference is the freezing point of water). Keeping the zero point in the
+// unit's own numbers and the scale as a ratio makes the conversion
+// y = (x - zeroFrom) * factor + zeroTo exact wherever the old formulas were,
+// e.g. 32 °F is exactly 0 °C. The full N x N matrix of those maps is
+// generated at compile time, so adding a unit is one new row and a conversion
+// is a table lookup plus one subtract and one multiply-add.
+enum class Dimension
+{
+    Length,
+    Mass,
+    Temperature,
+    Time,
+    Speed,
+    DataSize
+};
+
+const char *const DIMENSION_NAMES[] = {"Length", "Mass", "Temperature", "Time", "Speed", "Data Size"};
+const int DIMENSION_COUNT = 6;
+
+struct UnitDef
+{
+    const char *name;
+    const char *symbol;
+    Dimension dimension;
+    double scale;
+    double per = 1.0;
+    double zero = 0.0;
+};
+
+constexpr UnitDef UNIT_TABLE[] = {
+    {"Meters", "m", Dimension::Length, 1.0},
+    {"Centimeters", "cm", Dimension::Length, 0.01},
+    {"Millimeters", "mm", Dimension::Length, 0.001},
+    {"Kilometers", "km", Dimension::Length, 1000.0},
+    {"Inches", "in", Dimension::Length, 0.0254},
+    {"Feet", "ft", Dimension::Length, 0.3048},
+    {"Yards", "yd", Dimension::Length, 0.9144},
+    {"Miles", "mi", Dimension::Length, 1609.344},
+    {"Kilograms", "kg", Dimension::Mass, 1.0},
+    {"Grams", "g", Dimension::Mass, 0.001},
+    {"Metric Tons", "t", Dimension::Mass, 1000.0},
+    {"Pounds", "lbs", Dimension::Mass, 0.45359237},
+    {"Ounces", "oz", Dimension::Mass, 0.028349523125},
+    {"Kelvin", "K", Dimension::Temperature, 1.0, 1.0, 273.15},
+    {"Celsius", "°C", Dimension::Temperature, 1.0, 1.0},
+    {"Fahrenheit", "°F", Dimension::Temperature, 5.0, 9.0, 32.0},
+    {"Seconds", "s", Dimension::Time, 1.0},
+    {"Minutes", "min", Dimension::Time, 60.0},
+    {"Hours", "h", Dimension::Time, 3600.0},
+    {"Days", "d", Dimension::Time, 86400.0},
+    {"Meters/second", "m/s", Dimension::Speed, 1.0},
+    {"Kilometers/hour", "km/h", Dimension::Speed, 1.0 / 3.6},
+    {"Miles/hour", "mph", Dimension::Speed, 0.44704},
+    {"Knots", "kn", Dimension::Speed, 1852.0 / 3600.0},
+    {"Bytes", "B", Dimension::DataSize, 1.0},
+    {"Kilobytes", "KB", Dimension::DataSize, 1e3},
+    {"Megabytes", "MB", Dimension::DataSize, 1e6},
+    {"Gigabytes", "GB", Dimension::DataSize, 1e9},
+    {"Kibibytes", "KiB", Dimension::DataSize, 1024.0},
+    {"Mebibytes", "MiB", Dimension::DataSize, 1048576.0},
+    {"Gibibytes", "GiB", Dimension::DataSize, 1073741824.0},
+};
+
+constexpr size_t UNIT_COUNT = sizeof(UNIT_TABLE) / sizeof(UNIT_TABLE[0]);
+
+struct UnitConversion
+{
+    double zeroFrom;
+    double factor;
+    double zeroTo;
+    bool valid; // false across dimensions
+};
+
+constexpr std::array<std::array<UnitConversion, UNIT_COUNT>, UNIT_COUNT> buildUnitConversions()
+{
+    std::array<std::array<UnitConversion, UNIT_COUNT>, UNIT_COUNT> table{};
+    for (size_t from = 0; from < UNIT_COUNT; from++)
+        for (size_t to = 0; to < UNIT_COUNT; to++)
+        {
+            const UnitDef &a = UNIT_TABLE[from];
+            const UnitDef &b = UNIT_TABLE[to];
+            if (a.dimension != b.dimension)
+                table[from][to] = UnitConversion{0.0, 0.0, 0.0, false};
+            else
+                table[from][to] = UnitConversion{a.zero, (a.scale * b.per) / (a.per * b.scale), b.zero, true};
+        }
+    return table;
+}
+
+constexpr std::array<std::array<UnitConversion, UNIT_COUNT>, UNIT_COUNT> UNIT_CONVERSIONS = buildUnitConversions();
+
+constexpr size_t unitIndex(const char *symbol, size_t i = 0)
+{
+    return i == UNIT_COUNT ? UNIT_COUNT : (std::string_view(UNIT_TABLE[i].symbol) == symbol ? i : unitIndex(symbol, i + 1));
+}
+
+// Unchecked table conversion, for compile-time checks of the table
+constexpr double convertUnitAt(double value, size_t from, size_t to)
+{
+    const UnitConversion &c = UNIT_CONVERSIONS[from][to];
+    return (value - c.zeroFrom) * c.factor + c.zeroTo;
+}
+
+static_assert(convertUnitAt(0.0, unitIndex("°C"), unitIndex("K")) == 273.15, "C->K table entry");
+static_assert(convertUnitAt(32.0, unitIndex("°F"), unitIndex("°C")) == 0.0, "32 F is 0 C");
+static_assert(convertUnitAt(212.0, unitIndex("°F"), unitIndex("°C")) == 100.0, "212 F is 100 C");
+static_assert(convertUnitAt(-40.0, unitIndex("°F"), unitIndex("°C")) == -40.0, "-40 F is -40 C");
+static_assert(convertUnitAt(-40.0, unitIndex("°C"), unitIndex("°F")) == -40.0, "-40 C is -40 F");
+static_assert(UNIT_CONVERSIONS[unitIndex("km")][unitIndex("m")].factor == 1000.0, "km->m table entry");
+static_assert(!UNIT_CONVERSIONS[unitIndex("kg")][unitIndex("m")].valid, "dimensions must not mix");
+
+// Throws std::invalid_argument for units of different dimensions
+const UnitConversion &unitConversion(size_t from, size_t to);
+
+double convertUnit(double value, size_t from, size_t to);
+
+// Converts count values in one branch-free pass (vectorized by the compiler)
+void convertUnitArray(const double *in, double *out, size_t count, size_t from, size_t to);
+
+#endif // CALCULATOR_ENGINE_H
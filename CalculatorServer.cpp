@@ -0,0 +1,673 @@
+// Calculator server: epoll event loops evaluating expressions for socket clients
+#include "CalculatorServer.h"
+#include "CalculatorEngine.h"
+
+#include <iostream>
+
+#ifdef __linux__
+#include <charconv>
+#include <csignal>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)
+#endif
+
+namespace
+{
+const size_t READ_CHUNK = 64 * 1024;
+const size_t MAX_LINE = 1 << 20;           // A longer line without a newline closes the connection
+const size_t MAX_PENDING_OUTPUT = 4 << 20; // Stop reading from a client that is not reading its answers
+const size_t MAX_FRAME = 16 << 20;         // A larger binary frame closes the connection
+const size_t MAX_DEFINED = 1 << 16;        // Expressions one binary connection may define
+const int MAX_EVENTS = 64;
+
+// Binary protocol, see CalculatorServer.h; a NUL can never start a text request
+const char BINARY_HELLO[4] = {'\0', 'C', 'B', '1'};
+enum FrameType : uint8_t
+{
+    FRAME_DEFINE = 1,
+    FRAME_EVALUATE = 2
+};
+enum FrameStatus : uint8_t
+{
+    FRAME_OK = 0,
+    FRAME_FAILED = 1
+};
+
+int stopEvent = -1; // eventfd every event loop watches; never read, so it wakes them all
+
+void requestStop(int)
+{
+    uint64_t one = 1;
+    ssize_t written = write(stopEvent, &one, sizeof(one));
+    (void)written;
+}
+
+std::runtime_error socketError(const std::string &what)
+{
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+int listenUnix(const std::string &path)
+{
+    sockaddr_un address{};
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("Socket path must be 1-" + std::to_string(sizeof(address.sun_path) - 1) + " characters");
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    // Replace a socket left by an earlier run, but never any other kind of file
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+        unlink(path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        throw socketError("Cannot create socket");
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0)
+    {
+        std::runtime_error error = socketError("Cannot listen on " + path);
+        close(fd);
+        throw error;
+    }
+    return fd;
+}
+
+int listenTcp(int port)
+{
+    if (port < 1 || port > 65535)
+        throw std::runtime_error("Port must be 1-65535");
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        throw socketError("Cannot create socket");
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0)
+    {
+        std::runtime_error error = socketError("Cannot listen on 127.0.0.1:" + std::to_string(port));
+        close(fd);
+        throw error;
+    }
+    return fd;
+}
+
+// Little-endian fields, assembled bytewise so the protocol does not depend
+// on the host byte order (compilers turn these into single loads and stores)
+uint64_t loadLittleEndian(const char *p, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--)
+        value = value << 8 | static_cast<uint8_t>(p[i]);
+    return value;
+}
+
+void storeLittleEndian(char *p, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        p[i] = static_cast<char>(value >> (8 * i));
+}
+
+void appendLittleEndian(std::string &out, uint64_t value, int bytes)
+{
+    size_t at = out.size();
+    out.resize(at + bytes);
+    storeLittleEndian(&out[at], value, bytes);
+}
+
+double loadDouble(const char *p)
+{
+    uint64_t bits = loadLittleEndian(p, 8);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void storeDouble(char *p, double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    storeLittleEndian(p, bits, 8);
+}
+
+std::string_view trim(std::string_view text)
+{
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos)
+        return std::string_view();
+    return text.substr(begin, text.find_last_not_of(" \t\r") - begin + 1);
+}
+
+enum Protocol
+{
+    UNDECIDED, // Nothing received yet
+    TEXT,
+    BINARY
+};
+
+struct Connection
+{
+    int fd = -1;
+    uint32_t events = EPOLLIN; // What epoll currently watches for
+    std::string input;         // Received bytes not yet forming a whole request
+    std::string output;        // Answers not yet sent, from outputSent on
+    size_t outputSent = 0;
+    bool closing = false;  // No more requests will be read; close once the output is sent
+    bool deferred = false; // Whole requests left in input until the output drains
+    Protocol protocol = UNDECIDED;
+    std::unordered_map<uint32_t, ExpressionCache::Entry> expressions; // Binary protocol ids
+};
+
+// One thread's epoll instance with the connections it accepted. Requests are
+// answered inline: evaluation takes well under a microsecond with a warm
+// cache, far less than handing the request to another thread would.
+class EventLoop
+{
+public:
+    EventLoop(int listenFd, size_t cacheCapacity)
+        : epollFd(epoll_create1(EPOLL_CLOEXEC)), listenFd(listenFd), cache(cacheCapacity), buffer(new char[READ_CHUNK])
+    {
+        if (epollFd < 0)
+            throw socketError("Cannot create epoll instance");
+        // EPOLLEXCLUSIVE wakes one idle loop per new connection instead of all of them
+        watch(listenFd, EPOLLIN | EPOLLEXCLUSIVE, nullptr, EPOLL_CTL_ADD);
+        watch(stopEvent, EPOLLIN, &stopEvent, EPOLL_CTL_ADD);
+    }
+
+    ~EventLoop()
+    {
+        for (const auto &entry : connections)
+            close(entry.first);
+        close(epollFd);
+    }
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    void run()
+    {
+        epoll_event events[MAX_EVENTS];
+        while (true)
+        {
+            int count = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw socketError("epoll_wait failed");
+            }
+            for (int i = 0; i < count; i++)
+            {
+                void *target = events[i].data.ptr;
+                if (target == &stopEvent)
+                    return;
+                if (target == nullptr)
+                {
+                    acceptClients();
+                    continue;
+                }
+                Connection &connection = *static_cast<Connection *>(target);
+                if (connection.closing)
+                {
+                    flush(connection);
+                    continue;
+                }
+                if ((events[i].events & EPOLLIN) || (events[i].events & (EPOLLHUP | EPOLLERR)))
+                {
+                    if (!readRequests(connection))
+                        continue;
+                }
+                if (events[i].events & EPOLLOUT)
+                    flush(connection);
+            }
+        }
+    }
+
+private:
+    void watch(int fd, uint32_t events, void *target, int operation)
+    {
+        epoll_event event{};
+        event.events = events;
+        event.data.ptr = target;
+        if (epoll_ctl(epollFd, operation, fd, &event) < 0)
+            throw socketError("epoll_ctl failed");
+    }
+
+    void acceptClients()
+    {
+        while (true)
+        {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                return; // EAGAIN, or out of descriptors until a client leaves
+            }
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // Fails harmlessly on Unix sockets
+            std::unique_ptr<Connection> &connection = connections[fd];
+            connection.reset(new Connection);
+            connection->fd = fd;
+            watch(fd, EPOLLIN, connection.get(), EPOLL_CTL_ADD);
+        }
+    }
+
+    void disconnect(Connection &connection)
+    {
+        int fd = connection.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections.erase(fd);
+    }
+
+    // Reads everything available, answers each whole line and sends the
+    // answers together. At end of input the last partial line is answered and
+    // the connection closes once everything queued has been sent; false if
+    // the connection was closed
+    bool readRequests(Connection &connection)
+    {
+        bool endOfInput = false;
+        while (connection.output.size() - connection.outputSent < MAX_PENDING_OUTPUT)
+        {
+            ssize_t n = read(connection.fd, buffer.get(), READ_CHUNK);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                disconnect(connection);
+                return false;
+            }
+            if (n == 0)
+            {
+                endOfInput = true;
+                break;
+            }
+            connection.input.append(buffer.get(), static_cast<size_t>(n));
+            if (!answerRequests(connection))
+            {
+                endOfInput = true;
+                break;
+            }
+        }
+
+        if (endOfInput)
+        {
+            if (connection.protocol == TEXT && !trim(connection.input).empty())
+            {
+                answer(connection.input, connection.output);
+                connection.input.clear();
+            }
+            connection.closing = true;
+        }
+        return flush(connection);
+    }
+
+    // Picks the protocol from the first bytes, then answers every whole
+    // request; false if the connection must close after sending the answers
+    bool answerRequests(Connection &connection)
+    {
+        if (connection.protocol == UNDECIDED)
+        {
+            if (connection.input[0] != BINARY_HELLO[0])
+            {
+                connection.protocol = TEXT;
+            }
+            else if (connection.input.size() < sizeof(BINARY_HELLO))
+            {
+                return true;
+            }
+            else if (connection.input.compare(0, sizeof(BINARY_HELLO), BINARY_HELLO, sizeof(BINARY_HELLO)) != 0)
+            {
+                connection.output += "! Unknown protocol\n";
+                return false;
+            }
+            else
+            {
+                connection.input.erase(0, sizeof(BINARY_HELLO));
+                connection.protocol = BINARY;
+            }
+        }
+
+        if (connection.protocol == BINARY)
+            return answerFrames(connection);
+        answerLines(connection);
+        if (connection.input.size() > MAX_LINE)
+        {
+            // Dropped so the end-of-input path does not answer it as a last line
+            connection.input.clear();
+            connection.output += "! Request line too long\n";
+            return false;
+        }
+        return true;
+    }
+
+    void answerLines(Connection &connection)
+    {
+        std::string_view input = connection.input;
+        size_t start = 0, end;
+        while ((end = input.find('\n', start)) != std::string_view::npos)
+        {
+            std::string_view line = trim(input.substr(start, end - start));
+            if (!line.empty())
+                answer(line, connection.output);
+            start = end + 1;
+        }
+        connection.input.erase(0, start);
+    }
+
+    bool answerFrames(Connection &connection)
+    {
+        const std::string &input = connection.input;
+        size_t start = 0;
+        while (input.size() - start >= 4)
+        {
+            // One frame can ask for MAX_FRAME bytes of answers, so stop at the
+            // same limit that stops reading; flush resumes here
+            if (connection.output.size() - connection.outputSent >= MAX_PENDING_OUTPUT)
+            {
+                connection.deferred = true;
+                break;
+            }
+            uint32_t length = static_cast<uint32_t>(loadLittleEndian(input.data() + start, 4));
+            if (length > MAX_FRAME)
+            {
+                appendFailure(connection.output, connection.output.size(), "Request frame too large");
+                return false;
+            }
+            if (input.size() - start - 4 < length)
+                break;
+            answerFrame(connection, std::string_view(input.data() + start + 4, length));
+            start += 4 + length;
+        }
+        connection.input.erase(0, start);
+        return true;
+    }
+
+    // Replaces whatever the response at frameStart holds with a failure frame
+    static void appendFailure(std::string &output, size_t frameStart, const char *message)
+    {
+        output.resize(frameStart);
+        size_t length = 1 + std::strlen(message);
+        appendLittleEndian(output, length, 4);
+        output += static_cast<char>(FRAME_FAILED);
+        output += message;
+    }
+
+    // Appends the response frame for one request frame
+    void answerFrame(Connection &connection, std::string_view frame)
+    {
+        CALC_PROFILE("server: frame");
+        std::string &output = connection.output;
+        size_t frameStart = output.size();
+        output.append(5, '\0'); // Length and status, set once the body is complete
+        try
+        {
+            if (frame.empty())
+                throw std::runtime_error("Empty request frame");
+            if (frame[0] == FRAME_DEFINE && frame.size() >= 5)
+            {
+                uint32_t id = static_cast<uint32_t>(loadLittleEndian(frame.data() + 1, 4));
+                const ExpressionCache::Entry &entry = cache.get(trim(frame.substr(5)));
+                if (connection.expressions.size() >= MAX_DEFINED && !connection.expressions.count(id))
+                    throw std::runtime_error("Too many expressions defined");
+                connection.expressions.insert_or_assign(id, entry);
+
+                const std::vector<std::string> &names = entry.expression.variableNames();
+                appendLittleEndian(output, names.size(), 4);
+                for (const std::string &name : names)
+                {
+                    appendLittleEndian(output, name.size(), 2);
+                    output += name;
+                }
+            }
+            else if (frame[0] == FRAME_EVALUATE && frame.size() >= 9)
+            {
+                uint32_t id = static_cast<uint32_t>(loadLittleEndian(frame.data() + 1, 4));
+                uint64_t rows = loadLittleEndian(frame.data() + 5, 4);
+                std::unordered_map<uint32_t, ExpressionCache::Entry>::const_iterator found = connection.expressions.find(id);
+                if (found == connection.expressions.end())
+                    throw std::runtime_error("No expression defined with id " + std::to_string(id));
+                const ExpressionCache::Entry &entry = found->second;
+                size_t width = entry.expression.variableNames().size();
+                if (rows > MAX_FRAME / sizeof(double) || frame.size() - 9 != rows * width * sizeof(double))
+                    throw std::runtime_error("Request frame size does not match its rows");
+                if (width == 0 && rows > 1)
+                    throw std::runtime_error("An expression without variables takes one row");
+
+                size_t at = output.size();
+                output.resize(at + rows * sizeof(double));
+                variables.resize(width);
+                const char *p = frame.data() + 9;
+                for (uint64_t row = 0; row < rows; row++)
+                {
+                    for (size_t k = 0; k < width; k++, p += sizeof(double))
+                        variables[k] = loadDouble(p);
+                    double value;
+                    try
+                    {
+                        value = entry.expression.evaluate(entry.literals, variables);
+                    }
+                    catch (const std::exception &)
+                    {
+                        value = std::numeric_limits<double>::quiet_NaN();
+                    }
+                    storeDouble(&output[at + row * sizeof(double)], value);
+                }
+            }
+            else
+            {
+                throw std::runtime_error("Unknown or short request frame");
+            }
+            output[frameStart + 4] = static_cast<char>(FRAME_OK);
+            storeLittleEndian(&output[frameStart], output.size() - frameStart - 4, 4);
+        }
+        catch (const std::exception &e)
+        {
+            appendFailure(output, frameStart, e.what());
+        }
+    }
+
+    // Sends what it can without blocking, answering deferred requests as the
+    // output drains, and watches for writability if anything is left; false
+    // if the connection was closed, on a send error or because a closing
+    // connection has sent everything
+    bool flush(Connection &connection)
+    {
+        while (true)
+        {
+            while (connection.outputSent < connection.output.size())
+            {
+                ssize_t n = send(connection.fd, connection.output.data() + connection.outputSent,
+                                 connection.output.size() - connection.outputSent, MSG_NOSIGNAL);
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                        break;
+                    disconnect(connection);
+                    return false;
+                }
+                connection.outputSent += static_cast<size_t>(n);
+            }
+            if (!connection.deferred || connection.output.size() - connection.outputSent >= MAX_PENDING_OUTPUT)
+                break;
+            connection.deferred = false;
+            if (!answerRequests(connection))
+                connection.closing = true;
+        }
+        if (connection.outputSent == connection.output.size())
+        {
+            if (connection.closing)
+            {
+                disconnect(connection);
+                return false;
+            }
+            connection.output.clear();
+            connection.outputSent = 0;
+        }
+
+        // A closing connection only waits to send; its end of input would keep it readable
+        size_t pending = connection.output.size() - connection.outputSent;
+        bool reading = !connection.closing && pending < MAX_PENDING_OUTPUT;
+        uint32_t events = (reading ? uint32_t(EPOLLIN) : 0) | (pending > 0 ? uint32_t(EPOLLOUT) : 0);
+        if (events != connection.events)
+        {
+            watch(connection.fd, events, &connection, EPOLL_CTL_MOD);
+            connection.events = events;
+        }
+        return true;
+    }
+
+    // Appends the response line for one request line
+    void answer(std::string_view line, std::string &output)
+    {
+        CALC_PROFILE("server: request");
+        try
+        {
+            size_t semicolon = line.find(';');
+            const ExpressionCache::Entry &entry = cache.get(trim(line.substr(0, semicolon)));
+            bindVariables(semicolon == std::string_view::npos ? std::string_view() : line.substr(semicolon + 1),
+                          entry.expression.variableNames());
+            double value = entry.expression.evaluate(entry.literals, variables);
+            output += "= ";
+            appendNumber(output, value);
+            output += '\n';
+        }
+        catch (const std::exception &e)
+        {
+            output += "! ";
+            output += e.what();
+            output += '\n';
+        }
+    }
+
+    // Parses "name=value" pairs separated by spaces or commas into variables,
+    // in the order of names
+    void bindVariables(std::string_view text, const std::vector<std::string> &names)
+    {
+        variables.assign(names.size(), 0.0);
+        given.assign(names.size(), false);
+        size_t pos = 0;
+        while (true)
+        {
+            pos = text.find_first_not_of(" \t\r,", pos);
+            if (pos == std::string_view::npos)
+                break;
+            size_t equals = text.find('=', pos);
+            if (equals == std::string_view::npos)
+                throw std::runtime_error("Expected name=value, got " + std::string(text.substr(pos)));
+            std::string_view name = trim(text.substr(pos, equals - pos));
+            size_t index = std::find(names.begin(), names.end(), name) - names.begin();
+            if (index == names.size())
+                throw std::runtime_error("No variable named " + std::string(name));
+
+            size_t valueStart = text.find_first_not_of(" \t", equals + 1);
+            if (valueStart == std::string_view::npos)
+                valueStart = text.size();
+            const char *first = text.data() + valueStart;
+            std::from_chars_result parsed = std::from_chars(first, text.data() + text.size(), variables[index]);
+            if (parsed.ec != std::errc() || parsed.ptr == first)
+                throw std::runtime_error("No value on the line for " + std::string(name));
+            given[index] = true;
+            pos = static_cast<size_t>(parsed.ptr - text.data());
+        }
+        for (size_t i = 0; i < names.size(); i++)
+            if (!given[i])
+                throw std::runtime_error("No value for variable " + names[i]);
+    }
+
+    int epollFd, listenFd;
+    ExpressionCache cache;
+    std::unique_ptr<char[]> buffer;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::vector<double> variables; // Reused so warm requests do not allocate
+    std::vector<bool> given;
+};
+}
+
+int runServer(const ServerOptions &options)
+{
+    int listenFd;
+    try
+    {
+        listenFd = options.tcpPort ? listenTcp(options.tcpPort) : listenUnix(options.socketPath);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    stopEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopEvent < 0)
+    {
+        std::cerr << "Error: " << socketError("Cannot create eventfd").what() << std::endl;
+        close(listenFd);
+        return 1;
+    }
+
+    struct sigaction action{};
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::mutex errorMutex;
+    std::string firstError;
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++)
+        pool.emplace_back([&]()
+                          {
+                              try
+                              {
+                                  EventLoop(listenFd, options.cacheCapacity).run();
+                              }
+                              catch (const std::exception &e)
+                              {
+                                  std::lock_guard<std::mutex> lock(errorMutex);
+                                  if (firstError.empty())
+                                      firstError = e.what();
+                                  requestStop(0);
+                              } });
+
+    std::cerr << "Listening on "
+              << (options.tcpPort ? "127.0.0.1:" + std::to_string(options.tcpPort) : options.socketPath) << " with "
+              << threads << (threads == 1 ? " thread" : " threads") << "; Ctrl+C stops" << std::endl;
+    for (std::thread &thread : pool)
+        thread.join();
+
+    close(listenFd);
+    close(stopEvent);
+    if (!options.tcpPort)
+        unlink(options.socketPath.c_str());
+    if (!firstError.empty())
+    {
+        std::cerr << "Error: " << firstError << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+#else
+
+int runServer(const ServerOptions &)
+{
+    std::cerr << "Error: Server mode needs Linux (epoll)" << std::endl;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,52 @@
+// Calculator server
+// Serves expression evaluation to other programs over a Unix domain socket or
+// localhost TCP, so callers keep one connection open instead of starting a
+// calculator per request. Linux only (epoll); elsewhere runServer reports an
+// error.
+//
+// Text protocol: one request per line, one response line per request, in
+// order. A client may send many lines without waiting for the answers.
+// Blank lines are ignored.
+//
+//   request:   <expression>[; name=value name=value ...]
+//   response:  = <value>        or        ! <error message>
+//
+//   (3+5)*2^3              = 64
+//   rate*years; rate=0.05 years=10
+//                          = 0.5
+//   1/0                    ! Division by zero
+//
+// Binary protocol, for callers sending many evaluations: the client opens
+// with the 4 bytes "\0CB1", then sends frames without waiting and reads one
+// response frame per request frame, in order. Expressions are compiled once
+// when defined and afterwards evaluated from raw doubles, so neither side
+// parses or formats numbers. All integers and doubles are little-endian.
+//
+//   frame:     u32 length of the rest | u8 type or status | body
+//   define:    type 1 | u32 id | expression text
+//     reply:   status 0 | u32 variable count | per variable: u16 length, name
+//   evaluate:  type 2 | u32 id | u32 rows | rows x variable count f64 values
+//     reply:   status 0 | rows f64 results (NaN where evaluation failed)
+//   failure:   status 1 | error message
+//
+// Ids are chosen by the client and belong to its connection; defining an id
+// again replaces it. Variable values follow the order of the define reply;
+// an expression without variables is evaluated with at most one row.
+#ifndef CALCULATOR_SERVER_H
+#define CALCULATOR_SERVER_H
+
+#include <cstddef>
+#include <string>
+
+struct ServerOptions
+{
+    std::string socketPath; // Unix domain socket; used when tcpPort is 0
+    int tcpPort = 0;        // Listens on 127.0.0.1 only
+    unsigned threads = 0;   // Event loop threads; 0 means one per core
+    size_t cacheCapacity = 4096; // Compiled expressions kept per thread
+};
+
+// Runs until SIGINT or SIGTERM; returns the process exit status
+int runServer(const ServerOptions &options);
+
+#endif // CALCULATOR_SERVER_H